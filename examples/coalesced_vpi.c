@@ -0,0 +1,244 @@
+/*
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This file contains a VPI module that checks the Icarus Verilog
+ * cbValueChangeCoalesced callbacks. Compile it with the iverilog-vpi
+ * command like so:
+ *
+ *    iverilog-vpi coalesced_vpi.c
+ *
+ * See the coalesced_vpi.vl program for the Verilog code that drives
+ * it. The "make check" of vvp also builds it, and runs it with the
+ * vvp/examples/coalesced.vvp program, which is the compiled form of
+ * coalesced_vpi.vl. The module adds these system tasks:
+ *
+ *    $cc_watch(sig, "sim"|"real")
+ *        Put a coalesced callback on sig with a vpiSimTime or a
+ *        vpiScaledRealTime time. All the callbacks share the same
+ *        cb_rtn and user_data, so they are grouped by time type.
+ *
+ *    $cc_watch_dup(sig, "sim"|"real")
+ *        Try to put a second callback like that on sig, which must
+ *        fail.
+ *
+ *    $cc_unwatch(sig, "sim"|"real")
+ *        Remove the callback that $cc_watch put on sig.
+ *
+ *    $cc_expect("...")
+ *        Compare the log of the calls since the last $cc_expect with
+ *        the string. Each call is logged as "<time type>@<time>:" and
+ *        the names of the changed objects, with a space between calls.
+ *
+ *    $cc_done
+ *        Print PASSED or FAILED.
+ */
+
+# include  <vpi_user.h>
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+
+# define MAX_WATCH 16
+
+static struct {
+      vpiHandle sig;
+      PLI_INT32 time_type;
+      vpiHandle cb;
+} watches[MAX_WATCH];
+static unsigned nwatches = 0;
+
+static char log_buf[1024];
+static unsigned errors = 0;
+
+static PLI_INT32 cc_rtn(p_cb_data data)
+{
+      char item[128];
+      vpiHandle obj;
+      PLI_INT32 cnt = 0;
+
+      if (data->time->type == vpiSimTime) {
+	    sprintf(item, "%ssim@%u:", log_buf[0]? " " : "",
+		    (unsigned)data->time->low);
+      } else {
+	    sprintf(item, "%sreal@%g:", log_buf[0]? " " : "",
+		    data->time->real);
+      }
+      strcat(log_buf, item);
+
+      while ((obj = vpi_scan(data->obj))) {
+	    sprintf(item, "%s%s", cnt? "," : "", vpi_get_str(vpiName, obj));
+	    strcat(log_buf, item);
+	    cnt += 1;
+      }
+
+      if (cnt != data->index) {
+	    vpi_printf("FAILED: index is %d, but %d objects changed.\n",
+		       (int)data->index, (int)cnt);
+	    errors += 1;
+      }
+
+      return 0;
+}
+
+/*
+ * Get the signal and the time type arguments of the task.
+ */
+static void get_args(vpiHandle*sig, PLI_INT32*time_type)
+{
+      vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
+      vpiHandle argv = vpi_iterate(vpiArgument, callh);
+      s_vpi_value val;
+
+      *sig = vpi_scan(argv);
+      val.format = vpiStringVal;
+      vpi_get_value(vpi_scan(argv), &val);
+      *time_type = strcmp(val.value.str, "real") == 0
+		 ? vpiScaledRealTime : vpiSimTime;
+      vpi_free_object(argv);
+}
+
+static vpiHandle register_watch(vpiHandle sig, PLI_INT32 time_type)
+{
+      s_vpi_time time;
+      s_cb_data cb;
+
+      time.type = time_type;
+      cb.reason = cbValueChangeCoalesced;
+      cb.cb_rtn = cc_rtn;
+      cb.obj = sig;
+      cb.time = &time;
+      cb.value = 0;
+      cb.user_data = 0;
+      return vpi_register_cb(&cb);
+}
+
+static PLI_INT32 cc_watch_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      vpiHandle sig;
+      PLI_INT32 time_type;
+
+      (void)name; /* Parameter is not used. */
+      get_args(&sig, &time_type);
+      watches[nwatches].sig = sig;
+      watches[nwatches].time_type = time_type;
+      watches[nwatches].cb = register_watch(sig, time_type);
+      if (watches[nwatches].cb == 0) {
+	    vpi_printf("FAILED: $cc_watch(%s) did not register.\n",
+		       vpi_get_str(vpiName, sig));
+	    errors += 1;
+      }
+      nwatches += 1;
+      return 0;
+}
+
+static PLI_INT32 cc_watch_dup_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      vpiHandle sig;
+      PLI_INT32 time_type;
+
+      (void)name; /* Parameter is not used. */
+      get_args(&sig, &time_type);
+      if (register_watch(sig, time_type) != 0) {
+	    vpi_printf("FAILED: $cc_watch_dup(%s) registered.\n",
+		       vpi_get_str(vpiName, sig));
+	    errors += 1;
+      }
+      return 0;
+}
+
+static PLI_INT32 cc_unwatch_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      vpiHandle sig;
+      PLI_INT32 time_type;
+      unsigned idx;
+
+      (void)name; /* Parameter is not used. */
+      get_args(&sig, &time_type);
+      for (idx = 0 ;  idx < nwatches ;  idx += 1) {
+	    if (watches[idx].sig != sig || watches[idx].time_type != time_type
+		|| watches[idx].cb == 0)
+		  continue;
+	    vpi_remove_cb(watches[idx].cb);
+	    watches[idx].cb = 0;
+	    return 0;
+      }
+
+      vpi_printf("FAILED: $cc_unwatch(%s) found no callback.\n",
+		 vpi_get_str(vpiName, sig));
+      errors += 1;
+      return 0;
+}
+
+static PLI_INT32 cc_expect_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
+      vpiHandle argv = vpi_iterate(vpiArgument, callh);
+      s_vpi_value val;
+
+      (void)name; /* Parameter is not used. */
+      val.format = vpiStringVal;
+      vpi_get_value(vpi_scan(argv), &val);
+      vpi_free_object(argv);
+
+      if (strcmp(val.value.str, log_buf) != 0) {
+	    vpi_printf("FAILED: expected \"%s\", got \"%s\"\n",
+		       val.value.str, log_buf);
+	    errors += 1;
+      }
+
+      log_buf[0] = 0;
+      return 0;
+}
+
+static PLI_INT32 cc_done_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      (void)name; /* Parameter is not used. */
+      vpi_printf("%s\n", errors? "FAILED" : "PASSED");
+      return 0;
+}
+
+static void register_task(const char*name, PLI_INT32 (*calltf)(ICARUS_VPI_CONST PLI_BYTE8*))
+{
+      s_vpi_systf_data tf_data;
+
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = (PLI_BYTE8*)name;
+      tf_data.calltf    = calltf;
+      tf_data.compiletf = 0;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = 0;
+      vpi_register_systf(&tf_data);
+}
+
+static void coalesced_register(void)
+{
+      register_task("$cc_watch", cc_watch_calltf);
+      register_task("$cc_watch_dup", cc_watch_dup_calltf);
+      register_task("$cc_unwatch", cc_unwatch_calltf);
+      register_task("$cc_expect", cc_expect_calltf);
+      register_task("$cc_done", cc_done_calltf);
+}
+
+/*
+ * This is a table of register functions. This table is the external
+ * symbol that the simulator looks for when loading this .vpi module.
+ */
+void (*vlog_startup_routines[])(void) = {
+      coalesced_register,
+      0
+};
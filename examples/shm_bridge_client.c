@@ -0,0 +1,159 @@
+/*
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This file contains an example client of the $shm_bridge system
+ * task of the shm_bridge.vpi module. It maps the file that the
+ * simulation shares, and prints the time and the values of all the
+ * shared signals each time a new time step is published, until the
+ * simulation finishes. With the -l flag, it runs the bridge in
+ * lockstep, so that it sees every time step from then on. Start the
+ * simulation with the -shm-bridge-lockstep extended argument to see
+ * them all from the first. Compile it like so:
+ *
+ *    cc -o shm_bridge_client shm_bridge_client.c
+ *
+ * with the directory of the installed vpi_shm_bridge.h header in the
+ * include path, and run it with the file name that the design passes
+ * to $shm_bridge:
+ *
+ *    shm_bridge_client [-l] /dev/shm/bridge
+ */
+
+# include  <vpi_shm_bridge.h>
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+# include  <fcntl.h>
+# include  <time.h>
+# include  <unistd.h>
+# include  <sys/mman.h>
+# include  <sys/stat.h>
+
+static void print_value(const struct shm_bridge_vecval*val, uint32_t width)
+{
+      uint32_t idx = width;
+      while (idx > 0) {
+	    uint32_t bit;
+	    idx -= 1;
+	    bit = 1U << (idx % 32);
+	    if (val[idx/32].bval & bit)
+		  putchar(val[idx/32].aval & bit? 'x' : 'z');
+	    else
+		  putchar(val[idx/32].aval & bit? '1' : '0');
+      }
+}
+
+int main(int argc, char*argv[])
+{
+      const char*path;
+      int lockstep = 0;
+      struct shm_bridge_header*head;
+      const struct shm_bridge_signal*sigs;
+      struct shm_bridge_vecval*copy;
+      struct stat st;
+      struct timespec nap;
+      uint64_t last = 0;
+      size_t nbytes;
+      void*mem;
+      int fd;
+
+      if (argc == 3 && strcmp(argv[1], "-l") == 0) {
+	    lockstep = 1;
+	    path = argv[2];
+      } else if (argc == 2) {
+	    path = argv[1];
+      } else {
+	    fprintf(stderr, "Usage: %s [-l] <file>\n", argv[0]);
+	    return 1;
+      }
+
+	/* Wait for the simulation to make the file. It is renamed
+	   into place complete, so the header can be read at once. */
+      while ((fd = open(path, O_RDWR)) < 0)
+	    usleep(10000);
+
+      if (fstat(fd, &st) < 0) {
+	    perror(path);
+	    return 1;
+      }
+
+      mem = mmap(0, st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);
+      if (mem == MAP_FAILED) {
+	    perror(path);
+	    return 1;
+      }
+
+      head = (struct shm_bridge_header*)mem;
+      if (__atomic_load_n(&head->magic, __ATOMIC_ACQUIRE) != SHM_BRIDGE_MAGIC
+	  || head->version != SHM_BRIDGE_VERSION) {
+	    fprintf(stderr, "%s: not a $shm_bridge file.\n", path);
+	    return 1;
+      }
+
+      sigs = (const struct shm_bridge_signal*)((char*)mem + head->signals_off);
+      nbytes = head->cmds_off - head->values_off;
+      copy = (struct shm_bridge_vecval*)malloc(nbytes);
+
+      if (lockstep)
+	    __atomic_store_n(&head->lockstep, 1, __ATOMIC_RELEASE);
+
+	/* Wait for each new time step with a sleep that doubles up to
+	   a millisecond, and starts short again after each step. */
+      nap.tv_sec = 0;
+      nap.tv_nsec = 1000;
+      for (;;) {
+	    int finished = __atomic_load_n(&head->finished, __ATOMIC_ACQUIRE);
+	    uint64_t seq = __atomic_load_n(&head->seq, __ATOMIC_ACQUIRE);
+	    uint64_t time;
+	    uint32_t idx;
+
+	    if (seq == last || seq % 2 != 0) {
+		  if (finished)
+			break;
+		  nanosleep(&nap, 0);
+		  if (nap.tv_nsec < 1000000)
+			nap.tv_nsec *= 2;
+		  continue;
+	    }
+	    nap.tv_nsec = 1000;
+
+	      /* Copy the values, and keep the copy only if the seq did
+		 not change while it was made. */
+	    memcpy(copy, (char*)mem + head->values_off, nbytes);
+	    time = head->time;
+	    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+	    if (__atomic_load_n(&head->seq, __ATOMIC_RELAXED) != seq)
+		  continue;
+
+	    last = seq;
+	    printf("%llu:", (unsigned long long)time);
+	    for (idx = 0 ;  idx < head->nsignals ;  idx += 1) {
+		  printf(" %s=", sigs[idx].name);
+		  print_value(copy + sigs[idx].word, sigs[idx].width);
+	    }
+	    printf("\n");
+
+	    if (lockstep)
+		  __atomic_store_n(&head->ack, seq, __ATOMIC_RELEASE);
+      }
+
+      free(copy);
+      munmap(mem, st.st_size);
+      return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This file contains a VPI module that checks the Icarus Verilog
+ * vpip_get_vecval_multi function. Compile it with the iverilog-vpi
+ * command like so:
+ *
+ *    iverilog-vpi vecval_multi_vpi.c
+ *
+ * The "make check" of vvp also builds it, and runs it with the
+ * vvp/examples/vecval_multi.vvp program. The module adds these
+ * system tasks:
+ *
+ *    $vm_check(arg, ...)
+ *        Read each argument with vpip_get_vecval_multi. The value of a
+ *        net or variable with a vector value must be the same as the
+ *        vpiVectorVal of vpi_get_value, and any other argument must be
+ *        refused with -1. Then read all the vector arguments in one
+ *        call, and all the arguments in one call, which must also be
+ *        refused if any of them is not a vector.
+ *
+ *    $vm_done
+ *        Print PASSED or FAILED.
+ */
+
+# include  <sv_vpi_user.h>
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+
+# define MAX_ARGS 16
+# define MAX_WORDS 64
+
+static unsigned errors = 0;
+
+static int is_vector(vpiHandle item)
+{
+      switch (vpi_get(vpiType, item)) {
+	  case vpiNet:
+	  case vpiReg:
+	  case vpiIntegerVar:
+	  case vpiBitVar:
+	  case vpiByteVar:
+	  case vpiShortIntVar:
+	  case vpiIntVar:
+	  case vpiLongIntVar:
+	    return 1;
+	  default:
+	    return 0;
+      }
+}
+
+static unsigned item_words(vpiHandle item)
+{
+      return (vpi_get(vpiSize, item) + 31) / 32;
+}
+
+/*
+ * Compare the words at vals with the vpiVectorVal of the item.
+ */
+static void check_words(vpiHandle item, const s_vpi_vecval*vals)
+{
+      s_vpi_value val;
+      unsigned idx, words = item_words(item);
+
+      val.format = vpiVectorVal;
+      vpi_get_value(item, &val);
+      for (idx = 0 ;  idx < words ;  idx += 1) {
+	    if (vals[idx].aval == val.value.vector[idx].aval
+		&& vals[idx].bval == val.value.vector[idx].bval)
+		  continue;
+	    vpi_printf("FAILED: word %u of %s is %08x/%08x, "
+		       "expected %08x/%08x\n", idx,
+		       vpi_get_str(vpiName, item),
+		       (unsigned)vals[idx].aval, (unsigned)vals[idx].bval,
+		       (unsigned)val.value.vector[idx].aval,
+		       (unsigned)val.value.vector[idx].bval);
+	    errors += 1;
+      }
+}
+
+static PLI_INT32 vm_check_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
+      vpiHandle argv = vpi_iterate(vpiArgument, callh);
+      vpiHandle args[MAX_ARGS], vecs[MAX_ARGS], item;
+      s_vpi_vecval vals[MAX_WORDS];
+      unsigned nargs = 0, nvecs = 0, nwords = 0, idx;
+      PLI_INT32 rc;
+
+      (void)name; /* Parameter is not used. */
+      while ((item = vpi_scan(argv)) && nargs < MAX_ARGS)
+	    args[nargs++] = item;
+
+      for (idx = 0 ;  idx < nargs ;  idx += 1) {
+	    item = args[idx];
+	    rc = vpip_get_vecval_multi(1, &item, vals);
+	    if (! is_vector(item)) {
+		  if (rc != -1) {
+			vpi_printf("FAILED: argument %u (type %d) returned "
+				   "%d, expected -1\n", idx,
+				   (int)vpi_get(vpiType, item), (int)rc);
+			errors += 1;
+		  }
+		  continue;
+	    }
+
+	    if (rc != (PLI_INT32)item_words(item)) {
+		  vpi_printf("FAILED: %s returned %d, expected %u\n",
+			     vpi_get_str(vpiName, item), (int)rc,
+			     item_words(item));
+		  errors += 1;
+		  continue;
+	    }
+	    check_words(item, vals);
+	    vecs[nvecs++] = item;
+	    nwords += rc;
+      }
+
+      rc = vpip_get_vecval_multi(nvecs, vecs, vals);
+      if (rc != (PLI_INT32)nwords) {
+	    vpi_printf("FAILED: %u vectors returned %d, expected %u\n",
+		       nvecs, (int)rc, nwords);
+	    errors += 1;
+      } else {
+	    nwords = 0;
+	    for (idx = 0 ;  idx < nvecs ;  idx += 1) {
+		  check_words(vecs[idx], vals + nwords);
+		  nwords += item_words(vecs[idx]);
+	    }
+      }
+
+      if (nvecs < nargs) {
+	    rc = vpip_get_vecval_multi(nargs, args, vals);
+	    if (rc != -1) {
+		  vpi_printf("FAILED: all %u arguments returned %d, "
+			     "expected -1\n", nargs, (int)rc);
+		  errors += 1;
+	    }
+      }
+
+      return 0;
+}
+
+static PLI_INT32 vm_done_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      (void)name; /* Parameter is not used. */
+      vpi_printf("%s\n", errors? "FAILED" : "PASSED");
+      return 0;
+}
+
+static void register_task(const char*name, PLI_INT32 (*calltf)(ICARUS_VPI_CONST PLI_BYTE8*))
+{
+      s_vpi_systf_data tf_data;
+
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = (PLI_BYTE8*)name;
+      tf_data.calltf    = calltf;
+      tf_data.compiletf = 0;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = 0;
+      vpi_register_systf(&tf_data);
+}
+
+static void vecval_multi_register(void)
+{
+      register_task("$vm_check", vm_check_calltf);
+      register_task("$vm_done", vm_done_calltf);
+}
+
+/*
+ * This is a table of register functions. This table is the external
+ * symbol that the simulator looks for when loading this .vpi module.
+ */
+void (*vlog_startup_routines[])(void) = {
+      vecval_multi_register,
+      0
+};
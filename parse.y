@@ -358,6 +358,28 @@ static void current_function_set_statement(const YYLTYPE&loc, vector<Statement*>
       current_function->set_statement(tmp);
 }
 
+/*
+ * The fail action of an immediate assertion starts with a call to the
+ * $ivl_assert_failed system task, so that the run time knows of the
+ * failure even if the action does not call $error. An assertion
+ * without a fail action calls $error.
+ */
+static Statement* assertion_fail_action(const YYLTYPE&loc, Statement*action)
+{
+      list<PExpr*>arg_list;
+      PCallTask*call = new PCallTask(lex_strings.make("$ivl_assert_failed"), arg_list);
+      FILE_NAME(call, loc);
+
+      vector<Statement*>stmts;
+      stmts.push_back(call);
+      if (action) stmts.push_back(action);
+
+      PBlock*tmp = new PBlock(PBlock::BL_SEQ);
+      FILE_NAME(tmp, loc);
+      tmp->set_statement(stmts);
+      return tmp;
+}
+
 %}
 
 %union {
@@ -2128,7 +2150,7 @@ simple_immediate_assertion_statement /* IEEE1800-2012 A.6.10 */
   | assert_or_assume '(' expression ')' K_else statement_or_null
       {
 	if (gn_supported_assertions_flag) {
-	      PCondit*tmp = new PCondit($3, 0, $6);
+	      PCondit*tmp = new PCondit($3, 0, assertion_fail_action(@5, $6));
 	      FILE_NAME(tmp, @1);
 	      $$ = tmp;
 	} else {
@@ -2140,7 +2162,7 @@ simple_immediate_assertion_statement /* IEEE1800-2012 A.6.10 */
   | assert_or_assume '(' expression ')' statement_or_null K_else statement_or_null
       {
 	if (gn_supported_assertions_flag) {
-	      PCondit*tmp = new PCondit($3, $5, $7);
+	      PCondit*tmp = new PCondit($3, $5, assertion_fail_action(@6, $7));
 	      FILE_NAME(tmp, @1);
 	      $$ = tmp;
 	} else {
@@ -0,0 +1,121 @@
+#!/bin/sh
+
+# This is a developer script that makes a synthetic gate level design
+# to measure the levelized mode of vvp (the -c flag). It writes
+# adder_bench.vvp into the current directory. The design has the given
+# number of 64 bit ripple carry adders, each made of XOR, AND and OR
+# gates, and each with its own mix of the bits of the same two inputs.
+# A change of the inputs ripples through the carry chains, so in the
+# default mode a gate can run many times in one time step. The inputs
+# take the given number of random values (100 by default), one per time
+# step, and the whole sequence is run the given number of times (1 by
+# default). The sum of the first adder and the carry out of every adder
+# are displayed at the end, and with "show" at the end of every step.
+#
+# The .vvp file is written directly, so the compiler is not needed. Run
+# it with the vvp under test, for example:
+#
+#    sh scripts/adder_bench.sh 300 100 100
+#    time vvp -M vpi adder_bench.vvp
+#    time vvp -M vpi -c adder_bench.vvp
+#
+# The two runs must print the same values. The "make check" of vvp runs
+# a small one with "show" both ways and compares the output.
+#
+# NOTE: DO NOT INSTALL THIS FILE.
+
+if test $# -lt 1; then
+    echo "Usage: $0 <adders> [<steps> [<repeats> [show]]]" 1>&2
+    exit 1
+fi
+
+adders=$1
+steps=${2:-100}
+repeats=${3:-1}
+show=${4:-}
+
+awk -v adders="$adders" -v steps="$steps" -v repeats="$repeats" -v show="$show" '
+function rand32() {
+    return int(rand() * 65536) * 65536 + int(rand() * 65536)
+}
+
+function display(prefix) {
+    printf " %%vpi_call 0 0 \"$display\", \"%s%%0t %s\", $time, %s {0 0 0};\n", prefix, fmt, outs > vvp
+}
+
+BEGIN {
+    vvp = "adder_bench.vvp"
+    W = 64
+    srand(3)
+
+    print ":ivl_version \"12.0\" \"vec4-stack\";" > vvp
+    print ":vpi_module \"system\";" > vvp
+    print ":vpi_time_precision + 0;" > vvp
+    print "main .scope module, \"main\" \"main\" 0 0;" > vvp
+    print " .timescale 0 0;" > vvp
+    print "a0 .var \"a0\", 31 0;" > vvp
+    print "a1 .var \"a1\", 31 0;" > vvp
+    print "b0 .var \"b0\", 31 0;" > vvp
+    print "b1 .var \"b1\", 31 0;" > vvp
+    print "cnt .var \"cnt\", 31 0;" > vvp
+    for (i = 0 ; i < W ; i += 1) {
+	printf "pa%d .part a%d, %d, 1;\n", i, int(i/32), i%32 > vvp
+	printf "pb%d .part b%d, %d, 1;\n", i, int(i/32), i%32 > vvp
+    }
+
+	# Each bit is a full adder: s = a^b^c, c = a&b | (a^b)&c.
+    for (k = 0 ; k < adders ; k += 1) {
+	c = "C4<0>"
+	for (i = 0 ; i < W ; i += 1) {
+	    a = "pa" ((i+k) % W)
+	    b = "pb" ((i*7+k) % W)
+	    n = "k" k "_" i
+	    printf "%sx .functor XOR 1, %s, %s, C4<0>, C4<0>;\n", n, a, b > vvp
+	    printf "%ss .functor XOR 1, %sx, %s, C4<0>, C4<0>;\n", n, n, c > vvp
+	    printf "%sg .functor AND 1, %s, %s, C4<1>, C4<1>;\n", n, a, b > vvp
+	    printf "%sp .functor AND 1, %sx, %s, C4<1>, C4<1>;\n", n, n, c > vvp
+	    printf "%sc .functor OR 1, %sg, %sp, C4<0>, C4<0>;\n", n, n, n > vvp
+	    c = n "c"
+	}
+	printf "co%d .net \"co%d\", 0 0, %s;\n", k, k, c > vvp
+    }
+    fmt = ""
+    outs = ""
+    for (i = W-1 ; i >= 0 ; i -= 1) {
+	printf "s%d .net \"s%d\", 0 0, k0_%ds;\n", i, i, i > vvp
+	fmt = fmt "%b"
+	outs = outs ", s" i
+    }
+    fmt = fmt " "
+    for (k = 0 ; k < adders ; k += 1) {
+	fmt = fmt "%b"
+	outs = outs ", co" k
+    }
+    outs = substr(outs, 3)
+
+    print "T0 %pushi/vec4 " repeats ", 0, 32;" > vvp
+    print " %store/vec4 cnt, 0, 32;" > vvp
+    print "loop ;" > vvp
+    for (st = 0 ; st < steps ; st += 1) {
+	split("a0 a1 b0 b1", vars, " ")
+	for (v = 1 ; v <= 4 ; v += 1) {
+	    printf " %%pushi/vec4 %.0f, 0, 32;\n", rand32() > vvp
+	    printf " %%store/vec4 %s, 0, 32;\n", vars[v] > vvp
+	}
+	print " %delay 1, 0;" > vvp
+	if (show != "")
+	    display("")
+    }
+    print " %load/vec4 cnt;" > vvp
+    print " %subi 1, 0, 32;" > vvp
+    print " %dup/vec4;" > vvp
+    print " %store/vec4 cnt, 0, 32;" > vvp
+    print " %cmpi/e 0, 0, 32;" > vvp
+    print " %jmp/0 loop, 4;" > vvp
+    display("end ")
+    print " %end;" > vvp
+    print " .thread T0;" > vvp
+    print ":file_names 2;" > vvp
+    print " \"N/A\";" > vvp
+    print " \"<interactive>\";" > vvp
+}'
@@ -0,0 +1,90 @@
+#!/bin/sh
+
+# This is a developer script that makes a synthetic design to measure
+# the cost of $dumpvars. It writes dump_bench.vvp into the current
+# directory. The design has the given number of 32 bit registers and
+# as many 1 bit registers, each with a net that aliases it, and runs
+# for the given number of time steps (1000 by default). In each step
+# every register changes the given number of times (2 by default), as
+# a glitchy design would, and the dumper writes the last value. The
+# registers are dumped to dump_bench.vcd.
+#
+# The .vvp file is written directly, so the compiler is not needed. Run
+# it with the vvp and system.vpi under test, for example:
+#
+#    sh scripts/dump_bench.sh 1000 2000 8
+#    time vvp -M vpi dump_bench.vvp
+#    time vvp -M vpi dump_bench.vvp -fst
+#    time vvp -M vpi dump_bench.vvp -fst -fst-parallel
+#
+# The -fst-parallel run only differs from the -fst run in its wall
+# clock time, and only on a machine with a spare CPU.
+#
+# To see the time that the simulation alone takes, run it with the
+# $dumpvars line removed:
+#
+#    sed /dumpvars/d dump_bench.vvp > dump_none.vvp
+#    time vvp -M vpi dump_none.vvp
+#
+# NOTE: DO NOT INSTALL THIS FILE.
+
+if test $# -lt 1; then
+    echo "Usage: $0 <signals> [<steps> [<changes>]]" 1>&2
+    exit 1
+fi
+
+signals=$1
+steps=${2:-1000}
+changes=${3:-2}
+
+awk -v signals="$signals" -v steps="$steps" -v changes="$changes" '
+BEGIN {
+    vvp = "dump_bench.vvp"
+
+    print ":ivl_version \"12.0\" \"vec4-stack\";" > vvp
+    print ":vpi_module \"system\";" > vvp
+    print ":vpi_time_precision - 9;" > vvp
+    print "main .scope module, \"main\" \"main\" 0 0;" > vvp
+    print " .timescale -9 -9;" > vvp
+    print "cnt .var \"cnt\", 31 0;" > vvp
+    for (i = 0 ; i < signals ; i += 1) {
+	printf "v%d .var \"v%d\", 31 0;\n", i, i > vvp
+	printf "n%d .net \"n%d\", 31 0, v%d;\n", i, i, i > vvp
+	printf "b%d .var \"b%d\", 0 0;\n", i, i > vvp
+	printf "m%d .net \"m%d\", 0 0, b%d;\n", i, i, i > vvp
+    }
+
+    print "T0 %vpi_call 0 0 \"$dumpfile\", \"dump_bench.vcd\" {0 0 0};" > vvp
+    print " %vpi_call 0 0 \"$dumpvars\" {0 0 0};" > vvp
+    print " %pushi/vec4 0, 0, 32;" > vvp
+    print " %store/vec4 cnt, 0, 32;" > vvp
+    print "loop %delay 1, 0;" > vvp
+    for (i = 0 ; i < signals ; i += 1) {
+	for (c = 1 ; c < changes ; c += 1) {
+	    print " %load/vec4 cnt;" > vvp
+	    printf " %%addi %d, 0, 32;\n", c > vvp
+	    print " %inv;" > vvp
+	    printf " %%store/vec4 v%d, 0, 32;\n", i > vvp
+	    printf " %%pushi/vec4 %d, 0, 1;\n", c % 2 > vvp
+	    printf " %%store/vec4 b%d, 0, 1;\n", i > vvp
+	}
+	print " %load/vec4 cnt;" > vvp
+	printf " %%addi %d, 0, 32;\n", i > vvp
+	printf " %%store/vec4 v%d, 0, 32;\n", i > vvp
+	print " %load/vec4 cnt;" > vvp
+	printf " %%parti/u 1, %d, 32;\n", i % 8 > vvp
+	printf " %%store/vec4 b%d, 0, 1;\n", i > vvp
+    }
+    print " %load/vec4 cnt;" > vvp
+    print " %addi 1, 0, 32;" > vvp
+    print " %store/vec4 cnt, 0, 32;" > vvp
+    print " %load/vec4 cnt;" > vvp
+    printf " %%cmpi/u %d, 0, 32;\n", steps > vvp
+    print " %jmp/1 loop, 5;" > vvp
+    printf " %%vpi_call 0 0 \"$display\", \"dumped %d signals for %d steps\" {0 0 0};\n", 2 * signals, steps > vvp
+    print " %end;" > vvp
+    print " .thread T0;" > vvp
+    print ":file_names 2;" > vvp
+    print " \"N/A\";" > vvp
+    print " \"<interactive>\";" > vvp
+}'
@@ -0,0 +1,78 @@
+#!/bin/sh
+
+# This is a developer script that makes a synthetic netlist and SDF file
+# to measure $sdf_annotate on large designs. It writes sdf_bench.vvp and
+# sdf_bench.sdf into the current directory. The netlist has the given
+# number of cells, spread evenly over the given number of group scopes
+# (100 by default). Each cell is a 2 input AND with a modpath from each
+# input, and the SDF file has a CELL entry with an IOPATH for both.
+#
+# The .vvp file is written directly, so the compiler is not needed. Run
+# it with the vvp and system.vpi under test, for example:
+#
+#    sh scripts/sdf_bench.sh 100000
+#    time vvp -M vpi sdf_bench.vvp
+#
+# The time includes loading the design. To see the time that loading
+# alone takes, run the netlist with the $sdf_annotate line removed:
+#
+#    sed /sdf_annotate/d sdf_bench.vvp > sdf_load.vvp
+#    time vvp -M vpi sdf_load.vvp
+#
+# NOTE: DO NOT INSTALL THIS FILE.
+
+if test $# -lt 1; then
+    echo "Usage: $0 <cells> [<groups>]" 1>&2
+    exit 1
+fi
+
+cells=$1
+groups=${2:-100}
+
+awk -v cells="$cells" -v groups="$groups" '
+BEGIN {
+    vvp = "sdf_bench.vvp"
+    sdf = "sdf_bench.sdf"
+    per = int(cells / groups)
+    z = "0,0,0,0,0,0,0,0,0,0,0,0"
+
+    print ":ivl_version \"12.0\" \"vec4-stack\";" > vvp
+    print ":vpi_module \"system\";" > vvp
+    print ":ivl_delay_selection \"TYPICAL\";" > vvp
+    print ":vpi_time_precision - 9;" > vvp
+    print "main .scope module, \"main\" \"main\" 0 0;" > vvp
+    print " .timescale -9 -9;" > vvp
+
+    print "(DELAYFILE (SDFVERSION \"3.0\") (TIMESCALE 1ns)" > sdf
+
+    for (g = 0 ; g < groups ; g += 1) {
+	printf "g%d .scope module, \"g%d\" \"grp\" 0 0, 0 0 0, main;\n", g, g > vvp
+	print " .timescale -9 -9;" > vvp
+	for (i = 0 ; i < per ; i += 1) {
+	    c = "c" g "_" i
+	    printf "%s .scope module, \"u%d\" \"cell\" 0 0, 0 0 0, g%d;\n", c, i, g > vvp
+	    print " .timescale -9 -9;" > vvp
+	    printf "%sr .var \"r\", 0 0;\n", c > vvp
+	    printf "%sa .net \"a\", 0 0, %sr;\n", c, c > vvp
+	    printf "%sb .net \"b\", 0 0, %sr;\n", c, c > vvp
+	    printf "%sf .functor AND 1, %sa, %sb, C4<1>, C4<1>;\n", c, c, c > vvp
+	    printf "%sm .modpath 1 %sf %sy, %sa (%s) %sa, %sb (%s) %sb;\n", c, c, c, c, z, c, c, z, c > vvp
+	    printf "%sy .net \"y\", 0 0, %sm;\n", c, c > vvp
+
+	    printf "(CELL (CELLTYPE \"cell\") (INSTANCE g%d.u%d) (DELAY (ABSOLUTE", g, i > sdf
+	    printf " (IOPATH a y (1:2:3) (4:5:6)) (IOPATH b y (2:3:4) (5:6:7)))))\n" > sdf
+	}
+    }
+
+    print ")" > sdf
+
+    print " .scope main;" > vvp
+    print "T0 ;" > vvp
+    print " %vpi_call 0 0 \"$sdf_annotate\", \"sdf_bench.sdf\" {0 0 0};" > vvp
+    printf " %%vpi_call 0 0 \"$display\", \"annotated %d cells\" {0 0 0};\n", per * groups > vvp
+    print " %end;" > vvp
+    print " .thread T0;" > vvp
+    print ":file_names 2;" > vvp
+    print " \"N/A\";" > vvp
+    print " \"<interactive>\";" > vvp
+}'
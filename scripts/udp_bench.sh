@@ -0,0 +1,125 @@
+#!/bin/sh
+
+# This is a developer script that makes a synthetic netlist of UDPs to
+# measure how quickly vvp delivers values through the net fan-out. It
+# writes udp_bench.vvp into the current directory. The netlist has the
+# given number of UDPs, a mix of combinational and sequential tables of
+# 3 to 12 inputs, each input a random bit of two 32 bit variables. The
+# variables take the given number of random values (100 by default),
+# some with x and z bits, one per time step, and the whole sequence is
+# run the given number of times (100 by default). The outputs of the
+# first 200 UDPs are displayed at the end.
+#
+# The .vvp file is written directly, so the compiler is not needed. If
+# the VVP environment variable is set, the script also runs the netlist
+# with that command. The run is counted with "perf stat" if perf can
+# read the cache counters, and otherwise the user and system times are
+# printed. For example:
+#
+#    VVP="vvp -M vpi" sh scripts/udp_bench.sh 50000
+#
+# NOTE: DO NOT INSTALL THIS FILE.
+
+if test $# -lt 1; then
+    echo "Usage: $0 <udps> [<steps> [<repeats>]]" 1>&2
+    exit 1
+fi
+
+udps=$1
+steps=${2:-100}
+repeats=${3:-100}
+
+cat > udp_bench.vvp <<'EOF'
+:ivl_version "12.0" "vec4-stack";
+:vpi_module "system";
+:vpi_time_precision + 0;
+UMUX .udp/comb "mux", 3, "0?00", "1?01", "?010", "?111", "00?0", "11?1";
+UAND .udp/comb "and12", 12, "0???????????0", "?0??????????0", "??0?????????0", "???0????????0", "????0???????0", "?????0??????0", "??????0?????0", "???????0????0", "????????0???0", "?????????0??0", "??????????0?0", "???????????00", "1111111111111";
+UDFF .udp/sequ "dff", 3, 2, "???10", "?r000", "?r101", "?n??-", "??*0-", "???n-", "0x000", "1x101";
+ULAT7 .udp/sequ "lat7", 7, 0, "?10?????0", "?11?????1", "?0??????-", "?xr?????1", "0x0?????0", "1x1?????1", "???r????-";
+ULAT10 .udp/sequ "lat10", 10, 1, "?10????????0", "?11????????1", "?0?????????-", "?xr????????1", "0x0????????0", "1x1????????1", "???r???????-";
+UDSR .udp/sequ "dffsr", 5, 2, "???00?x", "???01?0", "???10?1", "?????*x", "?r011?0", "?r111?1", "0p011?0", "1p111?1", "?n?11?-", "??*11?-", "?0?11?-", "?1?11?-", "???r1?-", "???1r?-", "0r0x1?0", "1r11x?1", "0?0x1?0", "1?11x?1", "0x011?0", "1x111?1";
+UMUX4 .udp/comb "mux4", 6, "0???000", "1???001", "?0??100", "?1??101", "??0?010", "??1?011", "???0110", "???1111", "0?0?0x0", "1?1?0x1", "?0?01x0", "?1?11x1", "00??x00", "11??x01", "??00x10", "??11x11", "0000xx0", "1111xx1";
+main .scope module, "main" "main" 0 0;
+ .timescale 0 0;
+s0 .var "s0", 31 0;
+s1 .var "s1", 31 0;
+cnt .var "cnt", 31 0;
+EOF
+
+awk -v udps="$udps" -v steps="$steps" -v repeats="$repeats" '
+BEGIN {
+    vvp = "udp_bench.vvp"
+    srand(7)
+    split("UMUX UAND UDFF ULAT7 ULAT10 UDSR UMUX4", kind, " ")
+    split("3 12 3 7 10 5 6", width, " ")
+
+    for (i = 0 ; i < 64 ; i += 1)
+	printf "p%d .part s%d, %d, 1;\n", i, int(i/32), i%32 >> vvp
+
+    fmt = ""
+    outs = ""
+    for (k = 0 ; k < udps ; k += 1) {
+	t = k % 7 + 1
+	ins = ""
+	for (i = 0 ; i < width[t] ; i += 1)
+	    ins = ins ", p" int(rand() * 64)
+	printf "u%d .udp %s%s;\n", k, kind[t], ins >> vvp
+	printf "y%d .net \"y%d\", 0 0, u%d;\n", k, k, k >> vvp
+	if (k < 200) {
+	    fmt = fmt "%b"
+	    outs = outs ", y" k
+	}
+    }
+
+    print "T0 %pushi/vec4 " repeats ", 0, 32;" >> vvp
+    print " %store/vec4 cnt, 0, 32;" >> vvp
+    print "loop ;" >> vvp
+    for (st = 0 ; st < steps ; st += 1) {
+	for (v = 0 ; v < 2 ; v += 1) {
+	    if (rand() < 0.5)
+		continue
+		# About one bit in eight is x or z.
+	    a = 0
+	    b = 0
+	    for (i = 0 ; i < 32 ; i += 1) {
+		bit = 2 ^ i
+		if (rand() < 0.125) {
+		    a += bit
+		    b += bit
+		} else if (rand() < 0.5) {
+		    a += bit
+		}
+	    }
+	    printf " %%pushi/vec4 %.0f, %.0f, 32;\n", a, b >> vvp
+	    printf " %%store/vec4 s%d, 0, 32;\n", v >> vvp
+	}
+	print " %delay 1, 0;" >> vvp
+    }
+    print " %load/vec4 cnt;" >> vvp
+    print " %subi 1, 0, 32;" >> vvp
+    print " %dup/vec4;" >> vvp
+    print " %store/vec4 cnt, 0, 32;" >> vvp
+    print " %cmpi/e 0, 0, 32;" >> vvp
+    print " %jmp/0 loop, 4;" >> vvp
+    printf " %%vpi_call 0 0 \"$display\", \"end %%0t %s\", $time%s {0 0 0};\n", fmt, outs >> vvp
+    print " %end;" >> vvp
+    print " .thread T0;" >> vvp
+    print ":file_names 2;" >> vvp
+    print " \"N/A\";" >> vvp
+    print " \"<interactive>\";" >> vvp
+}'
+
+if test -z "$VVP"; then
+    exit 0
+fi
+
+if perf stat -e cache-misses true > /dev/null 2>&1; then
+    perf stat -e cycles,instructions,cache-references,cache-misses \
+	$VVP udp_bench.vvp
+else
+    echo "perf can not read the cache counters, timing the run instead." 1>&2
+    $VVP udp_bench.vvp
+	# The second line is the user and system time of the run.
+    times
+fi
@@ -177,6 +177,8 @@ static int draw_stask(vhdl_procedural *proc, stmt_container *container,
       return draw_stask_display(proc, container, stmt);
    else if (strcmp(name, "$finish") == 0)
       return draw_stask_finish(proc, container, stmt);
+   else if (strcmp(name, "$ivl_assert_failed") == 0)
+      return 0;  // Added by the compiler for the vvp run time.
    else {
       vhdl_seq_stmt *result = new vhdl_null_stmt();
       ostringstream ss;
@@ -1397,6 +1397,9 @@ static void emit_stmt_repeat(ivl_scope_t scope, ivl_statement_t stmt)
 static void emit_stmt_stask(ivl_scope_t scope, ivl_statement_t stmt)
 {
       unsigned count = ivl_stmt_parm_count(stmt);
+	/* The compiler adds this call to the fail action of an
+	 * assertion for the vvp run time. It is not in the source. */
+      if (strcmp(ivl_stmt_name(stmt), "$ivl_assert_failed") == 0) return;
       fprintf(vlog_out, "%*c%s", get_indent(), ' ', ivl_stmt_name(stmt));
       if (count != 0) {
 	    unsigned idx;
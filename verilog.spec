@@ -105,6 +105,7 @@ rm -rf $RPM_BUILD_ROOT
 %attr(-,root,root) %{_libdir}/ivl%{suff}/vhdl_textio.sft
 %attr(-,root,root) %{_libdir}/ivl%{suff}/vhdl_textio.vpi
 %attr(-,root,root) %{_libdir}/ivl%{suff}/vpi_debug.vpi
+%attr(-,root,root) %{_libdir}/ivl%{suff}/shm_bridge.vpi
 %attr(-,root,root) %{_libdir}/ivl%{suff}/cadpli.vpl
 %attr(-,root,root) %{_libdir}/libvpi%{suff}.a
 %attr(-,root,root) %{_libdir}/libveriuser%{suff}.a
@@ -112,6 +113,7 @@ rm -rf $RPM_BUILD_ROOT
 %attr(-,root,root) %{_libdir}/ivl%{suff}/include/disciplines.vams
 %attr(-,root,root) /usr/include/iverilog%{suff}/ivl_target.h
 %attr(-,root,root) /usr/include/iverilog%{suff}/vpi_user.h
+%attr(-,root,root) /usr/include/iverilog%{suff}/vpi_shm_bridge.h
 %attr(-,root,root) /usr/include/iverilog%{suff}/sv_vpi_user.h
 %attr(-,root,root) /usr/include/iverilog%{suff}/acc_user.h
 %attr(-,root,root) /usr/include/iverilog%{suff}/veriuser.h
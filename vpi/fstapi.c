@@ -1806,8 +1806,9 @@ xc->already_in_flush = 0;
 static void *fstWriterFlushContextPrivate1(void *ctx)
 {
 struct fstWriterContext *xc = (struct fstWriterContext *)ctx;
+struct fstWriterContext *xc_parent = xc->xc_parent; /* xc is freed below */
 
-pthread_mutex_lock(&(xc->xc_parent->mutex));
+pthread_mutex_lock(&(xc_parent->mutex));
 fstWriterFlushContextPrivate2(xc);
 
 #ifdef FST_REMOVE_DUPLICATE_VC
@@ -1818,8 +1819,8 @@ free(xc->vchg_mem);
 tmpfile_close(&xc->tchn_handle, &xc->tchn_handle_nam);
 free(xc);
 
-xc->xc_parent->in_pthread = 0;
-pthread_mutex_unlock(&(xc->xc_parent->mutex));
+xc_parent->in_pthread = 0;
+pthread_mutex_unlock(&(xc_parent->mutex));
 
 return(NULL);
 }
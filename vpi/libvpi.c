@@ -284,6 +284,22 @@ void vpip_set_return_value(int value)
       assert(vpip_routines);
       vpip_routines->set_return_value(value);
 }
+int vpip_get_return_value(void)
+{
+      assert(vpip_routines);
+      return vpip_routines->get_return_value();
+}
+PLI_INT32 vpip_fork_server(const char*path)
+{
+      assert(vpip_routines);
+      return vpip_routines->fork_server(path);
+}
+PLI_INT32 vpip_get_vecval_multi(PLI_INT32 count, const vpiHandle*refs,
+				s_vpi_vecval*vals)
+{
+      assert(vpip_routines);
+      return vpip_routines->get_vecval_multi(count, refs, vals);
+}
 
 DLLEXPORT PLI_UINT32 vpip_set_callback(vpip_routines_s*routines, PLI_UINT32 version)
 {
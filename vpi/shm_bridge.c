@@ -0,0 +1,444 @@
+/*
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The $shm_bridge("path", signals...) system task shares the listed
+ * signals with another process through a memory mapped file. The
+ * layout of the file is described in vpi_shm_bridge.h. A file in
+ * /dev/shm is not backed by a disk, so it is plain shared memory.
+ *
+ * The values of the signals are published at the read-only sync of
+ * each time step, with one vpip_get_vecval_multi call straight into
+ * the shared memory, and the commands that the other process queued
+ * are applied at the start of the next time step.
+ */
+# include  "sv_vpi_user.h"
+# include  "vpi_shm_bridge.h"
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+#ifndef __MINGW32__
+# include  <time.h>
+# include  <unistd.h>
+# include  <sys/mman.h>
+# include  <sys/stat.h>
+#endif
+
+#ifndef __MINGW32__
+
+  /* The number of slots in the command ring. */
+# define CMD_SLOTS 256
+
+  /* The longest sleep of the lockstep wait, in nanoseconds. */
+# define MAX_NAP 1000000
+
+struct shm_bridge {
+      char*path;
+      struct shm_bridge_header*head;
+      struct shm_bridge_vecval*values;
+      char*cmds;
+      size_t slot_size;
+      PLI_INT32 nsignals;
+      vpiHandle*signals;
+};
+
+static size_t align8(size_t val)
+{
+      return (val + 7) & ~(size_t)7;
+}
+
+static uint64_t current_time(void)
+{
+      s_vpi_time now;
+      now.type = vpiSimTime;
+      vpi_get_time(0, &now);
+      return ((uint64_t)now.high << 32) | now.low;
+}
+
+static void publish_values(struct shm_bridge*br)
+{
+      struct shm_bridge_header*head = br->head;
+      uint64_t seq = head->seq;
+
+      __atomic_store_n(&head->seq, seq+1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_RELEASE);
+
+      vpip_get_vecval_multi(br->nsignals, br->signals,
+			    (s_vpi_vecval*)br->values);
+      head->time = current_time();
+
+      __atomic_store_n(&head->seq, seq+2, __ATOMIC_RELEASE);
+}
+
+static void apply_commands(struct shm_bridge*br)
+{
+      struct shm_bridge_header*head = br->head;
+      uint32_t tail = head->cmd_tail;
+      uint32_t end = __atomic_load_n(&head->cmd_head, __ATOMIC_ACQUIRE);
+      uint64_t now = current_time();
+
+      for ( ;  tail != end ;  tail += 1) {
+	    struct shm_bridge_cmd*cmd = (struct shm_bridge_cmd*)
+		  (br->cmds + (tail % CMD_SLOTS) * br->slot_size);
+	    s_vpi_value val;
+
+	    if (cmd->signal >= (uint32_t)br->nsignals)
+		  continue;
+
+	    val.format = vpiVectorVal;
+	    val.value.vector = (s_vpi_vecval*)(cmd + 1);
+
+	    if (cmd->time > now) {
+		  s_vpi_time delay;
+		  delay.type = vpiSimTime;
+		  delay.high = (PLI_UINT32)((cmd->time - now) >> 32);
+		  delay.low  = (PLI_UINT32)(cmd->time - now);
+		  vpi_put_value(br->signals[cmd->signal], &val, &delay,
+				vpiTransportDelay);
+	    } else {
+		  vpi_put_value(br->signals[cmd->signal], &val, 0, vpiNoDelay);
+	    }
+      }
+
+      __atomic_store_n(&head->cmd_tail, tail, __ATOMIC_RELEASE);
+}
+
+static PLI_INT32 next_time_cb(p_cb_data cause);
+
+static PLI_INT32 read_only_cb(p_cb_data cause)
+{
+      struct shm_bridge*br = (struct shm_bridge*)cause->user_data;
+      struct shm_bridge_header*head = br->head;
+
+      publish_values(br);
+
+	/* In lockstep, wait for the client to see this time step. The
+	   wait sleeps, for twice as long each time up to MAX_NAP, so a
+	   quick client is answered quickly and a slow one does not keep
+	   a CPU busy. A client that stops answering drops the bridge
+	   out of lockstep, so the simulation is not stuck behind a dead
+	   client. */
+      if (__atomic_load_n(&head->lockstep, __ATOMIC_ACQUIRE)) {
+	    time_t start = time(0);
+	    struct timespec nap;
+	    nap.tv_sec = 0;
+	    nap.tv_nsec = 1000;
+	    while (__atomic_load_n(&head->lockstep, __ATOMIC_ACQUIRE)
+		   && __atomic_load_n(&head->ack, __ATOMIC_ACQUIRE) < head->seq) {
+		  nanosleep(&nap, 0);
+		  if (nap.tv_nsec < MAX_NAP)
+			nap.tv_nsec *= 2;
+		  if (time(0) - start < SHM_BRIDGE_LOCKSTEP_TIMEOUT)
+			continue;
+		  vpi_printf("WARNING: $shm_bridge(\"%s\"): no answer from "
+			     "the client in %d seconds, leaving lockstep.\n",
+			     br->path, SHM_BRIDGE_LOCKSTEP_TIMEOUT);
+		  __atomic_store_n(&head->lockstep, 0, __ATOMIC_RELEASE);
+	    }
+      }
+
+      return 0;
+}
+
+static void schedule_read_only(struct shm_bridge*br)
+{
+      s_vpi_time time;
+      s_cb_data cb;
+
+      time.type = vpiSimTime;
+      time.high = 0;
+      time.low  = 0;
+
+      cb.reason = cbReadOnlySynch;
+      cb.cb_rtn = read_only_cb;
+      cb.obj = 0;
+      cb.time = &time;
+      cb.value = 0;
+      cb.user_data = (char*)br;
+      vpi_register_cb(&cb);
+}
+
+static void schedule_next_time(struct shm_bridge*br)
+{
+      s_cb_data cb;
+
+      cb.reason = cbNextSimTime;
+      cb.cb_rtn = next_time_cb;
+      cb.obj = 0;
+      cb.time = 0;
+      cb.value = 0;
+      cb.user_data = (char*)br;
+      vpi_register_cb(&cb);
+}
+
+static PLI_INT32 next_time_cb(p_cb_data cause)
+{
+      struct shm_bridge*br = (struct shm_bridge*)cause->user_data;
+
+      apply_commands(br);
+      schedule_read_only(br);
+      schedule_next_time(br);
+      return 0;
+}
+
+static PLI_INT32 finish_cb(p_cb_data cause)
+{
+      struct shm_bridge*br = (struct shm_bridge*)cause->user_data;
+
+      publish_values(br);
+      __atomic_store_n(&br->head->finished, 1, __ATOMIC_RELEASE);
+
+      munmap(br->head, br->head->size);
+      free(br->signals);
+      free(br->path);
+      free(br);
+      return 0;
+}
+
+static int is_vector_signal(vpiHandle item)
+{
+      switch (vpi_get(vpiType, item)) {
+	  case vpiNet:
+	  case vpiReg:
+	  case vpiIntegerVar:
+	  case vpiBitVar:
+	  case vpiByteVar:
+	  case vpiShortIntVar:
+	  case vpiIntVar:
+	  case vpiLongIntVar:
+	    return 1;
+	  default:
+	    return 0;
+      }
+}
+
+static void bridge_error(vpiHandle callh, const char*name, const char*msg)
+{
+      vpi_printf("ERROR: %s:%d: ", vpi_get_str(vpiFile, callh),
+		 (int)vpi_get(vpiLineNo, callh));
+      vpi_printf("%s %s\n", name, msg);
+      vpip_set_return_value(1);
+      vpi_control(vpiFinish, 1);
+}
+
+static PLI_INT32 shm_bridge_compiletf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
+      vpiHandle argv = vpi_iterate(vpiArgument, callh);
+      vpiHandle item;
+
+      if (argv == 0 || vpi_scan(argv) == 0) {
+	    bridge_error(callh, name, "requires a file name and signals.");
+	    return 0;
+      }
+
+      while ((item = vpi_scan(argv))) {
+	    if (! is_vector_signal(item)) {
+		  bridge_error(callh, name, "arguments after the file name "
+			       "must be vector signals.");
+		  vpi_free_object(argv);
+		  return 0;
+	    }
+      }
+
+      return 0;
+}
+
+static PLI_INT32 shm_bridge_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
+      vpiHandle argv = vpi_iterate(vpiArgument, callh);
+      vpiHandle item;
+      s_vpi_value val;
+      s_vpi_vlog_info vlog_info;
+      struct shm_bridge*br;
+      struct shm_bridge_header*head;
+      struct shm_bridge_signal*sigs;
+      PLI_INT32 idx;
+      uint32_t nwords = 0, cmd_words = 1;
+      size_t size;
+      s_cb_data cb;
+      char*tmp_path;
+      mode_t mask;
+      void*mem;
+      int fd;
+
+      val.format = vpiStringVal;
+      vpi_get_value(vpi_scan(argv), &val);
+
+      br = (struct shm_bridge*)calloc(1, sizeof(struct shm_bridge));
+      br->path = strdup(val.value.str);
+
+      while ((item = vpi_scan(argv))) {
+	    br->signals = (vpiHandle*)realloc(br->signals,
+			      (br->nsignals+1) * sizeof(vpiHandle));
+	    br->signals[br->nsignals++] = item;
+      }
+
+      for (idx = 0 ;  idx < br->nsignals ;  idx += 1) {
+	    uint32_t words = (vpi_get(vpiSize, br->signals[idx]) + 31) / 32;
+	    nwords += words;
+	    if (words > cmd_words)
+		  cmd_words = words;
+      }
+
+      br->slot_size = sizeof(struct shm_bridge_cmd)
+		    + cmd_words * sizeof(struct shm_bridge_vecval);
+
+      size = align8(sizeof(struct shm_bridge_header));
+      size += br->nsignals * sizeof(struct shm_bridge_signal);
+      size += nwords * sizeof(struct shm_bridge_vecval);
+      size += CMD_SLOTS * br->slot_size;
+
+	/* Build the file under a temporary name and rename it into
+	   place. A client may still have an old file of the same name
+	   mapped, and truncating that file would fault the client. */
+      tmp_path = (char*)malloc(strlen(br->path) + 8);
+      sprintf(tmp_path, "%s.XXXXXX", br->path);
+      fd = mkstemp(tmp_path);
+      mask = umask(0);
+      umask(mask);
+      if (fd < 0 || fchmod(fd, 0666 & ~mask) < 0
+	  || ftruncate(fd, size) < 0) {
+	    perror(br->path);
+	    bridge_error(callh, name, "is unable to create the file.");
+	    if (fd >= 0) {
+		  close(fd);
+		  unlink(tmp_path);
+	    }
+	    free(tmp_path);
+	    free(br->signals);
+	    free(br->path);
+	    free(br);
+	    return 0;
+      }
+
+      mem = mmap(0, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);
+      if (mem == MAP_FAILED) {
+	    perror(br->path);
+	    bridge_error(callh, name, "is unable to map the file.");
+	    unlink(tmp_path);
+	    free(tmp_path);
+	    free(br->signals);
+	    free(br->path);
+	    free(br);
+	    return 0;
+      }
+
+      head = (struct shm_bridge_header*)mem;
+      head->size = size;
+      head->nsignals = br->nsignals;
+      head->signals_off = align8(sizeof(struct shm_bridge_header));
+      head->values_off = head->signals_off
+		       + br->nsignals * sizeof(struct shm_bridge_signal);
+      head->cmds_off = head->values_off
+		     + nwords * sizeof(struct shm_bridge_vecval);
+      head->cmd_slots = CMD_SLOTS;
+      head->cmd_words = cmd_words;
+
+      br->head = head;
+      br->values = (struct shm_bridge_vecval*)((char*)mem + head->values_off);
+      br->cmds = (char*)mem + head->cmds_off;
+
+      sigs = (struct shm_bridge_signal*)((char*)mem + head->signals_off);
+      nwords = 0;
+      for (idx = 0 ;  idx < br->nsignals ;  idx += 1) {
+	    strncpy(sigs[idx].name, vpi_get_str(vpiFullName, br->signals[idx]),
+		    sizeof sigs[idx].name - 1);
+	    sigs[idx].width = vpi_get(vpiSize, br->signals[idx]);
+	    sigs[idx].word = nwords;
+	    nwords += (sigs[idx].width + 31) / 32;
+      }
+
+	/* The -shm-bridge-lockstep extended argument starts the bridge
+	   in lockstep, so that the client does not miss any steps. */
+      vpi_get_vlog_info(&vlog_info);
+      for (idx = 0 ;  idx < vlog_info.argc ;  idx += 1) {
+	    if (strcmp(vlog_info.argv[idx], "-shm-bridge-lockstep") == 0)
+		  head->lockstep = 1;
+      }
+
+      publish_values(br);
+
+	/* Write the magic number last, so the rest of the header is
+	   complete when a client sees it. */
+      head->version = SHM_BRIDGE_VERSION;
+      __atomic_store_n(&head->magic, SHM_BRIDGE_MAGIC, __ATOMIC_RELEASE);
+
+      if (rename(tmp_path, br->path) < 0) {
+	    perror(br->path);
+	    bridge_error(callh, name, "is unable to create the file.");
+	    unlink(tmp_path);
+	    free(tmp_path);
+	    munmap(mem, size);
+	    free(br->signals);
+	    free(br->path);
+	    free(br);
+	    return 0;
+      }
+      free(tmp_path);
+
+      schedule_read_only(br);
+      schedule_next_time(br);
+
+      cb.reason = cbEndOfSimulation;
+      cb.cb_rtn = finish_cb;
+      cb.obj = 0;
+      cb.time = 0;
+      cb.value = 0;
+      cb.user_data = (char*)br;
+      vpi_register_cb(&cb);
+
+      return 0;
+}
+
+#else
+
+static PLI_INT32 shm_bridge_compiletf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      (void)name; /* Parameter is not used. */
+      return 0;
+}
+
+static PLI_INT32 shm_bridge_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      vpi_printf("SORRY: %s is not supported on this system.\n", name);
+      return 0;
+}
+
+#endif
+
+void sys_register(void)
+{
+      s_vpi_systf_data tf_data;
+      vpiHandle res;
+
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$shm_bridge";
+      tf_data.calltf    = shm_bridge_calltf;
+      tf_data.compiletf = shm_bridge_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$shm_bridge";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+}
+
+void (*vlog_startup_routines[])(void) = {
+      sys_register,
+      0
+};
@@ -63,25 +63,54 @@ static PLI_INT32 my_mcd_printf(PLI_UINT32 mcd, const char *fmt, ...)
       return r;
 }
 
+/* Raw write wrapper to handle both MCD/FD. The runtime writes the
+ * output so that it can buffer it. */
 static void my_mcd_rawwrite(PLI_UINT32 mcd, const char*buf, size_t count)
 {
-      if (IS_MCD(mcd)) {
-	    vpip_mcd_rawwrite(mcd, buf, count);
-      } else {
-	    FILE*fp = vpi_get_file(mcd);
-	    if (fp) {
-		  while (count > 0) {
-			size_t rc = fwrite(buf, 1, count, fp);
-			if (rc == 0) break;
-			count -= rc;
-			buf += rc;
-		  }
-	    }
-      }
+      vpip_mcd_rawwrite(mcd, buf, count);
 }
 
 struct timeformat_info_s timeformat_info = { 0, 0, 0, 20 };
 
+/*
+ * A format string that is a constant is compiled once into a list of
+ * ops, so that it is not read and parsed again for each display. A
+ * FMT_LIT op copies a span of the text, and a FMT_SPEC op is a format
+ * specifier with its flags already decoded.
+ */
+enum format_op_type { FMT_LIT, FMT_SPEC };
+
+struct format_op {
+      enum format_op_type type;
+	/* FMT_LIT: the span of the program text to copy. */
+      unsigned off, len;
+	/* FMT_SPEC: the decoded specifier. */
+      char fmt;
+      char ljust, plus, ld_zero;
+      int width, prec;
+	/* FMT_SPEC: the argument that the specifier is expected to use,
+	   and if it is a vector that can be converted without going
+	   through vpi_get_value, what the conversion needs. */
+      unsigned arg;
+      unsigned fast;
+      unsigned size;
+      int is_signed;
+      int dec_size;
+};
+
+struct format_prog {
+      char*text;
+      unsigned nops;
+      struct format_op*ops;
+};
+
+/* The output of a display is built up in one of these. */
+struct display_buf {
+      char*data;
+      unsigned len;
+      unsigned cap;
+};
+
 struct strobe_cb_info {
       const char*name;
       char*filename;
@@ -91,6 +120,9 @@ struct strobe_cb_info {
       vpiHandle*items;
       unsigned nitems;
       unsigned fd_mcd;
+	/* The compiled string constant items, if they are kept from
+	   call to call, or nil. */
+      struct format_prog**progs;
 };
 
 /*
@@ -928,6 +960,323 @@ static unsigned int get_format(char **rtn, char *fmt,
   return size - 1;
 }
 
+/* Make sure there is room for cnt more characters and an EOS. */
+static void display_buf_need(struct display_buf *buf, unsigned cnt)
+{
+  if (buf->len + cnt + 1 > buf->cap) {
+    buf->cap = 2*buf->cap;
+    if (buf->cap < buf->len + cnt + 1) buf->cap = buf->len + cnt + 1;
+    if (buf->cap < 256) buf->cap = 256;
+    buf->data = realloc(buf->data, buf->cap*sizeof(char));
+  }
+}
+
+static void display_buf_append(struct display_buf *buf, const char *str,
+                               unsigned cnt)
+{
+  display_buf_need(buf, cnt);
+  memcpy(buf->data+buf->len, str, cnt);
+  buf->len += cnt;
+}
+
+/* Append cnt copies of the character ch. */
+static void display_buf_fill(struct display_buf *buf, char ch, unsigned cnt)
+{
+  display_buf_need(buf, cnt);
+  memset(buf->data+buf->len, ch, cnt);
+  buf->len += cnt;
+}
+
+static struct format_op *format_prog_add(struct format_prog *prog)
+{
+  struct format_op *op;
+
+  prog->ops = realloc(prog->ops, (prog->nops+1)*sizeof(struct format_op));
+  op = prog->ops + prog->nops;
+  prog->nops += 1;
+  memset(op, 0, sizeof(struct format_op));
+  return op;
+}
+
+/* Can the value of this argument be read as vector words and converted
+ * here? This is the case for the simple vector variables and nets. */
+static int is_fast_vector(vpiHandle item)
+{
+  switch (vpi_get(vpiType, item)) {
+    case vpiNet:
+    case vpiReg:
+    case vpiIntegerVar:
+    case vpiBitVar:
+    case vpiByteVar:
+    case vpiShortIntVar:
+    case vpiIntVar:
+    case vpiLongIntVar:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/* Compile the format string fmt. This parses the format the same way
+ * get_format does, and follows the arguments that the specifiers use
+ * starting at *idx, so each specifier knows its argument. */
+static struct format_prog *compile_format(const char *fmt,
+                                          const struct strobe_cb_info *info,
+                                          unsigned int *idx)
+{
+  struct format_prog *prog = calloc(1, sizeof(struct format_prog));
+  char *cp;
+
+  prog->text = strdup(fmt);
+  cp = prog->text;
+  while (*cp) {
+    size_t cnt = strcspn(cp, "%");
+    struct format_op *op = format_prog_add(prog);
+
+    if (cnt > 0) {
+      op->type = FMT_LIT;
+      op->off = cp - prog->text;
+      op->len = cnt;
+      cp += cnt;
+      continue;
+    }
+
+    op->type = FMT_SPEC;
+    op->width = -1;
+    op->prec = -1;
+    cp += 1;
+    while ((*cp == '-') || (*cp == '+')) {
+      if (*cp == '-') op->ljust = 1;
+      else op->plus = 1;
+      cp += 1;
+    }
+    if (*cp == '0') {
+      op->ld_zero = 1;
+      cp += 1;
+    }
+    if (isdigit((int)*cp)) op->width = strtoul(cp, &cp, 10);
+    if (*cp == '.') {
+      cp += 1;
+      op->prec = strtoul(cp, &cp, 10);
+    }
+    op->fmt = *cp;
+    if (*cp) cp += 1;
+
+      /* These are the specifiers that use an argument. */
+    if (op->fmt == 0 || strchr("bBoOhHxXcCdDeEfFgGsStTuUvVzZ", op->fmt) == 0)
+      continue;
+    *idx += 1;
+    op->arg = *idx;
+    if (*idx >= info->nitems) continue;
+
+      /* The binary, octal, hex and decimal conversions of a vector
+       * without flags that only produce warnings are done here. */
+    if (strchr("bBoOhHxXdD", op->fmt) && op->plus == 0 && op->prec == -1 &&
+        is_fast_vector(info->items[*idx])) {
+      op->size = vpi_get(vpiSize, info->items[*idx]);
+      op->is_signed = vpi_get(vpiSigned, info->items[*idx]) == 1;
+      op->dec_size = calc_dec_size(op->size, op->is_signed);
+      op->fast = op->size > 0 && (op->size <= 64 ||
+                                  (op->fmt != 'd' && op->fmt != 'D'));
+    }
+  }
+
+  return prog;
+}
+
+static void free_format_prog(struct format_prog *prog)
+{
+  free(prog->text);
+  free(prog->ops);
+  free(prog);
+}
+
+/* Compile the string constant items of the info. */
+static void compile_display_progs(struct strobe_cb_info *info)
+{
+  s_vpi_value value;
+  unsigned int idx;
+
+  info->progs = calloc(info->nitems, sizeof(struct format_prog*));
+  for (idx = 0; idx < info->nitems; idx += 1) {
+    vpiHandle item = info->items[idx];
+    PLI_INT32 type = vpi_get(vpiType, item);
+
+    if ((type == vpiConstant || type == vpiParameter) &&
+        vpi_get(vpiConstType, item) == vpiStringConst) {
+      unsigned int at = idx;
+      value.format = vpiStringVal;
+      vpi_get_value(item, &value);
+      info->progs[at] = compile_format(value.value.str, info, &idx);
+    }
+  }
+}
+
+static void free_display_progs(struct strobe_cb_info *info)
+{
+  unsigned int idx;
+
+  if (info->progs == 0) return;
+  for (idx = 0; idx < info->nitems; idx += 1) {
+    if (info->progs[idx]) free_format_prog(info->progs[idx]);
+  }
+  free(info->progs);
+  info->progs = 0;
+}
+
+/* The buffers of format_fast, which are kept from call to call. */
+static s_vpi_vecval *fast_vals = 0;
+static unsigned fast_nvals = 0;
+static char *fast_digits = 0;
+static unsigned fast_ndigits = 0;
+
+/* Convert the value of the argument of a fast op and append it to the
+ * buffer, padded like get_format_char does. This returns 0 and appends
+ * nothing if the value has x or z bits, which are left to the general
+ * conversion. */
+static int format_fast(struct display_buf *buf, const struct format_op *op,
+                       vpiHandle item)
+{
+  s_vpi_vecval *vals;
+  char *digits;
+  unsigned nwords = (op->size + 31) / 32;
+  unsigned word, len, zeros, total, width;
+  int negative = 0;
+  char *cp;
+
+  if (nwords > fast_nvals) {
+    fast_nvals = nwords;
+    fast_vals = realloc(fast_vals, fast_nvals*sizeof(s_vpi_vecval));
+  }
+  vals = fast_vals;
+  if (vpip_get_vecval_multi(1, &item, vals) < 0) return 0;
+  for (word = 0; word < nwords; word += 1) {
+    if (vals[word].bval) return 0;
+  }
+
+  if (op->size + 2 > fast_ndigits) {
+    fast_ndigits = op->size + 2;
+    fast_digits = realloc(fast_digits, fast_ndigits*sizeof(char));
+  }
+  digits = fast_digits;
+
+  if (op->fmt == 'd' || op->fmt == 'D') {
+    PLI_UINT64 bits = (PLI_UINT32)vals[0].aval;
+    PLI_UINT64 mask = ~(PLI_UINT64)0;
+    char tmp[24];
+    unsigned cnt = 0;
+
+    if (nwords > 1) bits |= (PLI_UINT64)(PLI_UINT32)vals[1].aval << 32;
+    if (op->size < 64) mask = ((PLI_UINT64)1 << op->size) - 1;
+    bits &= mask;
+    if (op->is_signed && (bits >> (op->size-1)) & 1) {
+      negative = 1;
+      bits = (~bits + 1) & mask;
+    }
+    do {
+      tmp[cnt++] = '0' + (char)(bits % 10);
+      bits /= 10;
+    } while (bits);
+    len = 0;
+    while (cnt > 0) digits[len++] = tmp[--cnt];
+    digits[len] = 0;
+
+  } else {
+    unsigned shift, dig, ndig;
+
+    switch (op->fmt) {
+      case 'b':
+      case 'B':
+        shift = 1;
+        break;
+      case 'o':
+      case 'O':
+        shift = 3;
+        break;
+      default:
+        shift = 4;
+        break;
+    }
+
+      /* The digits are made from the least significant end. */
+    ndig = (op->size + shift - 1) / shift;
+    for (dig = 0; dig < ndig; dig += 1) {
+      unsigned pos = dig * shift;
+      unsigned off = pos % 32;
+      PLI_UINT32 val = (PLI_UINT32)vals[pos/32].aval >> off;
+      if (off + shift > 32 && pos/32 + 1 < nwords)
+        val |= (PLI_UINT32)vals[pos/32 + 1].aval << (32 - off);
+      val &= (1U << shift) - 1;
+      if (pos + shift > op->size) val &= (1U << (op->size - pos)) - 1;
+      digits[ndig-dig-1] = "0123456789abcdef"[val];
+    }
+    digits[ndig] = 0;
+    len = ndig;
+  }
+
+  cp = digits;
+  zeros = 0;
+  width = op->width == -1 ? 0 : (unsigned)op->width;
+  if (op->fmt == 'd' || op->fmt == 'D') {
+    if (op->ljust == 0 && op->ld_zero == 1 && (int)(len+negative) < op->width)
+      zeros = op->width - (len+negative);
+    if (op->width == -1) width = op->ld_zero == 1 ? 0 : op->dec_size;
+  } else if (op->ld_zero == 1) {
+      /* Strip the leading zeros if a width is not given or the value
+       * is left aligned, otherwise pad with zeros. */
+    if (op->width == -1 || op->ljust != 0) {
+      while (*cp == '0' && *(cp+1) != '\0') {
+        cp += 1;
+        len -= 1;
+      }
+    } else if ((int)len < op->width) {
+      zeros = op->width - len;
+    }
+  }
+
+  total = negative + zeros + len;
+  if (op->ljust == 0 && total < width) display_buf_fill(buf, ' ', width-total);
+  if (negative) display_buf_append(buf, "-", 1);
+  display_buf_fill(buf, '0', zeros);
+  display_buf_append(buf, cp, len);
+  if (op->ljust != 0 && total < width) display_buf_fill(buf, ' ', width-total);
+  return 1;
+}
+
+/* Run a compiled format and append the result to the buffer. The ops
+ * only take the fast path if the arguments are used as they were when
+ * the format was compiled, which is not so if a string variable that
+ * was interpreted as a format comes before. */
+static void run_format_prog(struct display_buf *buf,
+                            const struct format_prog *prog,
+                            const struct strobe_cb_info *info,
+                            unsigned int *idx)
+{
+  unsigned int ndx;
+
+  for (ndx = 0; ndx < prog->nops; ndx += 1) {
+    const struct format_op *op = prog->ops + ndx;
+    char *result;
+    unsigned int cnt;
+
+    if (op->type == FMT_LIT) {
+      display_buf_append(buf, prog->text+op->off, op->len);
+      continue;
+    }
+
+    if (op->fast && op->arg == *idx + 1 &&
+        format_fast(buf, op, info->items[op->arg])) {
+      *idx += 1;
+      continue;
+    }
+
+    cnt = get_format_char(&result, op->ljust, op->plus, op->ld_zero,
+                          op->width, op->prec, op->fmt, info, idx);
+    display_buf_append(buf, result, cnt);
+    free(result);
+  }
+}
+
 static unsigned int get_numeric(char **rtn, const struct strobe_cb_info *info,
                                 vpiHandle item)
 {
@@ -957,16 +1306,16 @@ static unsigned int get_numeric(char **rtn, const struct strobe_cb_info *info,
 
 /* In many places we can't use the normal str functions since %u and %z
  * can insert NULL characters into the stream. */
-static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
+static void get_display_buf(struct display_buf *dbuf,
+                            const struct strobe_cb_info *info)
 {
-  char *result, *fmt, *rtn, *func_name;
+  char *result, *fmt, *func_name;
   const char *cresult;
   s_vpi_value value;
-  unsigned int idx, size, width;
+  unsigned int idx, width;
   char buf[256];
 
-  rtn = strdup("");
-  size = 1;
+  display_buf_need(dbuf, 0);
   for  (idx = 0; idx < info->nitems; idx += 1) {
     vpiHandle item = info->items[idx];
 
@@ -975,11 +1324,16 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
       case vpiConstant:
       case vpiParameter:
         if (vpi_get(vpiConstType, item) == vpiStringConst) {
-          value.format = vpiStringVal;
-          vpi_get_value(item, &value);
-          fmt = strdup(value.value.str);
-          width = get_format(&result, fmt, info, &idx);
-          free(fmt);
+          if (info->progs && info->progs[idx]) {
+            run_format_prog(dbuf, info->progs[idx], info, &idx);
+            break;
+          } else {
+            value.format = vpiStringVal;
+            vpi_get_value(item, &value);
+            fmt = strdup(value.value.str);
+            width = get_format(&result, fmt, info, &idx);
+            free(fmt);
+          }
         } else if (vpi_get(vpiConstType, item) == vpiRealConst) {
           value.format = vpiRealVal;
           vpi_get_value(item, &value);
@@ -1000,8 +1354,7 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
         } else {
           width = get_numeric(&result, info, item);
         }
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        memcpy(rtn+size-1, result, width);
+        display_buf_append(dbuf, result, width);
         free(result);
         break;
 
@@ -1016,8 +1369,7 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
       case vpiMemoryWord:
       case vpiPartSelect:
         width = get_numeric(&result, info, item);
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        memcpy(rtn+size-1, result, width);
+        display_buf_append(dbuf, result, width);
         free(result);
         break;
 
@@ -1031,8 +1383,9 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
                  vpi_get(vpiTimeUnit, info->scope));
         width = strlen(buf);
         if (width  < timeformat_info.width) width = timeformat_info.width;
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        sprintf(rtn+size-1, "%*s", width, buf);
+        display_buf_need(dbuf, width);
+        sprintf(dbuf->data+dbuf->len, "%*s", width, buf);
+        dbuf->len += width;
         break;
 
       /* Realtime variables are also processed here. */
@@ -1052,8 +1405,7 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
         sprintf(buf, compatible_flag ? "%g" : "%#g", value.value.real);
 #endif
         width = strlen(buf);
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        memcpy(rtn+size-1, buf, width);
+        display_buf_append(dbuf, buf, width);
         break;
 
        /* Process string variables like string constants: interpret
@@ -1064,8 +1416,7 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
 	fmt = strdup(value.value.str);
 	width = get_format(&result, fmt, info, &idx);
 	free(fmt);
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        memcpy(rtn+size-1, result, width);
+        display_buf_append(dbuf, result, width);
         free(result);
 	break;
 
@@ -1076,24 +1427,27 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
           vpi_get_value(item, &value);
           width = strlen(value.value.str);
           if (width  < 20) width = 20;
-          rtn = realloc(rtn, (size+width)*sizeof(char));
-          sprintf(rtn+size-1, "%*s", width, value.value.str);
+          display_buf_need(dbuf, width);
+          sprintf(dbuf->data+dbuf->len, "%*s", width, value.value.str);
+          dbuf->len += width;
 
         } else if (strcmp(func_name, "$stime") == 0) {
           value.format = vpiDecStrVal;
           vpi_get_value(item, &value);
           width = strlen(value.value.str);
           if (width  < 10) width = 10;
-          rtn = realloc(rtn, (size+width)*sizeof(char));
-          sprintf(rtn+size-1, "%*s", width, value.value.str);
+          display_buf_need(dbuf, width);
+          sprintf(dbuf->data+dbuf->len, "%*s", width, value.value.str);
+          dbuf->len += width;
 
         } else if (strcmp(func_name, "$simtime") == 0) {
           value.format = vpiDecStrVal;
           vpi_get_value(item, &value);
           width = strlen(value.value.str);
           if (width  < 20) width = 20;
-          rtn = realloc(rtn, (size+width)*sizeof(char));
-          sprintf(rtn+size-1, "%*s", width, value.value.str);
+          display_buf_need(dbuf, width);
+          sprintf(dbuf->data+dbuf->len, "%*s", width, value.value.str);
+          dbuf->len += width;
 
         } else if (strcmp(func_name, "$realtime") == 0) {
           /* Use the local scope precision. */
@@ -1104,16 +1458,16 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
           vpi_get_value(item, &value);
           sprintf(buf, "%.*f", use_prec, value.value.real);
           width = strlen(buf);
-          rtn = realloc(rtn, (size+width)*sizeof(char));
-          sprintf(rtn+size-1, "%*s", width, buf);
+          display_buf_need(dbuf, width);
+          sprintf(dbuf->data+dbuf->len, "%*s", width, buf);
+          dbuf->len += width;
 
         } else {
           vpi_printf("WARNING: %s:%d: %s does not support %s as an argument!\n",
                      info->filename, info->lineno, info->name, func_name);
           strcpy(buf, "<?>");
           width = strlen(buf);
-          rtn = realloc(rtn, (size+width)*sizeof(char));
-          memcpy(rtn+size-1, buf, width);
+          display_buf_append(dbuf, buf, width);
         }
         break;
 
@@ -1123,15 +1477,20 @@ static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
                    info->name);
         cresult = "<?>";
         width = strlen(cresult);
-        rtn = realloc(rtn, (size+width)*sizeof(char));
-        memcpy(rtn+size-1, cresult, width);
+        display_buf_append(dbuf, cresult, width);
         break;
     }
-    size += width;
   }
-  rtn[size-1] = '\0';
-  *rtnsz = size - 1;
-  return rtn;
+  dbuf->data[dbuf->len] = '\0';
+}
+
+static char *get_display(unsigned int *rtnsz, const struct strobe_cb_info *info)
+{
+  struct display_buf dbuf = { 0, 0, 0 };
+
+  get_display_buf(&dbuf, info);
+  *rtnsz = dbuf.len;
+  return dbuf.data;
 }
 
 #ifdef BR916_STOPGAP_FIX
@@ -1267,25 +1626,82 @@ static PLI_INT32 sys_display_compiletf(ICARUS_VPI_CONST PLI_BYTE8*name)
       return sys_common_compiletf(name, 0, 0);
 }
 
+/*
+ * Each $display, $write, $fdisplay, $fwrite and $sformatf call keeps
+ * what it needs from call to call in one of these, attached to the
+ * call with vpi_put_userdata. The arguments, the compiled string
+ * constants and the output buffer are made on the first call, and the
+ * following calls only format the values.
+ */
+struct display_site {
+      struct strobe_cb_info info;
+	/* The file/MC descriptor argument, or nil. */
+      vpiHandle fd;
+      struct display_buf buf;
+	/* All the sites are listed so that they can be freed, and
+	   taken off their calls, at the end of the simulation. */
+      vpiHandle callh;
+      struct display_site*next;
+};
+
+static struct display_site*display_sites = 0;
+
+static struct display_site *make_display_site(vpiHandle callh,
+                                              ICARUS_VPI_CONST PLI_BYTE8 *name)
+{
+      struct display_site*site = calloc(1, sizeof(struct display_site));
+      vpiHandle argv = vpi_iterate(vpiArgument, callh);
+
+      if (name[1] == 'f') site->fd = vpi_scan(argv);
+
+      site->info.scope = vpi_handle(vpiScope, callh);
+      assert(site->info.scope);
+	/* We could use vpi_get_str(vpiName, callh) to get the task name,
+	 * but name is already defined. */
+      site->info.name = name;
+      site->info.filename = strdup(vpi_get_str(vpiFile, callh));
+      site->info.lineno = (int)vpi_get(vpiLineNo, callh);
+      site->info.default_format = get_default_format(name);
+      array_from_iterator(&site->info, argv);
+      compile_display_progs(&site->info);
+
+      site->callh = callh;
+      site->next = display_sites;
+      display_sites = site;
+      vpi_put_userdata(callh, site);
+      return site;
+}
+
+static void display_sites_delete(void)
+{
+      while (display_sites) {
+	    struct display_site*site = display_sites;
+	    display_sites = site->next;
+	    vpi_put_userdata(site->callh, 0);
+	    free_display_progs(&site->info);
+	    free(site->info.filename);
+	    free(site->info.items);
+	    free(site->buf.data);
+	    free(site);
+      }
+}
+
 /* This implements the $sformatf, $display/$fdisplay
  * and the $write/$fwrite based tasks. */
 static PLI_INT32 sys_display_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
 {
-      vpiHandle callh, argv, scope;
-      struct strobe_cb_info info;
-      char* result;
-      unsigned int size;
+      vpiHandle callh;
+      struct display_site*site;
       PLI_UINT32 fd_mcd;
       s_vpi_value val;
 
       callh = vpi_handle(vpiSysTfCall, 0);
-      argv = vpi_iterate(vpiArgument, callh);
+      site = vpi_get_userdata(callh);
+      if (site == 0) site = make_display_site(callh, name);
 
 	/* Get the file/MC descriptor and verify it is valid. */
       if (name[1] == 'f') {
-	    vpiHandle fd = vpi_scan(argv);
-	    if (get_fd_mcd_from_arg(&fd_mcd, fd, callh, name)) {
-		  vpi_free_object(argv);
+	    if (get_fd_mcd_from_arg(&fd_mcd, site->fd, callh, name)) {
 		  return 0;
 	    }
       } else if (strncmp(name, "$sformatf", 9) == 0) {
@@ -1296,35 +1712,25 @@ static PLI_INT32 sys_display_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
 	    fd_mcd = 1;
       }
 
-      scope = vpi_handle(vpiScope, callh);
-      assert(scope);
-	/* We could use vpi_get_str(vpiName, callh) to get the task name,
-	 * but name is already defined. */
-      info.name = name;
-      info.filename = strdup(vpi_get_str(vpiFile, callh));
-      info.lineno = (int)vpi_get(vpiLineNo, callh);
-      info.default_format = get_default_format(name);
-      info.scope = scope;
-      array_from_iterator(&info, argv);
-
 	/* Because %u and %z may put embedded NULL characters into the
 	 * returned string strlen() may not match the real size! */
-      result = get_display(&size, &info);
+      site->buf.len = 0;
+      get_display_buf(&site->buf, &site->info);
 
       if (fd_mcd > 0) {
-	     my_mcd_rawwrite(fd_mcd, result, size);
 	     if ((strncmp(name,"$display",8) == 0) ||
-	         (strncmp(name,"$fdisplay",9) == 0)) my_mcd_rawwrite(fd_mcd, "\n", 1);
+	         (strncmp(name,"$fdisplay",9) == 0)) {
+		   display_buf_append(&site->buf, "\n", 1);
+	     }
+	     my_mcd_rawwrite(fd_mcd, site->buf.data, site->buf.len);
       } else {
 	       /* Return as a string ($sformatf) */
+	     site->buf.data[site->buf.len] = '\0';
 	     val.format = vpiStringVal;
-	     val.value.str = result;
+	     val.value.str = site->buf.data;
 	     vpi_put_value(callh, &val, 0, vpiNoDelay);
       }
 
-      free(result);
-      free(info.filename);
-      free(info.items);
       return 0;
 }
 
@@ -1427,25 +1833,185 @@ static PLI_INT32 sys_strobe_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
  * though that monitor may be watching many variables).
  */
 
-static struct strobe_cb_info monitor_info = { 0, 0, 0, 0, 0, 0, 0, 0 };
+static struct strobe_cb_info monitor_info = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 static vpiHandle *monitor_callbacks = 0;
 static int monitor_scheduled = 0;
 static int monitor_enabled = 1;
 
-static PLI_INT32 monitor_cb_2(p_cb_data cb)
+/*
+ * A value change callback can trip the monitor even though the value
+ * at the end of the time step is the same as at the last display, for
+ * example if a signal glitches and comes back. So the monitor keeps
+ * the values of the monitored variables at the last display, and
+ * skips the display if none of them is different. The snapshot is
+ * only used if every monitored item can be compared this way, and no
+ * %v format shows strengths, which the values do not carry.
+ */
+struct monitor_snapshot_s {
+      int usable;
+	/* Set if the next display must happen, for the first display
+	   of a $monitor or after a $monitoron. */
+      int force;
+      vpiHandle*vecs;
+      PLI_INT32 nvecs;
+      unsigned nwords;
+      s_vpi_vecval*vec_last;
+      s_vpi_vecval*vec_cur;
+      vpiHandle*reals;
+      unsigned nreals;
+      double*real_last;
+};
+
+static struct monitor_snapshot_s monitor_snap;
+
+static void monitor_snapshot_clear(void)
+{
+      free(monitor_snap.vecs);
+      free(monitor_snap.vec_last);
+      free(monitor_snap.vec_cur);
+      free(monitor_snap.reals);
+      free(monitor_snap.real_last);
+      memset(&monitor_snap, 0, sizeof monitor_snap);
+}
+
+static int format_shows_strength(const char*fmt)
+{
+      for (fmt = strchr(fmt, '%') ;  fmt ;  fmt = strchr(fmt, '%')) {
+	    fmt += 1;
+	    fmt += strspn(fmt, "-+0123456789.");
+	    if (*fmt == 'v' || *fmt == 'V')
+		  return 1;
+	    if (*fmt == '%')
+		  fmt += 1;
+      }
+      return 0;
+}
+
+/*
+ * Sort the monitored items into the snapshot, and compile the string
+ * constants into the monitor_info so that they are not read again for
+ * each display.
+ */
+static void monitor_snapshot_setup(void)
 {
-      char* result;
-      unsigned int size;
+      unsigned idx;
 
+      monitor_snapshot_clear();
+      monitor_snap.usable = 1;
+      monitor_snap.force = 1;
+      compile_display_progs(&monitor_info);
+
+      for (idx = 0 ;  idx < monitor_info.nitems ;  idx += 1) {
+	    vpiHandle item = monitor_info.items[idx];
+
+	    switch (vpi_get(vpiType, item)) {
+		case vpiConstant:
+		case vpiParameter:
+		  if (vpi_get(vpiConstType, item) != vpiStringConst)
+			break;
+		  if (format_shows_strength(monitor_info.progs[idx]->text))
+			monitor_snap.usable = 0;
+		  break;
+
+		case vpiNet:
+		case vpiReg:
+		case vpiIntegerVar:
+		case vpiBitVar:
+		case vpiByteVar:
+		case vpiShortIntVar:
+		case vpiIntVar:
+		case vpiLongIntVar:
+		  monitor_snap.vecs = realloc(monitor_snap.vecs,
+			    (monitor_snap.nvecs+1)*sizeof(vpiHandle));
+		  monitor_snap.vecs[monitor_snap.nvecs++] = item;
+		  monitor_snap.nwords += (vpi_get(vpiSize, item) + 31) / 32;
+		  break;
+
+		case vpiRealVar:
+		  monitor_snap.reals = realloc(monitor_snap.reals,
+			    (monitor_snap.nreals+1)*sizeof(vpiHandle));
+		  monitor_snap.reals[monitor_snap.nreals++] = item;
+		  break;
+
+		  /* The value of the other items that can change are
+		     not kept, so they always display. */
+		case vpiMemoryWord:
+		case vpiPartSelect:
+		  monitor_snap.usable = 0;
+		  break;
+
+		default:
+		  break;
+	    }
+      }
+
+      monitor_snap.vec_last = calloc(monitor_snap.nwords+1, sizeof(s_vpi_vecval));
+      monitor_snap.vec_cur = calloc(monitor_snap.nwords+1, sizeof(s_vpi_vecval));
+      monitor_snap.real_last = calloc(monitor_snap.nreals+1, sizeof(double));
+}
+
+/*
+ * Read the values of the monitored variables, and return true if
+ * the monitor needs to display. The values become the values of the
+ * last display.
+ */
+static int monitor_snapshot_changed(void)
+{
+      s_vpi_vecval*tmp;
+      s_vpi_value value;
+      int changed = monitor_snap.force || !monitor_snap.usable;
+      unsigned idx;
+
+      monitor_snap.force = 0;
+      if (! monitor_snap.usable)
+	    return 1;
+
+	/* An item that is not a plain signal can not be kept, so the
+	   monitor always displays. */
+      if (vpip_get_vecval_multi(monitor_snap.nvecs, monitor_snap.vecs,
+				monitor_snap.vec_cur) < 0) {
+	    monitor_snap.usable = 0;
+	    return 1;
+      }
+      if (memcmp(monitor_snap.vec_cur, monitor_snap.vec_last,
+		 monitor_snap.nwords * sizeof(s_vpi_vecval)) != 0) {
+	    tmp = monitor_snap.vec_last;
+	    monitor_snap.vec_last = monitor_snap.vec_cur;
+	    monitor_snap.vec_cur = tmp;
+	    changed = 1;
+      }
+
+      for (idx = 0 ;  idx < monitor_snap.nreals ;  idx += 1) {
+	    value.format = vpiRealVal;
+	    vpi_get_value(monitor_snap.reals[idx], &value);
+	    if (memcmp(&value.value.real, monitor_snap.real_last+idx,
+		       sizeof(double)) != 0) {
+		  monitor_snap.real_last[idx] = value.value.real;
+		  changed = 1;
+	    }
+      }
+
+      return changed;
+}
+
+static struct display_buf monitor_buf;
+
+static PLI_INT32 monitor_cb_2(p_cb_data cb)
+{
       (void)cb; /* Parameter is not used. */
 
+      if (! monitor_snapshot_changed()) {
+	    monitor_scheduled = 0;
+	    return 0;
+      }
+
 	/* Because %u and %z may put embedded NULL characters into the
 	 * returned string strlen() may not match the real size! */
-      result = get_display(&size, &monitor_info);
-      my_mcd_rawwrite(monitor_info.fd_mcd, result, size);
-      my_mcd_rawwrite(monitor_info.fd_mcd, "\n", 1);
+      monitor_buf.len = 0;
+      get_display_buf(&monitor_buf, &monitor_info);
+      display_buf_append(&monitor_buf, "\n", 1);
+      my_mcd_rawwrite(monitor_info.fd_mcd, monitor_buf.data, monitor_buf.len);
       monitor_scheduled = 0;
-      free(result);
       return 0;
 }
 
@@ -1514,6 +2080,8 @@ static PLI_INT32 sys_monitor_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 	    free(monitor_callbacks);
 	    monitor_callbacks = 0;
 
+	    free_display_progs(&monitor_info);
+
 	    free(monitor_info.filename);
 	    free(monitor_info.items);
 	    monitor_info.items = 0;
@@ -1531,6 +2099,7 @@ static PLI_INT32 sys_monitor_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       monitor_info.default_format = get_default_format(name);
       monitor_info.scope = scope;
       monitor_info.fd_mcd = 1;
+      monitor_snapshot_setup();
 
 	/* Attach callbacks to all the parameters that might change. */
       monitor_callbacks = calloc(monitor_info.nitems, sizeof(vpiHandle));
@@ -1582,6 +2151,7 @@ static PLI_INT32 sys_monitoron_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 {
       (void)name; /* Parameter is not used. */
       monitor_enabled = 1;
+      monitor_snap.force = 1;
       monitor_cb_1(0);
       return 0;
 }
@@ -1644,6 +2214,7 @@ static PLI_INT32 sys_swrite_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
   info.lineno = (int)vpi_get(vpiLineNo, callh);
   info.default_format = get_default_format(name);
   info.scope = scope;
+  info.progs = 0;
   array_from_iterator(&info, argv);
 
   /* Because %u and %z may put embedded NULL characters into the returned
@@ -1737,6 +2308,7 @@ static PLI_INT32 sys_sformat_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
   info.lineno = (int)vpi_get(vpiLineNo, callh);
   info.default_format = get_default_format(name);
   info.scope = scope;
+  info.progs = 0;
   array_from_iterator(&info, argv);
   idx = -1;
   size = get_format(&result, fmt, &info, &idx);
@@ -2096,6 +2668,7 @@ static PLI_INT32 sys_severity_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       info.lineno = (int)vpi_get(vpiLineNo, callh);
       info.default_format = vpiDecStrVal;
       info.scope = scope;
+      info.progs = 0;
       array_from_iterator(&info, argv);
 
       vpi_printf("%s: %s:%d: ", sstr, info.filename, info.lineno);
@@ -2124,6 +2697,10 @@ static PLI_INT32 sys_severity_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       free(info.items);
       free(dstr);
 
+	/* Write the value changes that lead up to the error. */
+      if (strncmp(name,"$error",6) == 0 || strncmp(name,"$fatal",6) == 0)
+	    vcd_capture_trigger();
+
       if (strncmp(name,"$fatal",6) == 0) {
 	      /* Set the exit code from vvp as an error code. */
 	    vpip_set_return_value(1);
@@ -2134,12 +2711,27 @@ static PLI_INT32 sys_severity_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       return 0;
 }
 
+/*
+ * The compiler calls this at the start of the fail action of an
+ * immediate assertion, so that a failed assertion is a failure even
+ * if its action does not call $error. An assertion without an action
+ * calls $error instead.
+ */
+static PLI_INT32 sys_assert_failed_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      (void)name; /* Parameter is not used. */
+      vcd_capture_trigger();
+      return 0;
+}
+
 
 static PLI_INT32 sys_end_of_simulation(p_cb_data cb_data)
 {
       (void)cb_data; /* Parameter is not used. */
       free(monitor_callbacks);
       monitor_callbacks = 0;
+      free_display_progs(&monitor_info);
+      monitor_snapshot_clear();
       free(monitor_info.filename);
       free(monitor_info.items);
       monitor_info.items = 0;
@@ -2148,6 +2740,14 @@ static PLI_INT32 sys_end_of_simulation(p_cb_data cb_data)
 
       free(timeformat_info.suff);
       timeformat_info.suff = 0;
+
+      display_sites_delete();
+      free(fast_vals);
+      fast_vals = 0;
+      fast_nvals = 0;
+      free(fast_digits);
+      fast_digits = 0;
+      fast_ndigits = 0;
       return 0;
 }
 
@@ -2548,6 +3148,15 @@ void sys_display_register(void)
       res = vpi_register_systf(&tf_data);
       vpip_make_systf_system_defined(res);
 
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$ivl_assert_failed";
+      tf_data.calltf    = sys_assert_failed_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$ivl_assert_failed";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
       cb_data.reason = cbEndOfCompile;
       cb_data.time = 0;
       cb_data.cb_rtn = sys_end_of_compile;
@@ -259,8 +259,10 @@ static PLI_INT32 sys_fflush_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       vpiHandle fd;
       PLI_UINT32 fd_mcd;
 
-	/* If we have no argument then flush all the streams. */
+	/* If we have no argument then flush all the streams. An mcd of
+	 * zero also flushes the output that the runtime has buffered. */
       if (argv == 0) {
+	    vpi_mcd_flush(0);
 	    fflush(NULL);
 	    return 0;
       }
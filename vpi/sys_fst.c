@@ -32,6 +32,11 @@
 # include  <time.h>
 # include  "ivl_alloc.h"
 
+  /* fstapi.c leaves out the parallel writer without pthreads. */
+#ifndef HAVE_LIBPTHREAD
+#undef FST_WRITER_PARALLEL
+#endif
+
 static char *dump_path = NULL;
 static struct fstContext *dump_file = NULL;
 
@@ -44,6 +49,8 @@ struct vcd_info {
       struct vcd_info *next;
       struct vcd_info *dmp_next;
       fstHandle handle;
+      PLI_INT32 type;
+      PLI_INT32 size;
       int scheduled;
 };
 
@@ -64,6 +71,11 @@ static enum lxm_optimum_mode_e {
       LXM_BOTH = 3
 } lxm_optimum_mode = LXM_NONE;
 
+#ifdef FST_WRITER_PARALLEL
+  /* Compress the value change blocks in a thread of their own. */
+static int fst_parallel = 0;
+#endif
+
 static const char*units_names[] = {
       "s",
       "ms",
@@ -73,42 +85,276 @@ static const char*units_names[] = {
       "fs"
 };
 
+/*
+ * The value changes are passed to the FST writer by a thread of its
+ * own, so that the writer compresses them while the simulation runs.
+ * The simulation puts the values in the work queue (see vcd_priv.h)
+ * with the vcd_info of the item. The thread starts once the header is
+ * done, and only the thread uses the writer from then on.
+ */
+static int dump_thread = 0;
+
+/*
+ * In capture mode (the -fst-capture=<size> and -fst-capture-time=<time>
+ * extended arguments) the thread keeps the value changes in a ring of
+ * segments in memory instead of passing them to the writer, in the
+ * same way as the VCD dumper does (see sys_vcd.c). Each segment is a
+ * list of the work items, with the bits of the values in a buffer of
+ * their own, and the items are passed to the writer when the capture
+ * is written. The simulation keeps the bytes of the current segment in
+ * capture_fill and its start time in capture_start.
+ */
+struct capture_item {
+      vcd_work_item_type_t type;
+      PLI_UINT64 time;
+      struct vcd_info*info;
+      double val_double;
+      size_t val_bits;
+};
+
+struct capture_seg {
+      struct capture_item*items;
+      size_t nitems;
+      size_t aitems;
+      char*bits;
+      size_t fill;
+      size_t alloc;
+};
+
+static int capture_mode = 0;
+static unsigned long capture_limit = 0;
+static PLI_UINT64 capture_window = 0;
+static unsigned long capture_fill = 0;
+static PLI_UINT64 capture_start = 0;
+static struct capture_seg capture_ring[VCD_CAPTURE_SEGMENTS];
+static unsigned capture_first = 0;
+static unsigned capture_count = 1;
+
+static void write_item(vcd_work_item_type_t type, PLI_UINT64 time,
+                       struct vcd_info*info, double val_double,
+                       const char*val_bits)
+{
+      switch (type) {
+	  case WT_TIME_CHANGE:
+	    fstWriterEmitTimeChange(dump_file, time);
+	    break;
+	  case WT_DUMPON:
+	    fstWriterEmitDumpActive(dump_file, 1); /* $dumpon */
+	    break;
+	  case WT_DUMPOFF:
+	    fstWriterEmitDumpActive(dump_file, 0); /* $dumpoff */
+	    break;
+	  case WT_EMIT_DOUBLE:
+	    fstWriterEmitValueChange(dump_file, info->handle, &val_double);
+	    break;
+	  case WT_EMIT_BITS:
+	    fstWriterEmitValueChange(dump_file, info->handle, val_bits);
+	    break;
+	  default:
+	    assert(0);
+	    break;
+      }
+}
+
+static void capture_add(const struct vcd_work_item_s*cell)
+{
+      unsigned idx = (capture_first + capture_count - 1) % VCD_CAPTURE_SEGMENTS;
+      struct capture_seg*seg = capture_ring + idx;
+      struct capture_item*item;
+
+      if (seg->nitems == seg->aitems) {
+	    seg->aitems = 2*seg->aitems + 1024;
+	    seg->items = realloc(seg->items,
+	                         seg->aitems * sizeof(struct capture_item));
+      }
+
+      item = seg->items + seg->nitems++;
+      item->type = cell->type;
+      item->time = cell->time;
+      item->info = (struct vcd_info*)cell->sym;
+      item->val_double = 0.0;
+      item->val_bits = 0;
+
+      if (cell->type == WT_EMIT_DOUBLE) {
+	    item->val_double = cell->op_.val_double;
+      } else if (cell->type == WT_EMIT_BITS) {
+	    size_t cnt = strlen(cell->op_.val_char) + 1;
+	    if (seg->fill + cnt > seg->alloc) {
+		  seg->alloc = 2*seg->alloc + cnt + 4096;
+		  seg->bits = realloc(seg->bits, seg->alloc);
+	    }
+	    memcpy(seg->bits + seg->fill, cell->op_.val_char, cnt);
+	    item->val_bits = seg->fill;
+	    seg->fill += cnt;
+      }
+}
+
+/* Start a new segment, dropping the oldest if the ring is full. */
+static void capture_next_segment(void)
+{
+      if (capture_count == VCD_CAPTURE_SEGMENTS) {
+	    capture_ring[capture_first].nitems = 0;
+	    capture_ring[capture_first].fill = 0;
+	    capture_first = (capture_first + 1) % VCD_CAPTURE_SEGMENTS;
+	    capture_count -= 1;
+      }
+
+      capture_count += 1;
+}
+
+/* Pass all the captured items to the writer, oldest first. */
+static void capture_flush(void)
+{
+      unsigned idx;
+      size_t cur;
+
+      for (idx = 0 ;  idx < capture_count ;  idx += 1) {
+	    struct capture_seg*seg = capture_ring
+		  + (capture_first + idx) % VCD_CAPTURE_SEGMENTS;
+	    for (cur = 0 ;  cur < seg->nitems ;  cur += 1) {
+		  struct capture_item*item = seg->items + cur;
+		  write_item(item->type, item->time, item->info,
+		             item->val_double, seg->bits + item->val_bits);
+	    }
+	    seg->nitems = 0;
+	    seg->fill = 0;
+      }
+
+	/* Keep filling the newest segment, which is now empty. */
+      capture_first = (capture_first + capture_count - 1) % VCD_CAPTURE_SEGMENTS;
+      capture_count = 1;
+}
+
+static void capture_delete(void)
+{
+      unsigned idx;
+
+      for (idx = 0 ;  idx < VCD_CAPTURE_SEGMENTS ;  idx += 1) {
+	    free(capture_ring[idx].items);
+	    free(capture_ring[idx].bits);
+	    capture_ring[idx].items = 0;
+	    capture_ring[idx].bits = 0;
+	    capture_ring[idx].aitems = 0;
+	    capture_ring[idx].alloc = 0;
+      }
+}
+
+/*
+ * These queue the items for the thread, and count the bytes that they
+ * take in a capture segment.
+ */
+static void emit_time(PLI_UINT64 now)
+{
+      if (capture_mode) capture_fill += sizeof(struct capture_item);
+      vcd_work_set_time(now);
+      vcd_work_time_change();
+}
+
+static void emit_double(struct vcd_info*info, double val)
+{
+      if (capture_mode) capture_fill += sizeof(struct capture_item);
+      vcd_work_emit_double(info, val);
+}
+
+static void emit_bits(struct vcd_info*info, const char*bits)
+{
+      if (capture_mode)
+	    capture_fill += sizeof(struct capture_item) + strlen(bits) + 1;
+      vcd_work_emit_bits(info, bits);
+}
+
+static void emit_dumpon(int flag)
+{
+      if (capture_mode) capture_fill += sizeof(struct capture_item);
+      if (flag) vcd_work_dumpon();
+      else vcd_work_dumpoff();
+}
+
 static void show_this_item(struct vcd_info*info)
 {
       s_vpi_value value;
-      PLI_INT32 type = vpi_get(vpiType, info->item);
 
-      if (type == vpiRealVar) {
+	/* The type of the item is kept in the vcd_info, since this is
+	   called for every value change. */
+      if (info->type == vpiRealVar) {
 	    value.format = vpiRealVal;
 	    vpi_get_value(info->item, &value);
-	    fstWriterEmitValueChange(dump_file, info->handle, &value.value.real);
+	    emit_double(info, value.value.real);
+      } else if (info->type == vpiNamedEvent) {
+	    emit_bits(info, "1");
+      } else if (vcd_can_coalesce(info->type)) {
+	    emit_bits(info, vcd_get_bits(info->item, info->size));
       } else {
 	    value.format = vpiBinStrVal;
 	    vpi_get_value(info->item, &value);
-	    fstWriterEmitValueChange(dump_file, info->handle, (type != vpiNamedEvent) ? value.value.str : "1");
+	    emit_bits(info, value.value.str);
       }
 }
 
 /* Dump values for a $dumpoff. */
 static void show_this_item_x(struct vcd_info*info)
 {
-      PLI_INT32 type = vpi_get(vpiType, info->item);
-
-      if (type == vpiRealVar) {
+      if (info->type == vpiRealVar) {
 	      /* Some tools dump nothing here...? */
-            double mynan = strtod("NaN", NULL);
-	    fstWriterEmitValueChange(dump_file, info->handle, &mynan);
-      } else if (type == vpiNamedEvent) {
+	    emit_double(info, strtod("NaN", NULL));
+      } else if (info->type == vpiNamedEvent) {
 	    /* Do nothing for named events. */
       } else {
-	    int siz = vpi_get(vpiSize, info->item);
-	    char *xmem = malloc(siz);
+	    int siz = info->size;
+	    char *xmem = malloc(siz+1);
 	    memset(xmem, 'x', siz);
-	    fstWriterEmitValueChange(dump_file, info->handle, xmem);
+	    xmem[siz] = 0;
+	    emit_bits(info, xmem);
 	    free(xmem);
       }
 }
 
+static void* fst_thread(void*arg)
+{
+      int run_flag = 1;
+
+      (void)arg; /* Parameter is not used. */
+
+      while (run_flag) {
+	    struct vcd_work_item_s*cell = vcd_work_thread_peek();
+
+	    switch (cell->type) {
+		case WT_NONE:
+		case WT_EMIT_TEXT:
+		  break;
+		case WT_TIME_CHANGE:
+		case WT_DUMPON:
+		case WT_DUMPOFF:
+		case WT_EMIT_DOUBLE:
+		case WT_EMIT_BITS:
+		  if (capture_mode)
+			capture_add(cell);
+		  else
+			write_item(cell->type, cell->time,
+			           (struct vcd_info*)cell->sym,
+			           cell->op_.val_double, cell->op_.val_char);
+		  break;
+		case WT_FLUSH:
+		  fstWriterFlushContext(dump_file);
+		  break;
+		case WT_CAPTURE_NEXT:
+		  capture_next_segment();
+		  break;
+		case WT_CAPTURE_WRITE:
+		  capture_flush();
+		  fstWriterFlushContext(dump_file);
+		  break;
+		case WT_TERMINATE:
+		  run_flag = 0;
+		  break;
+	    }
+
+	    vcd_work_thread_pop();
+      }
+
+      return 0;
+}
+
 
 /*
  * managed qsorted list of scope names/variables for duplicates bsearching
@@ -149,14 +395,30 @@ static PLI_INT32 variable_cb_2(p_cb_data cause)
 {
       struct vcd_info* info = vcd_dmp_list;
       PLI_UINT64 now = timerec_to_time64(cause->time);
+      int new_segment = 0;
+
+	/* The coalesced callback may have written the list already. */
+      if (info == 0) return 0;
 
       if (now != vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now);
+	    if (capture_mode &&
+	        vcd_capture_segment_full(capture_limit, capture_window,
+	                                 capture_fill, capture_start, now)) {
+		  vcd_work_capture_next();
+		  capture_fill = 0;
+		  capture_start = now;
+		  new_segment = 1;
+	    }
+	    emit_time(now);
 	    vcd_cur_time = now;
       }
 
+	/* A new capture segment starts with all the values, which
+	   covers the items that changed. */
+      if (new_segment) vcd_checkpoint();
+
       do {
-           show_this_item(info);
+           if (!new_segment) show_this_item(info);
            info->scheduled = 0;
       } while ((info = info->dmp_next) != 0);
 
@@ -165,23 +427,37 @@ static PLI_INT32 variable_cb_2(p_cb_data cause)
       return 0;
 }
 
-static PLI_INT32 variable_cb_1(p_cb_data cause)
+/*
+ * Return true if value changes are not being dumped now, either
+ * because the dump is off or because it reached its size limit.
+ */
+static int dump_is_stopped(void)
 {
-      struct t_cb_data cb;
-      struct vcd_info*info = (struct vcd_info*)cause->user_data;
-
-      if (dump_is_full) return 0;
-      if (dump_is_off) return 0;
-      if (dump_header_pending()) return 0;
-      if (info->scheduled) return 0;
+      if (dump_is_full) return 1;
+      if (dump_is_off) return 1;
+      if (dump_header_pending()) return 1;
 
+	/* The writer only knows its size once it has the values
+	   that are in the queue. */
+      if (dump_limit > 0) vcd_work_sync();
       if ((dump_limit > 0) && fstWriterGetDumpSizeLimitReached(dump_file)) {
             dump_is_full = 1;
             vpi_printf("WARNING: Dump file limit (%ld bytes) "
                                "exceeded.\n", dump_limit);
-            return 0;
+            return 1;
       }
 
+      return 0;
+}
+
+static PLI_INT32 variable_cb_1(p_cb_data cause)
+{
+      struct t_cb_data cb;
+      struct vcd_info*info = (struct vcd_info*)cause->user_data;
+
+      if (info->scheduled) return 0;
+      if (dump_is_stopped()) return 0;
+
       if (!vcd_dmp_list) {
           cb = *cause;
 	  cb.time = &zero_delay;
@@ -197,6 +473,35 @@ static PLI_INT32 variable_cb_1(p_cb_data cause)
       return 0;
 }
 
+/*
+ * This is called at the end of each time step with an iterator over
+ * the coalesced items that changed. They go on the same list as the
+ * items that variable_cb_1 schedules, and the list is written now.
+ */
+static PLI_INT32 variable_cb_coalesced(p_cb_data cause)
+{
+      vpiHandle item;
+
+	/* The $dumpvars values of this step are already the final
+	   ones, and variable_cb_1 drops the changes before them. */
+      if (dump_is_stopped() ||
+          timerec_to_time64(cause->time) == dumpvars_time) {
+	    vpi_free_object(cause->obj);
+	    return 0;
+      }
+
+      while ((item = vpi_scan(cause->obj))) {
+	    struct vcd_info*info = vcd_coalesced_item_find(item);
+	    assert(info);
+	    if (info->scheduled) continue;
+	    info->scheduled = 1;
+	    info->dmp_next  = vcd_dmp_list;
+	    vcd_dmp_list    = info;
+      }
+
+      return variable_cb_2(cause);
+}
+
 static PLI_INT32 dumpvars_cb(p_cb_data cause)
 {
       if (dumpvars_status != 1) return 0;
@@ -208,8 +513,12 @@ static PLI_INT32 dumpvars_cb(p_cb_data cause)
 
       /* nothing to do for $enddefinitions $end */
 
+      vcd_work_start(fst_thread, 0);
+      dump_thread = 1;
+      capture_start = dumpvars_time;
+
       if (!dump_is_off) {
-	    fstWriterEmitTimeChange(dump_file, dumpvars_time);
+	    emit_time(dumpvars_time);
 	    /* nothing to do for  $dumpvars... */
 	    vcd_checkpoint();
 	    /* ...nothing to do for $end */
@@ -228,6 +537,14 @@ static PLI_INT32 finish_cb(p_cb_data cause)
 
       dumpvars_time = timerec_to_time64(cause->time);
 
+      if (dump_thread) {
+	      /* Only a failed simulation keeps its capture. */
+	    if (capture_mode && vcd_capture_failed())
+		  vcd_work_capture_write();
+	    vcd_work_terminate();
+	    dump_thread = 0;
+      }
+
       if (!dump_is_off && !dump_is_full && dumpvars_time != vcd_cur_time) {
 	    fstWriterEmitTimeChange(dump_file, dumpvars_time);
       }
@@ -242,6 +559,9 @@ static PLI_INT32 finish_cb(p_cb_data cause)
       vcd_names_delete(&fst_tab);
       vcd_names_delete(&fst_var);
       nexus_ident_delete();
+      vcd_coalesced_items_delete();
+      vcd_bits_delete();
+      capture_delete();
       free(dump_path);
       dump_path = 0;
 
@@ -297,11 +617,11 @@ static PLI_INT32 sys_dumpoff_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now64);
+	    emit_time(now64);
 	    vcd_cur_time = now64;
       }
 
-      fstWriterEmitDumpActive(dump_file, 0); /* $dumpoff */
+      emit_dumpon(0);
       vcd_checkpoint_x();
 
       return 0;
@@ -326,11 +646,11 @@ static PLI_INT32 sys_dumpon_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now64);
+	    emit_time(now64);
 	    vcd_cur_time = now64;
       }
 
-      fstWriterEmitDumpActive(dump_file, 1); /* $dumpon */
+      emit_dumpon(1);
       vcd_checkpoint();
 
       return 0;
@@ -352,7 +672,7 @@ static PLI_INT32 sys_dumpall_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fstWriterEmitTimeChange(dump_file, now64);
+	    emit_time(now64);
 	    vcd_cur_time = now64;
       }
 
@@ -412,6 +732,11 @@ static void open_dumpfile(vpiHandle callh)
 	        (lxm_optimum_mode == LXM_BOTH)) {
 		  fstWriterSetRepackOnClose(dump_file, 1);
 	    }
+	      /* Let the simulation continue while a finished block of
+	       * value changes is compressed and written. */
+#ifdef FST_WRITER_PARALLEL
+	    if (fst_parallel) fstWriterSetParallelMode(dump_file, 1);
+#endif
       }
 }
 
@@ -453,7 +778,36 @@ static PLI_INT32 sys_dumpfile_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 static PLI_INT32 sys_dumpflush_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 {
       (void)name; /* Parameter is not used. */
-      if (dump_file) fstWriterFlushContext(dump_file);
+      if (dump_thread) vcd_work_flush();
+      else if (dump_file) fstWriterFlushContext(dump_file);
+
+      return 0;
+}
+
+/*
+ * Have the thread write the captured value changes to the dump file.
+ * Nothing is captured before the thread starts.
+ */
+static void capture_trigger(void)
+{
+      if (dump_file == 0) return;
+
+      if (dump_thread) {
+	    vcd_work_capture_write();
+	    capture_fill = 0;
+      } else {
+	    fstWriterFlushContext(dump_file);
+      }
+}
+
+/*
+ * In capture mode, write the captured value changes to the dump
+ * file. Otherwise this is the same as $dumpflush.
+ */
+static PLI_INT32 sys_dumptrigger_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      if (capture_mode) capture_trigger();
+      else sys_dumpflush_calltf(name);
 
       return 0;
 }
@@ -469,10 +823,21 @@ static PLI_INT32 sys_dumplimit_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
       /* Get the value and set the dump limit. */
       val.format = vpiIntVal;
       vpi_get_value(vpi_scan(argv), &val);
+      vpi_free_object(argv);
+
+	/* The capture size already bounds a capture, and the file only
+	   grows when the capture is written. */
+      if (capture_mode) {
+	    vpi_printf("FST warning: %s:%d: $dumplimit is ignored in "
+	               "capture mode.\n", vpi_get_str(vpiFile, callh),
+	               (int)vpi_get(vpiLineNo, callh));
+	    return 0;
+      }
+
       dump_limit = val.value.integer;
+      if (dump_thread) vcd_work_sync();
       fstWriterSetDumpSizeLimit(dump_file, dump_limit);
 
-      vpi_free_object(argv);
       return 0;
 }
 
@@ -643,6 +1008,8 @@ static void scan_item(unsigned depth, vpiHandle item, int skip)
 		  info->time.type = vpiSimTime;
 		  info->item  = item;
 		  info->handle = new_ident;
+		  info->type  = vpi_get(vpiType, item);
+		  info->size  = vpi_get(vpiSize, item);
 		  info->scheduled = 0;
 
 		  cb.time      = &info->time;
@@ -652,6 +1019,13 @@ static void scan_item(unsigned depth, vpiHandle item, int skip)
 		  cb.reason    = cbValueChange;
 		  cb.cb_rtn    = variable_cb_1;
 
+		  if (vcd_can_coalesce(info->type)) {
+			cb.user_data = 0;
+			cb.reason    = cbValueChangeCoalesced;
+			cb.cb_rtn    = variable_cb_coalesced;
+			vcd_coalesced_item_add(item, info);
+		  }
+
 		  info->dmp_next = 0;
 		  info->next  = vcd_list;
 		  vcd_list    = info;
@@ -915,9 +1289,20 @@ void sys_fst_register(void)
 		  lxm_optimum_mode = LXM_BOTH;
 	    } else if (strcmp(vlog_info.argv[idx],"-fst-speed-space") == 0) {
 		  lxm_optimum_mode = LXM_BOTH;
+	    } else if (strcmp(vlog_info.argv[idx],"-fst-parallel") == 0) {
+#ifdef FST_WRITER_PARALLEL
+		  fst_parallel = 1;
+#else
+		  vpi_printf("FST warning: -fst-parallel is not supported "
+		             "in this build, the dump is written serially.\n");
+#endif
 	    }
       }
 
+      vcd_capture_args("fst", &capture_limit, &capture_window);
+      capture_mode = capture_limit > 0 || capture_window > 0;
+      if (capture_mode) vcd_capture_set_trigger(capture_trigger);
+
       /* All the compiletf routines are located in vcd_priv.c. */
 
       tf_data.type      = vpiSysTask;
@@ -947,6 +1332,15 @@ void sys_fst_register(void)
       res = vpi_register_systf(&tf_data);
       vpip_make_systf_system_defined(res);
 
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumptrigger";
+      tf_data.calltf    = sys_dumptrigger_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumptrigger";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
       tf_data.type      = vpiSysTask;
       tf_data.tfname    = "$dumplimit";
       tf_data.calltf    = sys_dumplimit_calltf;
@@ -18,6 +18,7 @@
 
 #include "sys_priv.h"
 #include <assert.h>
+#include <stdlib.h>
 
 static PLI_INT32 finish_and_return_calltf(ICARUS_VPI_CONST PLI_BYTE8* name)
 {
@@ -41,6 +42,33 @@ static PLI_INT32 finish_and_return_calltf(ICARUS_VPI_CONST PLI_BYTE8* name)
     return 0;
 }
 
+/*
+ * $fork_server("file") freezes a copy of the simulation that serves
+ * the "vvp -r file" command. Each run of that command gets a copy of
+ * the frozen simulation, which continues from the return of this
+ * call with its own plusargs. This is an Icarus extension, and not
+ * the IEEE $save: no state is written to the file.
+ */
+static PLI_INT32 sys_fork_server_calltf(ICARUS_VPI_CONST PLI_BYTE8* name)
+{
+      vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
+      vpiHandle argv = vpi_iterate(vpiArgument, callh);
+      char *path = get_filename(callh, name, vpi_scan(argv));
+      vpi_free_object(argv);
+
+      if (path == 0)
+	    return 0;
+
+      if (vpip_fork_server(path) < 0) {
+	    vpi_printf("WARNING: %s:%d: %s(\"%s\") did not start a "
+	               "fork server.\n", vpi_get_str(vpiFile, callh),
+	               (int)vpi_get(vpiLineNo, callh), name, path);
+      }
+
+      free(path);
+      return 0;
+}
+
 static PLI_INT32 task_not_implemented_compiletf(ICARUS_VPI_CONST PLI_BYTE8* name)
 {
       vpiHandle callh = vpi_handle(vpiSysTfCall, 0);
@@ -82,6 +110,15 @@ void sys_special_register(void)
       tf_data.tfname      = "$finish_and_return";
       tf_data.user_data   = "$finish_and_return";
       res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
+      tf_data.type        = vpiSysTask;
+      tf_data.calltf      = sys_fork_server_calltf;
+      tf_data.compiletf   = sys_one_string_arg_compiletf;
+      tf_data.sizetf      = 0;
+      tf_data.tfname      = "$fork_server";
+      tf_data.user_data   = "$fork_server";
+      res = vpi_register_systf(&tf_data);
       vpip_make_systf_system_defined(res);
 
 	/* These tasks are not currently implemented. */
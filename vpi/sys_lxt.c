@@ -840,6 +840,15 @@ void sys_lxt_register(void)
       res = vpi_register_systf(&tf_data);
       vpip_make_systf_system_defined(res);
 
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumptrigger";
+      tf_data.calltf    = sys_dumpflush_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumptrigger";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
       tf_data.type      = vpiSysTask;
       tf_data.tfname    = "$dumplimit";
       tf_data.calltf    = sys_dumplimit_calltf;
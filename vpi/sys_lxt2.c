@@ -859,6 +859,10 @@ static void* lxt2_thread(void*arg)
 
 	    switch (cell->type) {
 		case WT_NONE:
+		case WT_EMIT_TEXT:
+		case WT_TIME_CHANGE:
+		case WT_CAPTURE_NEXT:
+		case WT_CAPTURE_WRITE:
 		  break;
 		case WT_FLUSH:
 		  lxt2_wr_flush(dump_file);
@@ -870,11 +874,11 @@ static void* lxt2_thread(void*arg)
 		  lxt2_wr_set_dumpoff(dump_file);
 		  break;
 		case WT_EMIT_DOUBLE:
-		  lxt2_wr_emit_value_double(dump_file, cell->sym_.lxt2,
+		  lxt2_wr_emit_value_double(dump_file, cell->sym,
 					    0, cell->op_.val_double);
 		  break;
 		case WT_EMIT_BITS:
-		  lxt2_wr_emit_value_bit_string(dump_file, cell->sym_.lxt2,
+		  lxt2_wr_emit_value_bit_string(dump_file, cell->sym,
 						0, cell->op_.val_char);
 		  break;
 		case WT_TERMINATE:
@@ -944,6 +948,15 @@ void sys_lxt2_register(void)
       res = vpi_register_systf(&tf_data);
       vpip_make_systf_system_defined(res);
 
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumptrigger";
+      tf_data.calltf    = sys_dumpflush_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumptrigger";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
       tf_data.type      = vpiSysTask;
       tf_data.tfname    = "$dumplimit";
       tf_data.calltf    = sys_dumplimit_calltf;
@@ -79,4 +79,11 @@ extern PLI_INT32 sys_one_string_arg_compiletf(ICARUS_VPI_CONST PLI_BYTE8 *name);
 extern void put_integer_value(vpiHandle callh, PLI_INT32 result);
 extern void put_scalar_value(vpiHandle callh, PLI_INT32 result);
 
+/*
+ * $error, $fatal and failed assertions call this so that the VCD or
+ * FST dumper writes the value changes it holds in capture mode, as
+ * $dumptrigger does. It is defined in vcd_priv.c.
+ */
+extern void vcd_capture_trigger(void);
+
 #endif /* IVL_sys_priv_H */
@@ -37,23 +37,185 @@ static vpiHandle sdf_callh = 0;
   /* The cell in process. */
 static vpiHandle sdf_cur_cell;
 
-static vpiHandle find_scope(vpiHandle scope, const char*name)
+/*
+ * The child modules of the scopes that the annotation looks in are
+ * kept in a hash table, so that each name of an instance path is
+ * found without a scan of all the children of its scope. The children
+ * of a scope are all added the first time a child of that scope is
+ * looked up, along with an entry with a nil name that marks the scope
+ * as indexed. The table only lives for one $sdf_annotate call.
+ */
+struct sdf_scope_entry_s {
+      vpiHandle parent;
+      char*name;
+      vpiHandle child;
+      struct sdf_scope_entry_s*next;
+};
+
+static struct sdf_scope_entry_s**scope_table = 0;
+static unsigned scope_table_size = 0;
+static unsigned scope_table_count = 0;
+
+static unsigned scope_hash(vpiHandle parent, const char*name)
 {
-      vpiHandle idx = vpi_iterate(vpiModule, scope);
-	/* If this scope has no modules then it can't have the one we
-	 * are looking for so just return 0. */
-      if (idx == 0) return 0;
+      unsigned hash = (unsigned)((size_t)parent >> 4);
+      if (name) while (*name) {
+	    hash = (hash ^ (unsigned char)*name) * 16777619U;
+	    name += 1;
+      }
+      return hash;
+}
 
-      vpiHandle cur;
-      while ( (cur = vpi_scan(idx)) ) {
+static struct sdf_scope_entry_s*scope_table_find(vpiHandle parent,
+						 const char*name)
+{
+      struct sdf_scope_entry_s*cur;
+
+      if (scope_table_size == 0) return 0;
 
-	    if ( strcmp(name, vpi_get_str(vpiName,cur)) == 0) {
-		  vpi_free_object(idx);
-		  return cur;
+      cur = scope_table[scope_hash(parent, name) & (scope_table_size-1)];
+      for ( ; cur ; cur = cur->next) {
+	    if (cur->parent != parent) continue;
+	    if (name == 0 && cur->name == 0) return cur;
+	    if (name && cur->name && strcmp(name, cur->name) == 0) return cur;
+      }
+      return 0;
+}
+
+static void scope_table_add(vpiHandle parent, const char*name, vpiHandle child)
+{
+      struct sdf_scope_entry_s*cur;
+      unsigned hash;
+
+	/* Keep the table at most one entry per bucket on average. */
+      if (scope_table_count >= scope_table_size) {
+	    unsigned old_size = scope_table_size;
+	    struct sdf_scope_entry_s**old_table = scope_table;
+	    unsigned idx;
+
+	    scope_table_size = old_size ? 2*old_size : 1024;
+	    scope_table = calloc(scope_table_size, sizeof(*scope_table));
+	    for (idx = 0 ;  idx < old_size ;  idx += 1) {
+		  while ( (cur = old_table[idx]) ) {
+			old_table[idx] = cur->next;
+			hash = scope_hash(cur->parent, cur->name);
+			hash &= scope_table_size-1;
+			cur->next = scope_table[hash];
+			scope_table[hash] = cur;
+		  }
 	    }
+	    free(old_table);
       }
 
-      return 0;
+      cur = malloc(sizeof(*cur));
+      cur->parent = parent;
+      cur->name = name ? strdup(name) : 0;
+      cur->child = child;
+      hash = scope_hash(parent, name) & (scope_table_size-1);
+      cur->next = scope_table[hash];
+      scope_table[hash] = cur;
+      scope_table_count += 1;
+}
+
+static void scope_table_clear(void)
+{
+      unsigned idx;
+      for (idx = 0 ;  idx < scope_table_size ;  idx += 1) {
+	    struct sdf_scope_entry_s*cur;
+	    while ( (cur = scope_table[idx]) ) {
+		  scope_table[idx] = cur->next;
+		  free(cur->name);
+		  free(cur);
+	    }
+      }
+      free(scope_table);
+      scope_table = 0;
+      scope_table_size = 0;
+      scope_table_count = 0;
+}
+
+static vpiHandle find_scope(vpiHandle scope, const char*name)
+{
+      struct sdf_scope_entry_s*ent;
+
+      if (scope_table_find(scope, 0) == 0) {
+	    vpiHandle idx = vpi_iterate(vpiModule, scope);
+	    vpiHandle cur;
+
+	    scope_table_add(scope, 0, 0);
+	    if (idx) while ( (cur = vpi_scan(idx)) ) {
+		    /* Keep the first of any children with the same name. */
+		  const char*cur_name = vpi_get_str(vpiName, cur);
+		  if (scope_table_find(scope, cur_name) == 0)
+			scope_table_add(scope, cur_name, cur);
+	    }
+      }
+
+      ent = scope_table_find(scope, name);
+      return ent ? ent->child : 0;
+}
+
+/*
+ * The modpaths of the cell in process, with the names of their ports
+ * and their edge, so that each IOPATH of the cell is matched against
+ * them without getting the names of all the modpaths again.
+ */
+struct sdf_modpath_s {
+      char*src;
+      char*dst;
+      int edge;
+      vpiHandle path;
+};
+
+static vpiHandle sdf_path_cell = 0;
+static struct sdf_modpath_s*sdf_paths = 0;
+static unsigned sdf_npaths = 0;
+
+static void clear_cell_paths(void)
+{
+      unsigned idx;
+      for (idx = 0 ;  idx < sdf_npaths ;  idx += 1) {
+	    free(sdf_paths[idx].src);
+	    free(sdf_paths[idx].dst);
+      }
+      free(sdf_paths);
+      sdf_paths = 0;
+      sdf_npaths = 0;
+      sdf_path_cell = 0;
+}
+
+static void load_cell_paths(vpiHandle cell)
+{
+      vpiHandle iter, path;
+
+      if (cell == sdf_path_cell) return;
+      clear_cell_paths();
+      sdf_path_cell = cell;
+
+      iter = vpi_iterate(vpiModPath, cell);
+      if (iter) while ( (path = vpi_scan(iter)) ) {
+	    struct sdf_modpath_s*cur;
+
+	    vpiHandle path_t_in = vpi_handle(vpiModPathIn,path);
+	    vpiHandle path_t_out = vpi_handle(vpiModPathOut,path);
+
+	    vpiHandle path_in = vpi_handle(vpiExpr,path_t_in);
+	    vpiHandle path_out = vpi_handle(vpiExpr,path_t_out);
+
+	      /* The expressions for the path terms must be signals,
+	         vpiNet or vpiReg. */
+	    assert(vpi_get(vpiType,path_in) == vpiNet);
+	    assert(vpi_get(vpiType,path_out) == vpiNet
+		   || vpi_get(vpiType,path_out) == vpiReg);
+
+	    sdf_paths = realloc(sdf_paths, (sdf_npaths+1)*sizeof(*sdf_paths));
+	    cur = sdf_paths + sdf_npaths;
+	    sdf_npaths += 1;
+	    cur->src = strdup(vpi_get_str(vpiName,path_in));
+	    cur->dst = strdup(vpi_get_str(vpiName,path_out));
+	    cur->edge = vpi_get(vpiEdge,path_t_in);
+	    cur->path = path;
+      }
 }
 
 /*
@@ -138,46 +300,35 @@ static const char*edge_str(int vpi_edge)
 void sdf_iopath_delays(int vpi_edge, const char*src, const char*dst,
 		       const struct sdf_delval_list_s*delval_list)
 {
-      vpiHandle iter, path;
+      unsigned pdx;
       int match_count = 0;
 
       if (sdf_cur_cell == 0)
 	    return;
 
-      iter = vpi_iterate(vpiModPath, sdf_cur_cell);
+      load_cell_paths(sdf_cur_cell);
 
 	/* Search for the modpath that matches the IOPATH by looking
 	   for the modpath that uses the same ports as the ports that
 	   the parser has found. */
-      if (iter) while ( (path = vpi_scan(iter)) ) {
+      for (pdx = 0 ;  pdx < sdf_npaths ;  pdx += 1) {
+	    const struct sdf_modpath_s*cur = sdf_paths + pdx;
 	    s_vpi_delay delays;
 	    struct t_vpi_time delay_vals[12];
 	    int idx;
 
-	    vpiHandle path_t_in = vpi_handle(vpiModPathIn,path);
-	    vpiHandle path_t_out = vpi_handle(vpiModPathOut,path);
-
-	    vpiHandle path_in = vpi_handle(vpiExpr,path_t_in);
-	    vpiHandle path_out = vpi_handle(vpiExpr,path_t_out);
-
-	      /* The expressions for the path terms must be signals,
-	         vpiNet or vpiReg. */
-	    assert(vpi_get(vpiType,path_in) == vpiNet);
-	    assert(vpi_get(vpiType,path_out) == vpiNet
-		   || vpi_get(vpiType,path_out) == vpiReg);
-
 	      /* If the src name doesn't match, go on. */
-	    if (strcmp(src,vpi_get_str(vpiName,path_in)) != 0)
+	    if (strcmp(src,cur->src) != 0)
 		  continue;
 	      /* The edge type must match too. But note that if this
 	         IOPATH has no edge, then it matches with all edges of
 	         the modpath object. */
 /* --> Is this correct in the context of the 10, 01, etc. edges? */
-	    if (vpi_edge != vpiNoEdge && vpi_get(vpiEdge,path_t_in) != vpi_edge)
+	    if (vpi_edge != vpiNoEdge && cur->edge != vpi_edge)
 		  continue;
 
 	      /* If the dst name doesn't match, go on. */
-	    if (strcmp(dst,vpi_get_str(vpiName,path_out)) != 0)
+	    if (strcmp(dst,cur->dst) != 0)
 		  continue;
 
 	      /* Ah, this must be a match! */
@@ -187,7 +338,7 @@ void sdf_iopath_delays(int vpi_edge, const char*src, const char*dst,
 	    delays.mtm_flag = 0;
 	    delays.append_flag = 0;
 	    delays.pulsere_flag = 0;
-	    vpi_get_delays(path, &delays);
+	    vpi_get_delays(cur->path, &delays);
 
 	    for (idx = 0 ; idx < delval_list->count ; idx += 1) {
 		  delay_vals[idx].type = vpiScaledRealTime;
@@ -196,7 +347,7 @@ void sdf_iopath_delays(int vpi_edge, const char*src, const char*dst,
 		  }
 	    }
 
-	    vpi_put_delays(path, &delays);
+	    vpi_put_delays(cur->path, &delays);
 	    match_count += 1;
       }
 
@@ -317,6 +468,8 @@ static PLI_INT32 sys_sdf_annotate_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       sdf_callh = callh;
       sdf_process_file(sdf_fd, fname);
       sdf_callh = 0;
+      clear_cell_paths();
+      scope_table_clear();
 
       fclose(sdf_fd);
       free(fname);
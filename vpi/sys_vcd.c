@@ -43,6 +43,8 @@ struct vcd_info {
       const char *ident;
       struct vcd_info *next;
       struct vcd_info *dmp_next;
+      PLI_INT32 type;
+      PLI_INT32 size;
       int scheduled;
 };
 
@@ -65,6 +67,112 @@ static const char*units_names[] = {
       "fs"
 };
 
+/*
+ * The value changes are written by a thread of their own. The
+ * simulation formats the values and passes them to the thread in the
+ * work queue (see vcd_priv.h), with the vcd_info of the item, and the
+ * thread writes the lines of the dump. The header of the dump is
+ * written before the thread starts. The simulation keeps the number of
+ * bytes that the thread writes in vcd_fill, so that the dump limit and
+ * the capture segments do not wait for the thread.
+ */
+static int dump_thread = 0;
+static unsigned long vcd_fill = 0;
+
+/*
+ * In capture mode (the -vcd-capture=<size> and -vcd-capture-time=<time>
+ * extended arguments) the value changes are kept in memory instead of
+ * being written to the dump file. The memory is a ring of segments
+ * that together hold about <size> bytes, or at least the last <time>
+ * units (see vcd_priv.h). When the current segment is full, the next
+ * time step starts a new segment, dropping the oldest one if the ring
+ * is full, and the new segment starts with a $dumpall of all the
+ * items so that it does not depend on the dropped segments. The
+ * segments are written to the dump file when $dumptrigger is called,
+ * on a failure, and when the simulation ends after a failure, so the
+ * file holds the last part of the simulation before each trigger. The
+ * segments belong to the thread, and vcd_fill counts the bytes of the
+ * current segment, which started at capture_start.
+ */
+#define CAPTURE_SEGMENTS VCD_CAPTURE_SEGMENTS
+
+struct capture_seg {
+      char *data;
+      size_t fill;
+      size_t alloc;
+};
+
+static int capture_mode = 0;
+static unsigned long capture_limit = 0;
+static PLI_UINT64 capture_window = 0;
+static PLI_UINT64 capture_start = 0;
+static struct capture_seg capture_ring[CAPTURE_SEGMENTS];
+static unsigned capture_first = 0;
+static unsigned capture_count = 1;
+
+static void capture_write(const char*buf, size_t cnt)
+{
+      unsigned idx = (capture_first + capture_count - 1) % CAPTURE_SEGMENTS;
+      struct capture_seg*seg = capture_ring + idx;
+
+      if (seg->fill + cnt > seg->alloc) {
+	    seg->alloc = 2*seg->alloc + cnt + 4096;
+	    seg->data = realloc(seg->data, seg->alloc);
+      }
+      memcpy(seg->data + seg->fill, buf, cnt);
+      seg->fill += cnt;
+}
+
+/* Start a new segment, dropping the oldest if the ring is full. */
+static void capture_next_segment(void)
+{
+      if (capture_count == CAPTURE_SEGMENTS) {
+	    capture_ring[capture_first].fill = 0;
+	    capture_first = (capture_first + 1) % CAPTURE_SEGMENTS;
+	    capture_count -= 1;
+      }
+
+      capture_count += 1;
+}
+
+/* Write all the captured segments to the dump file, oldest first. */
+static void capture_flush(void)
+{
+      unsigned idx;
+
+      for (idx = 0 ;  idx < capture_count ;  idx += 1) {
+	    struct capture_seg*seg = capture_ring
+		  + (capture_first + idx) % CAPTURE_SEGMENTS;
+	    fwrite(seg->data, 1, seg->fill, dump_file);
+	    seg->fill = 0;
+      }
+
+	/* Keep filling the newest segment, which is now empty. */
+      capture_first = (capture_first + capture_count - 1) % CAPTURE_SEGMENTS;
+      capture_count = 1;
+}
+
+/*
+ * These write the value changes for the thread, either to the dump
+ * file or to the capture memory.
+ */
+static void vcd_write(const char*buf, size_t cnt)
+{
+      if (capture_mode) capture_write(buf, cnt);
+      else fwrite(buf, 1, cnt, dump_file);
+}
+
+static void vcd_puts(const char*str)
+{
+      vcd_write(str, strlen(str));
+}
+
+static void vcd_putc(char ch)
+{
+      if (capture_mode) capture_write(&ch, 1);
+      else fputc(ch, dump_file);
+}
+
 static char vcdid[8] = "!";
 
 static void gen_new_vcd_id(void)
@@ -85,7 +193,7 @@ static void gen_new_vcd_id(void)
       assert(0);
 }
 
-static char *truncate_bitvec(char *s)
+static const char *truncate_bitvec(const char *s)
 {
       char r;
 
@@ -101,44 +209,142 @@ static char *truncate_bitvec(char *s)
       }
 }
 
+/*
+ * These queue the dump text for the thread, and count its bytes.
+ */
+static void emit_text(const char*text)
+{
+      vcd_fill += strlen(text);
+      vcd_work_emit_text(text);
+}
+
+static void emit_time(PLI_UINT64 now)
+{
+      char buf[32];
+      int len = snprintf(buf, sizeof(buf), "#%" PLI_UINT64_FMT "\n", now);
+      vcd_fill += len;
+      vcd_work_set_time(now);
+      vcd_work_time_change();
+}
+
+/*
+ * Queue the bits of a value change. A vector is written as "b<bits>
+ * <ident>" and anything else as "<bits><ident>".
+ */
+static void emit_bits(struct vcd_info*info, const char*bits)
+{
+      size_t len = strlen(bits) + strlen(info->ident) + 1;
+      if (info->size != 1 && info->type != vpiNamedEvent) len += 2;
+      vcd_fill += len;
+      vcd_work_emit_bits(info, bits);
+}
+
+/*
+ * This is called for every value change of every dumped item, so the
+ * type and size of the item are kept in the vcd_info. A real value is
+ * formatted here, since the length of its line must be known.
+ */
 static void show_this_item(struct vcd_info*info)
 {
       s_vpi_value value;
-      PLI_INT32 type = vpi_get(vpiType, info->item);
 
-      if (type == vpiRealVar) {
+      if (info->type == vpiRealVar) {
+	    char buf[64];
 	    value.format = vpiRealVal;
 	    vpi_get_value(info->item, &value);
-	    fprintf(dump_file, "r%.16g %s\n", value.value.real, info->ident);
-      } else if (type == vpiNamedEvent) {
-	    fprintf(dump_file, "1%s\n", info->ident);
-      } else if (vpi_get(vpiSize, info->item) == 1) {
-	    value.format = vpiBinStrVal;
-	    vpi_get_value(info->item, &value);
-	    fprintf(dump_file, "%s%s\n", value.value.str, info->ident);
+	    snprintf(buf, sizeof(buf), "r%.16g %s\n",
+	             value.value.real, info->ident);
+	    emit_text(buf);
+      } else if (info->type == vpiNamedEvent) {
+	    emit_bits(info, "1");
       } else {
-	    value.format = vpiBinStrVal;
-	    vpi_get_value(info->item, &value);
-	    fprintf(dump_file, "b%s %s\n", truncate_bitvec(value.value.str),
-		    info->ident);
+	    const char*bits;
+	    if (vcd_can_coalesce(info->type)) {
+		  bits = vcd_get_bits(info->item, info->size);
+	    } else {
+		  value.format = vpiBinStrVal;
+		  vpi_get_value(info->item, &value);
+		  bits = value.value.str;
+	    }
+
+	    if (info->size != 1) bits = truncate_bitvec(bits);
+	    emit_bits(info, bits);
       }
 }
 
 /* Dump values for a $dumpoff. */
 static void show_this_item_x(struct vcd_info*info)
 {
-      PLI_INT32 type = vpi_get(vpiType, info->item);
-
-      if (type == vpiRealVar) {
+      if (info->type == vpiRealVar) {
 	      /* Some tools dump nothing here...? */
-	    fprintf(dump_file, "rNaN %s\n", info->ident);
-      } else if (type == vpiNamedEvent) {
+	    char buf[64];
+	    snprintf(buf, sizeof(buf), "rNaN %s\n", info->ident);
+	    emit_text(buf);
+      } else if (info->type == vpiNamedEvent) {
 	    /* Do nothing for named events. */
-      } else if (vpi_get(vpiSize, info->item) == 1) {
-	    fprintf(dump_file, "x%s\n", info->ident);
       } else {
-	    fprintf(dump_file, "bx %s\n", info->ident);
+	    emit_bits(info, "x");
+      }
+}
+
+/*
+ * The thread that writes the dump lines that the simulation queues.
+ */
+static void* vcd_thread(void*arg)
+{
+      int run_flag = 1;
+
+      (void)arg; /* Parameter is not used. */
+
+      while (run_flag) {
+	    struct vcd_work_item_s*cell = vcd_work_thread_peek();
+	    struct vcd_info*info = (struct vcd_info*)cell->sym;
+	    char buf[32];
+
+	    switch (cell->type) {
+		case WT_NONE:
+		case WT_EMIT_DOUBLE:
+		case WT_DUMPON:
+		case WT_DUMPOFF:
+		  break;
+		case WT_TIME_CHANGE:
+		  vcd_write(buf, snprintf(buf, sizeof(buf),
+		                          "#%" PLI_UINT64_FMT "\n",
+		                          (PLI_UINT64)cell->time));
+		  break;
+		case WT_EMIT_TEXT:
+		  vcd_puts(cell->op_.val_char);
+		  break;
+		case WT_EMIT_BITS:
+		  if (info->size == 1 || info->type == vpiNamedEvent) {
+			vcd_puts(cell->op_.val_char);
+		  } else {
+			vcd_putc('b');
+			vcd_puts(cell->op_.val_char);
+			vcd_putc(' ');
+		  }
+		  vcd_puts(info->ident);
+		  vcd_putc('\n');
+		  break;
+		case WT_FLUSH:
+		  fflush(dump_file);
+		  break;
+		case WT_CAPTURE_NEXT:
+		  capture_next_segment();
+		  break;
+		case WT_CAPTURE_WRITE:
+		  capture_flush();
+		  fflush(dump_file);
+		  break;
+		case WT_TERMINATE:
+		  run_flag = 0;
+		  break;
+	    }
+
+	    vcd_work_thread_pop();
       }
+
+      return 0;
 }
 
 
@@ -181,14 +387,34 @@ static PLI_INT32 variable_cb_2(p_cb_data cause)
 {
       struct vcd_info* info = vcd_dmp_list;
       PLI_UINT64 now = timerec_to_time64(cause->time);
+      int new_segment = 0;
+
+	/* The coalesced callback may have written the list already. */
+      if (info == 0) return 0;
 
       if (now != vcd_cur_time) {
-	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now);
+	    if (capture_mode &&
+	        vcd_capture_segment_full(capture_limit, capture_window,
+	                                 vcd_fill, capture_start, now)) {
+		  vcd_work_capture_next();
+		  vcd_fill = 0;
+		  capture_start = now;
+		  new_segment = 1;
+	    }
+	    emit_time(now);
 	    vcd_cur_time = now;
       }
 
+	/* A new capture segment starts with all the values, which
+	   covers the items that changed. */
+      if (new_segment) {
+	    emit_text("$dumpall\n");
+	    vcd_checkpoint();
+	    emit_text("$end\n");
+      }
+
       do {
-           show_this_item(info);
+           if (!new_segment) show_this_item(info);
            info->scheduled = 0;
       } while ((info = info->dmp_next) != 0);
 
@@ -197,25 +423,39 @@ static PLI_INT32 variable_cb_2(p_cb_data cause)
       return 0;
 }
 
-static PLI_INT32 variable_cb_1(p_cb_data cause)
+/*
+ * Return true if value changes are not being dumped now, either
+ * because the dump is off or because it reached its size limit.
+ */
+static int dump_is_stopped(void)
 {
-      struct t_cb_data cb;
-      struct vcd_info*info = (struct vcd_info*)cause->user_data;
-
-      if (dump_is_full) return 0;
-      if (dump_is_off) return 0;
-      if (dump_header_pending()) return 0;
-      if (info->scheduled) return 0;
+      if (dump_is_full) return 1;
+      if (dump_is_off) return 1;
+      if (dump_header_pending()) return 1;
 
-      if ((dump_limit > 0) && (ftell(dump_file) > dump_limit)) {
+      if ((dump_limit > 0) && !capture_mode &&
+          (vcd_fill > (unsigned long)dump_limit)) {
+            char buf[80];
             dump_is_full = 1;
             vpi_printf("WARNING: Dump file limit (%ld bytes) "
                                "exceeded.\n", dump_limit);
-            fprintf(dump_file, "$comment Dump file limit (%ld bytes) "
-                               "exceeded. $end\n", dump_limit);
-            return 0;
+            snprintf(buf, sizeof(buf), "$comment Dump file limit (%ld bytes) "
+                     "exceeded. $end\n", dump_limit);
+            emit_text(buf);
+            return 1;
       }
 
+      return 0;
+}
+
+static PLI_INT32 variable_cb_1(p_cb_data cause)
+{
+      struct t_cb_data cb;
+      struct vcd_info*info = (struct vcd_info*)cause->user_data;
+
+      if (info->scheduled) return 0;
+      if (dump_is_stopped()) return 0;
+
       if (!vcd_dmp_list) {
           cb = *cause;
 	  cb.time = &zero_delay;
@@ -231,6 +471,35 @@ static PLI_INT32 variable_cb_1(p_cb_data cause)
       return 0;
 }
 
+/*
+ * This is called at the end of each time step with an iterator over
+ * the coalesced items that changed. They go on the same list as the
+ * items that variable_cb_1 schedules, and the list is written now.
+ */
+static PLI_INT32 variable_cb_coalesced(p_cb_data cause)
+{
+      vpiHandle item;
+
+	/* The $dumpvars values of this step are already the final
+	   ones, and variable_cb_1 drops the changes before them. */
+      if (dump_is_stopped() ||
+          timerec_to_time64(cause->time) == dumpvars_time) {
+	    vpi_free_object(cause->obj);
+	    return 0;
+      }
+
+      while ((item = vpi_scan(cause->obj))) {
+	    struct vcd_info*info = vcd_coalesced_item_find(item);
+	    assert(info);
+	    if (info->scheduled) continue;
+	    info->scheduled = 1;
+	    info->dmp_next  = vcd_dmp_list;
+	    vcd_dmp_list    = info;
+      }
+
+      return variable_cb_2(cause);
+}
+
 static PLI_INT32 dumpvars_cb(p_cb_data cause)
 {
       if (dumpvars_status != 1) return 0;
@@ -242,11 +511,17 @@ static PLI_INT32 dumpvars_cb(p_cb_data cause)
 
       fprintf(dump_file, "$enddefinitions $end\n");
 
+	/* The thread writes the rest of the dump. */
+      vcd_fill = capture_mode? 0 : ftell(dump_file);
+      capture_start = dumpvars_time;
+      vcd_work_start(vcd_thread, 0);
+      dump_thread = 1;
+
       if (!dump_is_off) {
-	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", dumpvars_time);
-	    fprintf(dump_file, "$dumpvars\n");
+	    emit_time(dumpvars_time);
+	    emit_text("$dumpvars\n");
 	    vcd_checkpoint();
-	    fprintf(dump_file, "$end\n");
+	    emit_text("$end\n");
       }
 
       return 0;
@@ -255,6 +530,7 @@ static PLI_INT32 dumpvars_cb(p_cb_data cause)
 static PLI_INT32 finish_cb(p_cb_data cause)
 {
       struct vcd_info *cur, *next;
+      unsigned idx;
 
       if (finish_status != 0) return 0;
 
@@ -262,6 +538,14 @@ static PLI_INT32 finish_cb(p_cb_data cause)
 
       dumpvars_time = timerec_to_time64(cause->time);
 
+      if (dump_thread) {
+	      /* Only a failed simulation keeps its capture. */
+	    if (capture_mode && vcd_capture_failed())
+		  vcd_work_capture_write();
+	    vcd_work_terminate();
+	    dump_thread = 0;
+      }
+
       if (!dump_is_off && !dump_is_full && dumpvars_time != vcd_cur_time) {
 	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", dumpvars_time);
       }
@@ -274,9 +558,16 @@ static PLI_INT32 finish_cb(p_cb_data cause)
 	    free(cur);
       }
       vcd_list = 0;
+      for (idx = 0 ;  idx < CAPTURE_SEGMENTS ;  idx += 1) {
+	    free(capture_ring[idx].data);
+	    capture_ring[idx].data = 0;
+	    capture_ring[idx].alloc = 0;
+      }
       vcd_names_delete(&vcd_tab);
       vcd_names_delete(&vcd_var);
       nexus_ident_delete();
+      vcd_coalesced_items_delete();
+      vcd_bits_delete();
       free(dump_path);
       dump_path = 0;
 
@@ -332,13 +623,13 @@ static PLI_INT32 sys_dumpoff_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now64);
+	    emit_time(now64);
 	    vcd_cur_time = now64;
       }
 
-      fprintf(dump_file, "$dumpoff\n");
+      emit_text("$dumpoff\n");
       vcd_checkpoint_x();
-      fprintf(dump_file, "$end\n");
+      emit_text("$end\n");
 
       return 0;
 }
@@ -362,13 +653,13 @@ static PLI_INT32 sys_dumpon_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now64);
+	    emit_time(now64);
 	    vcd_cur_time = now64;
       }
 
-      fprintf(dump_file, "$dumpon\n");
+      emit_text("$dumpon\n");
       vcd_checkpoint();
-      fprintf(dump_file, "$end\n");
+      emit_text("$end\n");
 
       return 0;
 }
@@ -389,13 +680,13 @@ static PLI_INT32 sys_dumpall_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
       now64 = timerec_to_time64(&now);
 
       if (now64 > vcd_cur_time) {
-	    fprintf(dump_file, "#%" PLI_UINT64_FMT "\n", now64);
+	    emit_time(now64);
 	    vcd_cur_time = now64;
       }
 
-      fprintf(dump_file, "$dumpall\n");
+      emit_text("$dumpall\n");
       vcd_checkpoint();
-      fprintf(dump_file, "$end\n");
+      emit_text("$end\n");
 
       return 0;
 }
@@ -485,7 +776,40 @@ static PLI_INT32 sys_dumpfile_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 static PLI_INT32 sys_dumpflush_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
 {
       (void)name; /* Parameter is not used. */
-      if (dump_file) fflush(dump_file);
+      if (dump_thread) vcd_work_flush();
+      else if (dump_file) fflush(dump_file);
+
+      return 0;
+}
+
+/*
+ * Have the thread write the captured value changes to the dump file.
+ * Nothing is captured before the thread starts.
+ */
+static void capture_trigger(void)
+{
+      if (dump_file == 0) return;
+
+      if (dump_thread) {
+	    vcd_work_capture_write();
+	    vcd_fill = 0;
+      } else {
+	    fflush(dump_file);
+      }
+}
+
+/*
+ * In capture mode, write the captured value changes to the dump
+ * file. Otherwise this is the same as $dumpflush.
+ */
+static PLI_INT32 sys_dumptrigger_calltf(ICARUS_VPI_CONST PLI_BYTE8*name)
+{
+      (void)name; /* Parameter is not used. */
+      if (dump_file == 0) return 0;
+
+      if (capture_mode) capture_trigger();
+      else if (dump_thread) vcd_work_flush();
+      else fflush(dump_file);
 
       return 0;
 }
@@ -501,9 +825,18 @@ static PLI_INT32 sys_dumplimit_calltf(ICARUS_VPI_CONST PLI_BYTE8 *name)
       /* Get the value and set the dump limit. */
       val.format = vpiIntVal;
       vpi_get_value(vpi_scan(argv), &val);
-      dump_limit = val.value.integer;
-
       vpi_free_object(argv);
+
+	/* The capture size already bounds a capture, and the file only
+	   grows when the capture is written. */
+      if (capture_mode) {
+	    vpi_printf("VCD warning: %s:%d: $dumplimit is ignored in "
+	               "capture mode.\n", vpi_get_str(vpiFile, callh),
+	               (int)vpi_get(vpiLineNo, callh));
+	    return 0;
+      }
+
+      dump_limit = val.value.integer;
       return 0;
 }
 
@@ -644,6 +977,8 @@ static void scan_item(unsigned depth, vpiHandle item, int skip)
 		  info->time.type = vpiSimTime;
 		  info->item  = item;
 		  info->ident = ident;
+		  info->type  = vpi_get(vpiType, item);
+		  info->size  = vpi_get(vpiSize, item);
 		  info->scheduled = 0;
 
 		  cb.time      = &info->time;
@@ -653,6 +988,13 @@ static void scan_item(unsigned depth, vpiHandle item, int skip)
 		  cb.reason    = cbValueChange;
 		  cb.cb_rtn    = variable_cb_1;
 
+		  if (vcd_can_coalesce(info->type)) {
+			cb.user_data = 0;
+			cb.reason    = cbValueChangeCoalesced;
+			cb.cb_rtn    = variable_cb_coalesced;
+			vcd_coalesced_item_add(item, info);
+		  }
+
 		  info->dmp_next = 0;
 		  info->next  = vcd_list;
 		  vcd_list    = info;
@@ -874,6 +1216,10 @@ void sys_vcd_register(void)
       s_vpi_systf_data tf_data;
       vpiHandle res;
 
+      vcd_capture_args("vcd", &capture_limit, &capture_window);
+      capture_mode = capture_limit > 0 || capture_window > 0;
+      if (capture_mode) vcd_capture_set_trigger(capture_trigger);
+
       /* All the compiletf routines are located in vcd_priv.c. */
 
       tf_data.type      = vpiSysTask;
@@ -903,6 +1249,15 @@ void sys_vcd_register(void)
       res = vpi_register_systf(&tf_data);
       vpip_make_systf_system_defined(res);
 
+      tf_data.type      = vpiSysTask;
+      tf_data.tfname    = "$dumptrigger";
+      tf_data.calltf    = sys_dumptrigger_calltf;
+      tf_data.compiletf = sys_no_arg_compiletf;
+      tf_data.sizetf    = 0;
+      tf_data.user_data = "$dumptrigger";
+      res = vpi_register_systf(&tf_data);
+      vpip_make_systf_system_defined(res);
+
       tf_data.type      = vpiSysTask;
       tf_data.tfname    = "$dumplimit";
       tf_data.calltf    = sys_dumplimit_calltf;
@@ -130,6 +130,149 @@ void vcd_names_sort(struct vcd_names_list_s*tab)
       }
 }
 
+/*
+ * These are the types that the run time supports for a
+ * cbValueChangeCoalesced callback. Array words, named events and the
+ * rest use a cbValueChange callback.
+ */
+int vcd_can_coalesce(PLI_INT32 type)
+{
+      switch (type) {
+	  case vpiNet:
+	  case vpiReg:
+	  case vpiIntegerVar:
+	  case vpiBitVar:
+	  case vpiByteVar:
+	  case vpiShortIntVar:
+	  case vpiIntVar:
+	  case vpiLongIntVar:
+	  case vpiRealVar:
+	    return 1;
+	  default:
+	    return 0;
+      }
+}
+
+static s_vpi_vecval*bits_vec = 0;
+static unsigned bits_vec_size = 0;
+static char*bits_str = 0;
+static unsigned bits_str_size = 0;
+
+const char*vcd_get_bits(vpiHandle item, unsigned size)
+{
+      unsigned words = (size + 31) / 32;
+      unsigned idx;
+
+      if (words > bits_vec_size) {
+	    bits_vec = realloc(bits_vec, words * sizeof(s_vpi_vecval));
+	    bits_vec_size = words;
+      }
+      if (size + 1 > bits_str_size) {
+	    bits_str = realloc(bits_str, size + 1);
+	    bits_str_size = size + 1;
+      }
+
+      if (vpip_get_vecval_multi(1, &item, bits_vec) < 0) {
+	    s_vpi_value value;
+	    value.format = vpiVectorVal;
+	    vpi_get_value(item, &value);
+	    memcpy(bits_vec, value.value.vector, words * sizeof(s_vpi_vecval));
+      }
+
+	/* The aval/bval pairs 00, 10, 11 and 01 are 0, 1, x and z. */
+      for (idx = 0 ;  idx < size ;  idx += 1) {
+	    const s_vpi_vecval*word = bits_vec + idx / 32;
+	    unsigned bit = idx % 32;
+	    unsigned ab = ((word->aval >> bit) & 1) | (((word->bval >> bit) & 1) << 1);
+	    bits_str[size-1-idx] = "01zx"[ab];
+      }
+      bits_str[size] = 0;
+
+      return bits_str;
+}
+
+void vcd_bits_delete(void)
+{
+      free(bits_vec);
+      bits_vec = 0;
+      bits_vec_size = 0;
+      free(bits_str);
+      bits_str = 0;
+      bits_str_size = 0;
+}
+
+void vcd_capture_args(const char*dumper, unsigned long*size,
+		      PLI_UINT64*window)
+{
+      struct t_vpi_vlog_info vlog_info;
+      size_t len = strlen(dumper);
+      int idx;
+
+      *size = 0;
+      *window = 0;
+
+      vpi_get_vlog_info(&vlog_info);
+
+      for (idx = 0 ;  idx < vlog_info.argc ;  idx += 1) {
+	    const char*arg = vlog_info.argv[idx];
+	    char *end;
+	    if (arg[0] != '-' || strncmp(arg+1, dumper, len) != 0)
+		  continue;
+	    arg += len + 1;
+	    if (strncmp(arg, "-capture=", 9) == 0) {
+		  *size = strtoul(arg+9, &end, 10);
+		  switch (*end) {
+		      case 'k':
+		      case 'K':
+			*size *= 1024;
+			break;
+		      case 'm':
+		      case 'M':
+			*size *= 1024*1024;
+			break;
+		  }
+	    } else if (strncmp(arg, "-capture-time=", 14) == 0) {
+		  *window = strtoull(arg+14, &end, 10);
+	    }
+      }
+}
+
+int vcd_capture_segment_full(unsigned long size, PLI_UINT64 window,
+			     unsigned long fill, PLI_UINT64 start,
+			     PLI_UINT64 now)
+{
+	/* All but the current segment hold a whole span, so together
+	   they cover at least the window. */
+      if (window > 0) {
+	    PLI_UINT64 span = window / (VCD_CAPTURE_SEGMENTS-1);
+	    if (span == 0) span = 1;
+	    if (now - start >= span) return 1;
+      }
+
+      if (size > 0 && fill >= size / VCD_CAPTURE_SEGMENTS) return 1;
+
+      return 0;
+}
+
+static void (*capture_trigger)(void) = 0;
+static int capture_failed = 0;
+
+void vcd_capture_set_trigger(void (*trigger)(void))
+{
+      capture_trigger = trigger;
+}
+
+void vcd_capture_trigger(void)
+{
+      capture_failed = 1;
+      if (capture_trigger) capture_trigger();
+}
+
+int vcd_capture_failed(void)
+{
+      return capture_failed || vpip_get_return_value() != 0;
+}
+
 /*
  * Since the compiletf routines are all the same they are located here,
  * so we only need a single copy. Some are generic enough they can use
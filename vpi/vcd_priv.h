@@ -62,34 +62,99 @@ EXTERN void vcd_scope_names_add(const char*name);
 EXTERN int  vcd_scope_names_test(const char*name);
 EXTERN void vcd_scope_names_delete(void);
 
+/*
+ * The VCD and FST dumpers record the changes of most items with a
+ * single cbValueChangeCoalesced callback, which the run time calls
+ * once at the end of each time step with the items that changed. The
+ * items of that callback are those that vcd_can_coalesce accepts, and
+ * the coalesced item map finds the dumper information of each item
+ * that changed. The others get a cbValueChange callback each.
+ */
+EXTERN int   vcd_can_coalesce(PLI_INT32 type);
+EXTERN void  vcd_coalesced_item_add(vpiHandle item, void*info);
+EXTERN void* vcd_coalesced_item_find(vpiHandle item);
+EXTERN void  vcd_coalesced_items_delete(void);
+
+/*
+ * Get the value of a vector item as a string of 0, 1, x and z
+ * characters, most significant bit first, like the vpiBinStrVal
+ * format. The value is read as vector words with vpip_get_vecval_multi,
+ * or with vpi_get_value if the item is not a plain signal,
+ * and the string is in a buffer that is reused by the next call. Free
+ * the buffers with vcd_bits_delete when the dump is done.
+ */
+EXTERN const char*vcd_get_bits(vpiHandle item, unsigned size);
+EXTERN void vcd_bits_delete(void);
+
+/*
+ * In capture mode the VCD and FST dumpers keep the value changes in a
+ * ring of VCD_CAPTURE_SEGMENTS segments in memory, and only write them
+ * to the dump file when a trigger fires. vcd_capture_args gets the
+ * size in bytes and the window in simulation time units of the capture
+ * from the -<dumper>-capture=<size> and -<dumper>-capture-time=<time>
+ * extended arguments, or 0 for each that is not given. The dumper is in
+ * capture mode if either is not 0.
+ *
+ * A new segment starts at the next time step when the current one is
+ * full, either because it holds a quarter of the size, or because it
+ * covers a third of the window. The segments that are kept then cover
+ * at least the last window time units.
+ */
+#define VCD_CAPTURE_SEGMENTS 4
+
+EXTERN void vcd_capture_args(const char*dumper, unsigned long*size,
+			     PLI_UINT64*window);
+EXTERN int  vcd_capture_segment_full(unsigned long size, PLI_UINT64 window,
+				     unsigned long fill, PLI_UINT64 start,
+				     PLI_UINT64 now);
+
+/*
+ * The dumper in capture mode gives the function that writes its
+ * capture, which vcd_capture_trigger calls for a failure (see
+ * sys_priv.h). At the end of the simulation the dumper only writes
+ * the capture if vcd_capture_failed says that there was a failure:
+ * a trigger, or a non-zero exit code for vvp.
+ */
+EXTERN void vcd_capture_set_trigger(void (*trigger)(void));
+EXTERN int  vcd_capture_failed(void);
+
 /*
  * Implement a work queue that can be used to send commands to a
- * dumper thread.
+ * dumper thread. The LXT2, VCD and FST dumpers each start a thread
+ * that formats and writes the value changes, so the simulation only
+ * puts records in the queue. Only one dumper is used in a simulation,
+ * so they share the one queue. The sym of an item is whatever the
+ * dumper uses to name the item: an LXT2 symbol or the vcd_info of the
+ * VCD and FST dumpers.
  */
 
 typedef enum vcd_work_item_type_e {
       WT_NONE,
       WT_EMIT_BITS,
       WT_EMIT_DOUBLE,
+      WT_EMIT_TEXT,
+      WT_TIME_CHANGE,
       WT_DUMPON,
       WT_DUMPOFF,
       WT_FLUSH,
+      WT_CAPTURE_NEXT,
+      WT_CAPTURE_WRITE,
       WT_TERMINATE
 } vcd_work_item_type_t;
 
-struct lxt2_wr_symbol;
-
 struct vcd_work_item_s {
       vcd_work_item_type_t type;
       uint64_t time;
-      union {
-	    struct lxt2_wr_symbol*lxt2;
-      } sym_;
+      void*sym;
 
       union {
 	    double val_double;
 	    char*val_char;
       } op_;
+	/* The bytes of the work arena that the val_char of a
+	   WT_EMIT_BITS or WT_EMIT_TEXT item uses, or 0 if it was
+	   malloc'ed. */
+      unsigned val_arena;
 };
 
 /*
@@ -117,14 +182,23 @@ EXTERN void vcd_work_sync(void);
 
 /*
  * The remaining vcd_work_* functions send messages to the work thread
- * causing it to perform various VCD-related tasks.
+ * causing it to perform various VCD-related tasks. The time of each
+ * item is the last time given to vcd_work_set_time. The LXT2 thread
+ * moves to the time of each item, and the VCD and FST threads only
+ * write a time when they get a WT_TIME_CHANGE. The text of a
+ * WT_EMIT_TEXT item is written to a VCD file as it is, and the
+ * capture items only apply to a VCD capture.
  */
 EXTERN void vcd_work_flush(void); /* Drain output caches. */
 EXTERN void vcd_work_set_time(uint64_t val);
+EXTERN void vcd_work_time_change(void);
 EXTERN void vcd_work_dumpon(void);
 EXTERN void vcd_work_dumpoff(void);
-EXTERN void vcd_work_emit_double(struct lxt2_wr_symbol*sym, double val);
-EXTERN void vcd_work_emit_bits(struct lxt2_wr_symbol*sym, const char*bits);
+EXTERN void vcd_work_capture_next(void);
+EXTERN void vcd_work_capture_write(void);
+EXTERN void vcd_work_emit_double(void*sym, double val);
+EXTERN void vcd_work_emit_bits(void*sym, const char*bits);
+EXTERN void vcd_work_emit_text(const char*text);
 
 /* The compiletf routines are common for the VCD, LXT and LXT2 dumpers. */
 EXTERN PLI_INT32 sys_dumpvars_compiletf(ICARUS_VPI_CONST PLI_BYTE8 *name);
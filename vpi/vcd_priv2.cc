@@ -21,6 +21,7 @@
 # include  <map>
 # include  <set>
 # include  <string>
+# include  <vector>
 # include  <pthread.h>
 # include  <cstdlib>
 # include  <cstring>
@@ -83,6 +84,68 @@ extern "C" void vcd_scope_names_delete(void)
       vcd_scope_names_set.clear();
 }
 
+/*
+   Coalesced item map
+
+   The items that share the one cbValueChangeCoalesced callback of a
+   dumper come back to it as the handles of an iterator, so this maps
+   each handle to the information that the dumper keeps for it. Every
+   item that changes is looked up at the end of each time step, so
+   this is an open addressed hash table on the handle pointer, which
+   is kept at most half full.
+*/
+
+struct coalesced_item_s {
+      vpiHandle item;
+      void*info;
+};
+
+static std::vector<coalesced_item_s> coalesced_item_tab;
+static size_t coalesced_item_count = 0;
+
+static size_t coalesced_item_slot(vpiHandle item)
+{
+      size_t mask = coalesced_item_tab.size() - 1;
+      size_t idx = (size_t)(((uintptr_t)item >> 4) * 2654435761UL) & mask;
+      while (coalesced_item_tab[idx].item && coalesced_item_tab[idx].item != item)
+	    idx = (idx + 1) & mask;
+      return idx;
+}
+
+extern "C" void vcd_coalesced_item_add(vpiHandle item, void*info)
+{
+      if (2 * (coalesced_item_count + 1) > coalesced_item_tab.size()) {
+	    std::vector<coalesced_item_s> old;
+	    old.swap(coalesced_item_tab);
+	    coalesced_item_s empty = { 0, 0 };
+	    coalesced_item_tab.assign(old.empty()? 1024 : 2 * old.size(), empty);
+	    for (size_t idx = 0 ;  idx < old.size() ;  idx += 1) {
+		  if (old[idx].item)
+			coalesced_item_tab[coalesced_item_slot(old[idx].item)] = old[idx];
+	    }
+      }
+
+      size_t idx = coalesced_item_slot(item);
+      if (coalesced_item_tab[idx].item == 0)
+	    coalesced_item_count += 1;
+      coalesced_item_tab[idx].item = item;
+      coalesced_item_tab[idx].info = info;
+}
+
+extern "C" void* vcd_coalesced_item_find(vpiHandle item)
+{
+      if (coalesced_item_tab.empty())
+	    return 0;
+      return coalesced_item_tab[coalesced_item_slot(item)].info;
+}
+
+extern "C" void vcd_coalesced_items_delete(void)
+{
+      std::vector<coalesced_item_s> empty;
+      coalesced_item_tab.swap(empty);
+      coalesced_item_count = 0;
+}
+
 static pthread_t work_thread;
 
 static const unsigned WORK_QUEUE_SIZE = 128*1024;
@@ -90,14 +153,43 @@ static const unsigned WORK_QUEUE_BATCH_MIN = 4*1024;
 static const unsigned WORK_QUEUE_BATCH_MAX = 32*1024;
 
 static struct vcd_work_item_s work_queue[WORK_QUEUE_SIZE];
-static volatile unsigned work_queue_next = 0;
-static volatile unsigned work_queue_fill = 0;
+
+/*
+ * The work queue is a ring with a single producer (the simulation)
+ * and a single consumer (the work thread). The producer owns the
+ * work_queue_head, the consumer owns the work_queue_next, and the
+ * work_queue_fill is the only index that they share. It is changed
+ * with atomic operations, so the items are passed without locking the
+ * queue. The mutex is only taken by a side that must wait, and by the
+ * side that makes the condition that the other may be waiting for.
+ */
+static unsigned work_queue_head = 0;
+static unsigned work_queue_next = 0;
+static unsigned work_queue_fill = 0;
 
 static pthread_mutex_t work_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  work_queue_is_empty_sig = PTHREAD_COND_INITIALIZER;
 static pthread_cond_t  work_queue_notempty_sig = PTHREAD_COND_INITIALIZER;
 static pthread_cond_t  work_queue_minfree_sig = PTHREAD_COND_INITIALIZER;
 
+/*
+ * The strings of WT_EMIT_BITS and WT_EMIT_TEXT items are copied into this arena
+ * instead of being allocated one at a time. The arena is used as a
+ * ring in the same order as the work queue, so the work thread
+ * releases the space of an item when it pops the item. A string that
+ * does not fit at the end of the arena starts again at the beginning,
+ * and the skipped bytes are counted with the item.
+ */
+static const unsigned WORK_ARENA_SIZE = 4*1024*1024;
+
+static char work_arena[WORK_ARENA_SIZE];
+static unsigned work_arena_next = 0;
+static unsigned work_arena_fill = 0;
+
+static inline unsigned atomic_get_(unsigned*ptr)
+{
+      return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
 
 extern "C" struct vcd_work_item_s* vcd_work_thread_peek(void)
 {
@@ -106,9 +198,9 @@ extern "C" struct vcd_work_item_s* vcd_work_thread_peek(void)
 	// is non-zero, I can reliably assume that there is at least
 	// one item that I can peek at. I only need to lock if I must
 	// wait for the work_queue_fill to become non-zero.
-      if (work_queue_fill == 0) {
+      if (atomic_get_(&work_queue_fill) == 0) {
 	    pthread_mutex_lock(&work_queue_mutex);
-	    while (work_queue_fill == 0)
+	    while (atomic_get_(&work_queue_fill) == 0)
 		  pthread_cond_wait(&work_queue_notempty_sig, &work_queue_mutex);
 	    pthread_mutex_unlock(&work_queue_mutex);
       }
@@ -118,16 +210,15 @@ extern "C" struct vcd_work_item_s* vcd_work_thread_peek(void)
 
 extern "C" void vcd_work_thread_pop(void)
 {
-      pthread_mutex_lock(&work_queue_mutex);
-
-      unsigned use_fill = work_queue_fill - 1;
-      work_queue_fill = use_fill;
-
       unsigned use_next = work_queue_next;
 
       struct vcd_work_item_s*cell = work_queue + use_next;
-      if (cell->type == WT_EMIT_BITS) {
-	    free(cell->op_.val_char);
+      if (cell->type == WT_EMIT_BITS || cell->type == WT_EMIT_TEXT) {
+	    if (cell->val_arena == 0)
+		  free(cell->op_.val_char);
+	    else
+		  __atomic_sub_fetch(&work_arena_fill, cell->val_arena,
+				     __ATOMIC_ACQ_REL);
       }
 
       use_next += 1;
@@ -135,25 +226,34 @@ extern "C" void vcd_work_thread_pop(void)
 	    use_next = 0;
       work_queue_next = use_next;
 
-      if (use_fill == WORK_QUEUE_SIZE-WORK_QUEUE_BATCH_MIN)
+      unsigned use_fill = __atomic_sub_fetch(&work_queue_fill, 1,
+					     __ATOMIC_ACQ_REL);
+
+	// The producer only waits for the queue to have a batch worth
+	// of free items, or for it to be empty. The fill goes down one
+	// at a time, so there is a wakeup exactly when it reaches one
+	// of those levels.
+      if (use_fill == WORK_QUEUE_SIZE-WORK_QUEUE_BATCH_MIN) {
+	    pthread_mutex_lock(&work_queue_mutex);
 	    pthread_cond_signal(&work_queue_minfree_sig);
-      else if (use_fill == 0)
+	    pthread_mutex_unlock(&work_queue_mutex);
+      } else if (use_fill == 0) {
+	    pthread_mutex_lock(&work_queue_mutex);
 	    pthread_cond_signal(&work_queue_is_empty_sig);
-
-      pthread_mutex_unlock(&work_queue_mutex);
+	    pthread_mutex_unlock(&work_queue_mutex);
+      }
 }
 
 /*
  * Work queue items are created in batches to reduce thread
  * bouncing. When the producer gets a free work item, it actually
- * locks the queue in order to produce a batch. The queue stays locked
- * until the batch is complete. Then the releases the whole lot to the
- * consumer.
+ * reserves room in the queue to produce a batch. The consumer does not
+ * see the batch until it is complete. Then the producer releases the
+ * whole lot to the consumer.
  */
 static uint64_t work_queue_next_time = 0;
 static unsigned current_batch_cnt = 0;
 static unsigned current_batch_alloc = 0;
-static unsigned current_batch_base = 0;
 
 extern "C" void vcd_work_start( void* (*fun) (void*), void*arg )
 {
@@ -163,25 +263,27 @@ extern "C" void vcd_work_start( void* (*fun) (void*), void*arg )
 static struct vcd_work_item_s* grab_item(void)
 {
       if (current_batch_alloc == 0) {
-	     pthread_mutex_lock(&work_queue_mutex);
-	     while ((WORK_QUEUE_SIZE-work_queue_fill) < WORK_QUEUE_BATCH_MIN)
-		  pthread_cond_wait(&work_queue_minfree_sig, &work_queue_mutex);
-
-	     current_batch_base = work_queue_next + work_queue_fill;
-	     current_batch_alloc = WORK_QUEUE_SIZE - work_queue_fill;
-
-	     pthread_mutex_unlock(&work_queue_mutex);
-
-	     if (current_batch_base >= WORK_QUEUE_SIZE)
-		   current_batch_base -= WORK_QUEUE_SIZE;
-	     if (current_batch_alloc > WORK_QUEUE_BATCH_MAX)
-		   current_batch_alloc = WORK_QUEUE_BATCH_MAX;
-	     current_batch_cnt = 0;
+	    unsigned use_fill = atomic_get_(&work_queue_fill);
+	    if ((WORK_QUEUE_SIZE-use_fill) < WORK_QUEUE_BATCH_MIN) {
+		  pthread_mutex_lock(&work_queue_mutex);
+		  for (;;) {
+			use_fill = atomic_get_(&work_queue_fill);
+			if ((WORK_QUEUE_SIZE-use_fill) >= WORK_QUEUE_BATCH_MIN)
+			      break;
+			pthread_cond_wait(&work_queue_minfree_sig, &work_queue_mutex);
+		  }
+		  pthread_mutex_unlock(&work_queue_mutex);
+	    }
+
+	    current_batch_alloc = WORK_QUEUE_SIZE - use_fill;
+	    if (current_batch_alloc > WORK_QUEUE_BATCH_MAX)
+		  current_batch_alloc = WORK_QUEUE_BATCH_MAX;
+	    current_batch_cnt = 0;
       }
 
       assert(current_batch_cnt < current_batch_alloc);
 
-      unsigned cur = current_batch_base + current_batch_cnt;
+      unsigned cur = work_queue_head + current_batch_cnt;
       if (cur >= WORK_QUEUE_SIZE)
 	    cur -= WORK_QUEUE_SIZE;
 
@@ -193,21 +295,23 @@ static struct vcd_work_item_s* grab_item(void)
 
 static void end_batch(void)
 {
-      pthread_mutex_lock(&work_queue_mutex);
+      work_queue_head += current_batch_cnt;
+      if (work_queue_head >= WORK_QUEUE_SIZE)
+	    work_queue_head -= WORK_QUEUE_SIZE;
 
-      unsigned use_fill = work_queue_fill;
+      unsigned use_fill = __atomic_fetch_add(&work_queue_fill,
+					     current_batch_cnt,
+					     __ATOMIC_ACQ_REL);
       bool was_empty_flag = (use_fill==0) && (current_batch_cnt > 0);
 
-      use_fill += current_batch_cnt;
-      work_queue_fill = use_fill;
-
       current_batch_alloc = 0;
       current_batch_cnt = 0;
 
-      if (was_empty_flag)
+      if (was_empty_flag) {
+	    pthread_mutex_lock(&work_queue_mutex);
 	    pthread_cond_signal(&work_queue_notempty_sig);
-
-      pthread_mutex_unlock(&work_queue_mutex);
+	    pthread_mutex_unlock(&work_queue_mutex);
+      }
 }
 
 static inline void unlock_item(bool flush_batch =false)
@@ -222,14 +326,49 @@ extern "C" void vcd_work_sync(void)
       if (current_batch_alloc > 0)
 	    end_batch();
 
-      if (work_queue_fill > 0) {
+      if (atomic_get_(&work_queue_fill) > 0) {
 	    pthread_mutex_lock(&work_queue_mutex);
-	    while (work_queue_fill > 0)
+	    while (atomic_get_(&work_queue_fill) > 0)
 		  pthread_cond_wait(&work_queue_is_empty_sig, &work_queue_mutex);
 	    pthread_mutex_unlock(&work_queue_mutex);
       }
 }
 
+/*
+ * Get space for cnt bytes from the arena, and return in use the number
+ * of bytes that the item takes from the arena. If the arena is full,
+ * wait for the work thread to empty it. Return 0 if the string is too
+ * large for the arena.
+ */
+static char* arena_alloc(unsigned cnt, unsigned&use)
+{
+      if (cnt > WORK_ARENA_SIZE/4) {
+	    use = 0;
+	    return 0;
+      }
+
+      unsigned skip = 0;
+      if (work_arena_next + cnt > WORK_ARENA_SIZE)
+	    skip = WORK_ARENA_SIZE - work_arena_next;
+
+      if (atomic_get_(&work_arena_fill) + skip + cnt > WORK_ARENA_SIZE) {
+	    vcd_work_sync();
+	    assert(atomic_get_(&work_arena_fill) == 0);
+	    work_arena_next = 0;
+	    skip = 0;
+      }
+
+      if (skip > 0)
+	    work_arena_next = 0;
+
+      char*res = work_arena + work_arena_next;
+      work_arena_next += cnt;
+
+      use = skip + cnt;
+      __atomic_add_fetch(&work_arena_fill, use, __ATOMIC_ACQ_REL);
+      return res;
+}
+
 extern "C" void vcd_work_flush(void)
 {
       struct vcd_work_item_s*cell = grab_item();
@@ -251,31 +390,70 @@ extern "C" void vcd_work_dumpoff(void)
       unlock_item();
 }
 
+extern "C" void vcd_work_capture_next(void)
+{
+      struct vcd_work_item_s*cell = grab_item();
+      cell->type = WT_CAPTURE_NEXT;
+      unlock_item();
+}
+
+extern "C" void vcd_work_capture_write(void)
+{
+      struct vcd_work_item_s*cell = grab_item();
+      cell->type = WT_CAPTURE_WRITE;
+      unlock_item(true);
+}
+
 extern "C" void vcd_work_set_time(uint64_t val)
 {
       work_queue_next_time = val;
 }
 
-extern "C" void vcd_work_emit_double(struct lxt2_wr_symbol*sym, double val)
+extern "C" void vcd_work_time_change(void)
+{
+      struct vcd_work_item_s*cell = grab_item();
+      cell->type = WT_TIME_CHANGE;
+      unlock_item();
+}
+
+extern "C" void vcd_work_emit_double(void*sym, double val)
 {
       struct vcd_work_item_s*cell = grab_item();
       cell->type = WT_EMIT_DOUBLE;
-      cell->sym_.lxt2 = sym;
+      cell->sym = sym;
       cell->op_.val_double = val;
       unlock_item();
 }
 
-extern "C" void vcd_work_emit_bits(struct lxt2_wr_symbol*sym, const char* val)
+static void emit_string(vcd_work_item_type_t type, void*sym, const char*val)
 {
+      unsigned cnt = strlen(val) + 1;
+      unsigned use;
+      char*buf = arena_alloc(cnt, use);
+      if (buf)
+	    memcpy(buf, val, cnt);
+      else
+	    buf = strdup(val);
 
       struct vcd_work_item_s*cell = grab_item();
-      cell->type = WT_EMIT_BITS;
-      cell->sym_.lxt2 = sym;
-      cell->op_.val_char = strdup(val);
+      cell->type = type;
+      cell->sym = sym;
+      cell->op_.val_char = buf;
+      cell->val_arena = use;
 
       unlock_item();
 }
 
+extern "C" void vcd_work_emit_bits(void*sym, const char* val)
+{
+      emit_string(WT_EMIT_BITS, sym, val);
+}
+
+extern "C" void vcd_work_emit_text(const char*text)
+{
+      emit_string(WT_EMIT_TEXT, 0, text);
+}
+
 extern "C" void vcd_work_terminate(void)
 {
       struct vcd_work_item_s*cell = grab_item();
@@ -124,6 +124,8 @@ void        vpip_format_strength(char*, s_vpi_value*, unsigned) { }
 void        vpip_make_systf_system_defined(vpiHandle) { }
 void        vpip_mcd_rawwrite(PLI_UINT32, const char*, size_t) { }
 void        vpip_set_return_value(int) { }
+PLI_INT32   vpip_fork_server(const char*) { return -1; }
+PLI_INT32   vpip_get_vecval_multi(PLI_INT32, const vpiHandle*, s_vpi_vecval*) { return 0; }
 void        vpi_vcontrol(PLI_INT32, va_list) { }
 
 
@@ -225,6 +227,8 @@ vpip_routines_s vpi_routines = {
     .make_systf_system_defined  = vpip_make_systf_system_defined,
     .mcd_rawwrite               = vpip_mcd_rawwrite,
     .set_return_value           = vpip_set_return_value,
+    .fork_server                = vpip_fork_server,
+    .get_vecval_multi           = vpip_get_vecval_multi,
 };
 
 typedef PLI_UINT32 (*vpip_set_callback_t)(vpip_routines_s*, PLI_UINT32);
@@ -0,0 +1,116 @@
+#ifndef VPI_SHM_BRIDGE_H
+#define VPI_SHM_BRIDGE_H
+/*
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This is the layout of the shared memory file that the shm_bridge.vpi
+ * module makes for the $shm_bridge("path", signals...) system task.
+ * Another process on the same machine maps the same file to read the
+ * values of the signals and to deposit values into them, without any
+ * call into the simulator.
+ *
+ * The file starts with a shm_bridge_header. The simulation builds the
+ * file under a temporary name and renames it into place when it is
+ * complete, so a client that opens the file sees the whole header. A
+ * file that a client already has mapped is never truncated, so a new
+ * simulation does not pull it away from under the client. The offsets
+ * in the header are byte offsets from the start of the file, and are
+ * all 8 byte aligned. The simulation publishes the values of all the
+ * signals at the read-only sync of each time step:
+ *
+ *    seq is made odd, the values and time are written, and then seq
+ *    is made even again. A reader that sees the same even seq before
+ *    and after it copies the values has a consistent copy.
+ *
+ * The values are in the VPI vector format, (width+31)/32 aval/bval
+ * pairs for each signal, with the least significant word first.
+ *
+ * The commands are a ring of cmd_slots slots. The client fills the
+ * slot cmd_head%cmd_slots and then increments cmd_head. At the start
+ * of each time step, the simulation deposits the value of each new
+ * command into its signal and increments cmd_tail. A command with a
+ * time later than the current time is scheduled for that time.
+ *
+ * If the client sets lockstep, the simulation waits after it publishes
+ * each time step until the client sets ack to the seq of that step.
+ * The client can queue commands before it sets ack, so that they are
+ * applied at the start of the next time step. If the client does not
+ * answer within SHM_BRIDGE_LOCKSTEP_TIMEOUT seconds, the simulation
+ * prints a warning, clears lockstep and goes on.
+ *
+ * The header fields that change are accessed with atomic loads and
+ * stores. The simulation sets finished when it ends, after the last
+ * values are published.
+ */
+
+# include  <stdint.h>
+
+#define SHM_BRIDGE_MAGIC   0x56565042 /* "VVPB" */
+#define SHM_BRIDGE_VERSION 1
+
+#define SHM_BRIDGE_LOCKSTEP_TIMEOUT 10
+
+struct shm_bridge_header {
+      uint32_t magic;
+      uint32_t version;
+	/* Size of the whole file in bytes. */
+      uint32_t size;
+      uint32_t nsignals;
+	/* Table of nsignals shm_bridge_signal entries. */
+      uint32_t signals_off;
+	/* Values of the signals, as shm_bridge_vecval words. */
+      uint32_t values_off;
+	/* The command ring. Each slot is a shm_bridge_cmd followed
+	   by cmd_words value words. */
+      uint32_t cmds_off;
+      uint32_t cmd_slots;
+      uint32_t cmd_words;
+      uint32_t finished;
+	/* Written by the simulation. */
+      uint64_t seq;
+      uint64_t time;
+      uint32_t cmd_tail;
+	/* Written by the client. */
+      uint32_t cmd_head;
+      uint32_t lockstep;
+      uint32_t reserved;
+      uint64_t ack;
+};
+
+struct shm_bridge_signal {
+	/* Full name of the signal, truncated to fit. */
+      char name[120];
+      uint32_t width;
+	/* Index of the first value word of the signal. */
+      uint32_t word;
+};
+
+struct shm_bridge_vecval {
+      uint32_t aval;
+      uint32_t bval;
+};
+
+struct shm_bridge_cmd {
+	/* Index of the signal in the signal table. */
+      uint32_t signal;
+      uint32_t reserved;
+	/* Simulation time at which to deposit the value. */
+      uint64_t time;
+};
+
+#endif /* VPI_SHM_BRIDGE_H */
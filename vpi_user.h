@@ -499,6 +499,22 @@ typedef struct t_cb_data {
 #define cbUnresolvedSystf   24
 #define cbAtEndOfSimTime    31
 
+/*
+ * This Icarus extension is a value change callback that is called at
+ * most once in each time step, in the read-only synch region, however
+ * many times the object changed during the step. Callbacks with the
+ * same cb_rtn, user_data and time type are called together: cb_rtn is
+ * called once, the obj member is an iterator over the objects that
+ * changed and the index member is the number of those objects. An
+ * object can have only one such callback with the same cb_rtn,
+ * user_data and time type, and vpi_register_cb returns 0 for a second
+ * one. A removed callback is dropped from the objects of the current
+ * time step too. The iterator must be scanned to the end or freed with
+ * vpi_free_object. The value member is not used, so the values are
+ * read with vpi_get_value or vpip_get_vecval_multi.
+ */
+#define cbValueChangeCoalesced 1001
+
 extern vpiHandle vpi_register_cb(p_cb_data data);
 extern PLI_INT32 vpi_remove_cb(vpiHandle ref);
 
@@ -640,12 +656,15 @@ extern void vpip_format_strength(char*str, s_vpi_value*value, unsigned bit);
      $finish system tasks bundled with iverilog use this function to
      tell vvp to exit SUCCESS or FAILURE. */
 extern void vpip_set_return_value(int value);
+  /* Get the value that vvp will exit with, so that a module can tell
+     at the end of the simulation if it failed. */
+extern int vpip_get_return_value(void);
 
 extern s_vpi_vecval vpip_calc_clog2(vpiHandle arg);
 extern void vpip_make_systf_system_defined(vpiHandle ref);
 
-  /* Perform fwrite to mcd files. This is used to write raw data,
-     which may include nulls. */
+  /* Perform fwrite to mcd files or to a file descriptor. This is used
+     to write raw data, which may include nulls. */
 extern void vpip_mcd_rawwrite(PLI_UINT32 mcd, const char*buf, size_t count);
 
   /* Return driver information for a net bit. The information is returned
@@ -659,6 +678,25 @@ extern void vpip_mcd_rawwrite(PLI_UINT32 mcd, const char*buf, size_t count);
 extern void vpip_count_drivers(vpiHandle ref, unsigned idx,
                                unsigned counts[4]);
 
+  /* Freeze a copy of the running simulation as a fork server on the
+     socket file at path. Each "vvp -r path" command then runs a copy
+     of the simulation that continues from this point. This returns 0
+     in the simulation that started the server, 1 in each copy, and -1
+     if the server could not be started. */
+extern PLI_INT32 vpip_fork_server(const char*path);
+
+  /* Get the values of count objects into the vals array. The values
+     are packed one after the other, each as (vpiSize+31)/32 vector
+     words, and the return value is the total number of words. The
+     objects must be signals with vector values, and if one is not,
+     for example a real variable, the return value is -1. This is
+     much cheaper than calling vpi_get_value for each object, and is
+     meant for modules that sample many signals at each
+     cbReadOnlySynch. */
+extern PLI_INT32 vpip_get_vecval_multi(PLI_INT32 count,
+				       const vpiHandle*refs,
+				       s_vpi_vecval*vals);
+
 /*
  * Stopgap fix for br916. We need to reject any attempt to pass a thread
  * variable to $strobe or $monitor. To do this, we use some private VPI
@@ -688,7 +726,7 @@ extern void vpip_count_drivers(vpiHandle ref, unsigned idx,
  */
 
 // Increment the version number any time vpip_routines_s is changed.
-static const PLI_UINT32 vpip_routines_version = 1;
+static const PLI_UINT32 vpip_routines_version = 4;
 
 typedef struct {
     vpiHandle   (*register_cb)(p_cb_data);
@@ -729,6 +767,9 @@ typedef struct {
     void        (*make_systf_system_defined)(vpiHandle);
     void        (*mcd_rawwrite)(PLI_UINT32, const char*, size_t);
     void        (*set_return_value)(int);
+    PLI_INT32   (*fork_server)(const char*);
+    PLI_INT32   (*get_vecval_multi)(PLI_INT32, const vpiHandle*, s_vpi_vecval*);
+    int         (*get_return_value)(void);
 } vpip_routines_s;
 
 extern DLLEXPORT PLI_UINT32 vpip_set_callback(vpip_routines_s*routines, PLI_UINT32 version);
@@ -430,6 +430,16 @@ void vvp_arith_mult::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
 {
       dispatch_operand_(ptr, bit);
 
+	/* If the operands are already the width of the result, then
+	   the vector multiply does the work a word at a time, and
+	   makes the result all X if there are X or Z bits. */
+      if (op_a_.size() == wid_ && op_b_.size() == wid_) {
+	    vvp_vector4_t value (op_a_);
+	    value.mul(op_b_);
+	    ptr.ptr()->send_vec4(value, 0);
+	    return;
+      }
+
       if (wid_ > 8 * sizeof(int64_t)) {
 	    wide_(ptr);
 	    return ;
@@ -532,6 +542,16 @@ void vvp_arith_sum::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
 
       vvp_net_t*net = ptr.ptr();
 
+	/* If the operands are already the width of the result, then
+	   add a word at a time. The vector add makes the result all X
+	   if there are X or Z bits, just like the loop below. */
+      if (op_a_.size() == wid_ && op_b_.size() == wid_) {
+	    vvp_vector4_t value (op_a_);
+	    value.add(op_b_);
+	    net->send_vec4(value, 0);
+	    return;
+      }
+
       vvp_vector4_t value (wid_);
 
 	/* Pad input vectors with this value to widen to the desired
@@ -577,6 +597,15 @@ void vvp_arith_sub::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
 
       vvp_net_t*net = ptr.ptr();
 
+	/* If the operands are already the width of the result, then
+	   subtract a word at a time, as for vvp_arith_sum. */
+      if (op_a_.size() == wid_ && op_b_.size() == wid_) {
+	    vvp_vector4_t value (op_a_);
+	    value.sub(op_b_);
+	    net->send_vec4(value, 0);
+	    return;
+      }
+
       vvp_vector4_t value (wid_);
 
 	/* Pad input vectors with this value to widen to the desired
@@ -610,15 +639,8 @@ void vvp_cmp_eeq::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
 {
       dispatch_operand_(ptr, bit);
 
-      vvp_vector4_t eeq (1);
-      eeq.set_bit(0, BIT4_1);
-
       assert(op_a_.size() == op_b_.size());
-      for (unsigned idx = 0 ;  idx < op_a_.size() ;  idx += 1)
-	    if (op_a_.value(idx) != op_b_.value(idx)) {
-		  eeq.set_bit(0, BIT4_0);
-		  break;
-	    }
+      vvp_vector4_t eeq (1, op_a_.eeq(op_b_)? BIT4_1 : BIT4_0);
 
 
       vvp_net_t*net = ptr.ptr();
@@ -635,15 +657,8 @@ void vvp_cmp_nee::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
 {
       dispatch_operand_(ptr, bit);
 
-      vvp_vector4_t eeq (1);
-      eeq.set_bit(0, BIT4_0);
-
       assert(op_a_.size() == op_b_.size());
-      for (unsigned idx = 0 ;  idx < op_a_.size() ;  idx += 1)
-	    if (op_a_.value(idx) != op_b_.value(idx)) {
-		  eeq.set_bit(0, BIT4_1);
-		  break;
-	    }
+      vvp_vector4_t eeq (1, op_a_.eeq(op_b_)? BIT4_0 : BIT4_1);
 
 
       vvp_net_t*net = ptr.ptr();
@@ -672,6 +687,14 @@ void vvp_cmp_eq::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
 	    assert(0);
       }
 
+	/* Without X or Z bits, == is the same as ===, which compares
+	   a word at a time. */
+      if (! (op_a_.has_xz() || op_b_.has_xz())) {
+	    vvp_vector4_t res (1, op_a_.eeq(op_b_)? BIT4_1 : BIT4_0);
+	    ptr.ptr()->send_vec4(res, 0);
+	    return;
+      }
+
       vvp_vector4_t res (1);
       res.set_bit(0, BIT4_1);
 
@@ -797,6 +820,13 @@ void vvp_cmp_ne::recv_vec4(vvp_net_ptr_t ptr, const vvp_vector4_t&bit,
 	    assert(op_a_.size() == op_b_.size());
       }
 
+	/* Without X or Z bits, != is the same as !==. */
+      if (! (op_a_.has_xz() || op_b_.has_xz())) {
+	    vvp_vector4_t res (1, op_a_.eeq(op_b_)? BIT4_0 : BIT4_1);
+	    ptr.ptr()->send_vec4(res, 0);
+	    return;
+      }
+
       vvp_vector4_t res (1);
       res.set_bit(0, BIT4_0);
 
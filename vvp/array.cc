@@ -123,7 +123,7 @@ static bool vpi_array_is_real(const vvp_array_t arr)
       if (arr->vals4 != 0)  // A bit based variable/register array.
 	    return false;
 
-      if (dynamic_cast<vvp_darray_real*> (arr->vals))
+      if (dynamic_cast<vvp_darray_real_sparse*> (arr->vals))
 	    return true;
 
       if (arr->vals != 0)
@@ -261,9 +261,7 @@ vpiHandle __vpiArray::get_iter_index(struct __vpiArrayIterator*, int idx)
 
       assert(vals4 || vals);
 
-      if (vals_words == 0) make_vals_words();
-
-      return &(vals_words[idx].as_word);
+      return get_vals_word(idx);
 }
 
 int __vpiArray::vpi_get(int code)
@@ -329,10 +327,7 @@ vpiHandle __vpiArray::vpi_index(int index)
 	    return nets[index];
       }
 
-      if (vals_words == 0)
-	    make_vals_words();
-
-      return &(vals_words[index].as_word);
+      return get_vals_word(index);
 }
 
 int __vpiArrayWord::as_word_t::vpi_get(int code)
@@ -812,7 +807,6 @@ vpiHandle vpip_make_array(char*label, const char*name,
       obj->vals4 = 0;
       obj->vals  = 0;
       obj->vals_width = 0;
-      obj->vals_words = 0;
 
 	// Initialize (clear) the read-ports list.
       obj->ports_ = 0;
@@ -953,7 +947,7 @@ void compile_real_array(char*label, char*name, int last, int first)
       struct __vpiArray*arr = dynamic_cast<__vpiArray*>(obj);
 
 	/* Make the words. */
-      arr->vals = new vvp_darray_real(arr->get_size());
+      arr->vals = new vvp_darray_real_sparse(arr->get_size());
       arr->vals_width = 1;
 
       count_real_arrays += 1;
@@ -1545,7 +1539,6 @@ void compile_array_alias(char*label, char*name, char*src)
       obj->vals4 = mem->vals4;
       obj->vals  = mem->vals;
       obj->vals_width = mem->vals_width;
-      obj->vals_words = mem->vals_words;
 
       obj->ports_ = 0;
       obj->vpi_callbacks = 0;
@@ -1650,7 +1643,7 @@ void compile_array_cleanup(void)
 void memory_delete(vpiHandle item)
 {
       struct __vpiArray*arr = (struct __vpiArray*) item;
-      if (arr->vals_words) delete [] (arr->vals_words-1);
+      arr->delete_vals_words();
 
 //      if (arr->vals4) {}
 // Delete the individual words?
@@ -37,20 +37,29 @@ vpiHandle __vpiArrayBase::vpi_array_base_iterate(int code)
     return 0;
 }
 
-void __vpiArrayBase::make_vals_words()
+vpiHandle __vpiArrayBase::get_vals_word(unsigned idx)
 {
-    assert(vals_words == 0);
-    vals_words = new struct __vpiArrayWord[get_size() + 1];
+      unsigned pdx = idx / VALS_WORDS_PAGE;
+      if (pdx >= vals_words.size())
+	    vals_words.resize(pdx + 1, 0);
+
+      struct __vpiArrayWord*&page = vals_words[pdx];
+      if (page == 0) {
+	    page = new struct __vpiArrayWord[VALS_WORDS_PAGE];
+	    for (unsigned wdx = 0 ; wdx < VALS_WORDS_PAGE ; wdx += 1) {
+		  page[wdx].parent = this;
+		  page[wdx].index = pdx*VALS_WORDS_PAGE + wdx;
+	    }
+      }
 
-    // Make word[-1] point to the parent.
-    vals_words->parent = this;
-    // Now point to word-0
-    vals_words += 1;
+      return &(page[idx % VALS_WORDS_PAGE].as_word);
+}
 
-    struct __vpiArrayWord*words = vals_words;
-    for (unsigned idx = 0 ; idx < get_size() ; idx += 1) {
-            words[idx].word0 = words;
-    }
+void __vpiArrayBase::delete_vals_words()
+{
+      for (size_t pdx = 0 ; pdx < vals_words.size() ; pdx += 1)
+	    delete [] vals_words[pdx];
+      vals_words.clear();
 }
 
 vpiHandle __vpiArrayIterator::vpi_index(int)
@@ -53,14 +53,10 @@ struct __vpiArrayIndex : public __vpiHandle {
  * array word handle contains no actual data. It is just a hook for
  * the vpi methods and to point to the parent.
  *
- * How the point to the parent works is tricky. The vpiArrayWord
- * objects for an array are themselves allocated as an array. All the
- * ArrayWord objects in the array have a word0 that points to the base
- * of the array. Thus, the position into the array (and the index into
- * the memory) is calculated by subtracting word0 from the ArrayWord
- * pointer.
- *
- * To then get to the parent, use word0[-1].parent.
+ * The vpiArrayWord objects for an array are allocated in pages the
+ * first time a word in the page is asked for, so that a huge memory
+ * does not need a handle for every word. Each ArrayWord holds the
+ * parent and its index into the memory.
  *
  * The vpiArrayWord is also used as a handle for the index (vpiIndex)
  * for the word. To make that work, return the pointer to the as_index
@@ -83,13 +79,11 @@ struct __vpiArrayWord {
 	    void vpi_get_value(p_vpi_value val);
       } as_index;
 
-      union {
-	    struct __vpiArrayBase*parent;
-	    struct __vpiArrayWord*word0;
-      };
+      struct __vpiArrayBase*parent;
+      unsigned index;
 
-      inline unsigned get_index() const { return this - word0; }
-      inline struct __vpiArrayBase*get_parent() const { return (word0 - 1)->parent; }
+      inline unsigned get_index() const { return index; }
+      inline struct __vpiArrayBase*get_parent() const { return parent; }
 };
 
 struct __vpiArrayWord*array_var_word_from_handle(vpiHandle ref);
@@ -96,6 +96,59 @@ vvp_code_t codespace_null(void)
       return first_chunk + 0;
 }
 
+static bool dispatch_fused = true;
+
+bool codespace_select_dispatch(const char*name)
+{
+      if (strcmp(name, "fused") == 0) {
+	    dispatch_fused = true;
+	    return true;
+      }
+      if (strcmp(name, "call") == 0) {
+	    dispatch_fused = false;
+	    return true;
+      }
+      if (strcmp(name, "profile") == 0) {
+	    dispatch_fused = false;
+	    vthread_enable_profile();
+	    return true;
+      }
+      return false;
+}
+
+/*
+ * Scan the code space for adjacent pairs of opcodes that have a
+ * superinstruction, and replace the first opcode of the pair with
+ * it. The second instruction is left in place, so any jump that
+ * targets it still works. Pairs are not fused across the chunk link
+ * at the end of a chunk.
+ */
+void codespace_fuse(void)
+{
+      count_opcodes_fused = 0;
+      if (! dispatch_fused)
+	    return;
+
+      for (vvp_code_t chunk = first_chunk ; chunk ; chunk = chunk[code_chunk_size-1].cptr) {
+	    unsigned limit = code_chunk_size - 1;
+	    if (chunk == current_chunk)
+		  limit = current_within_chunk;
+
+	    for (unsigned idx = 0 ; idx+1 < limit ; idx += 1) {
+		  vvp_code_fun fused = vthread_fused_opcode(chunk[idx].opcode,
+							    chunk[idx+1].opcode);
+		  if (fused == 0)
+			continue;
+
+		  chunk[idx].opcode = fused;
+		  count_opcodes_fused += 1;
+	    }
+
+	    if (chunk == current_chunk)
+		  break;
+      }
+}
+
 #ifdef CHECK_WITH_VALGRIND
 void codespace_delete(void)
 {
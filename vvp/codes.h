@@ -278,6 +278,21 @@ extern bool of_REAP_UFUNC(vthread_t thr, vvp_code_t code);
 
 extern bool of_CHUNK_LINK(vthread_t thr, vvp_code_t code);
 
+/*
+ * Return the superinstruction that does the work of the opcode pair
+ * (first, second) in a single dispatch, or nil if there is none for
+ * that pair. The superinstructions live in vthread.cc with the rest
+ * of the opcode implementations.
+ */
+extern vvp_code_fun vthread_fused_opcode(vvp_code_fun first, vvp_code_fun second);
+
+/*
+ * Return the assembler mnemonic for an opcode function, or nil if
+ * the function is not an opcode that the assembler knows. The
+ * opcode table is in compile.cc.
+ */
+extern const char* compile_opcode_name(vvp_code_fun opcode);
+
 /*
  * This is the format of a machine code instruction.
  */
@@ -320,4 +335,21 @@ extern vvp_code_t codespace_allocate(void);
 extern vvp_code_t codespace_next(void);
 extern vvp_code_t codespace_null(void);
 
+/*
+ * Select the instruction dispatch engine by name. The "fused" engine
+ * (the default) replaces common adjacent opcode pairs with
+ * superinstructions, and the "call" engine runs every opcode through
+ * its own handler. The "profile" engine is like "call", but also
+ * counts the opcodes and code blocks that are executed. Return false
+ * if the name is not known.
+ */
+extern bool codespace_select_dispatch(const char*name);
+
+/*
+ * After the code is linked, rewrite the code space for the selected
+ * dispatch engine. This must be called after all the code labels
+ * have been resolved.
+ */
+extern void codespace_fuse(void);
+
 #endif /* IVL_codes_H */
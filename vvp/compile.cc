@@ -821,6 +821,14 @@ void compile_cleanup(void)
       compile_island_cleanup();
       compile_array_cleanup();
 
+	/* All the code labels are resolved now, so the opcodes can be
+	   rewritten for the dispatch engine. */
+      codespace_fuse();
+
+	/* The netlist is complete, so copy the fan-out of the nets
+	   into the flat lists that the simulation walks. */
+      vvp_net_flatten_fanout();
+
       if (verbose_flag) {
 	    fprintf(stderr, " ... Compiletf functions\n");
 	    fflush(stderr);
@@ -847,6 +855,23 @@ void compile_vpi_symbol(const char*label, vpiHandle obj)
       sym_set_value(sym_vpi, label, val);
 }
 
+const char* compile_opcode_name(vvp_code_fun opcode)
+{
+      for (unsigned idx = 0 ; idx < opcode_count ; idx += 1) {
+	    if (opcode_table[idx].opcode == opcode)
+		  return opcode_table[idx].mnemonic;
+      }
+
+	/* These opcodes have their own syntax, so are compiled
+	   without the opcode table. */
+      if (opcode == &of_FILE_LINE)
+	    return "%file_line";
+      if (opcode == &of_VPI_CALL)
+	    return "%vpi_call";
+
+      return 0;
+}
+
 /*
  * Initialize the compiler by allocation empty symbol tables and
  * initializing the various address spaces.
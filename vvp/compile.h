@@ -50,6 +50,13 @@ extern void compile_cleanup(void);
 
 extern bool verbose_flag;
 
+/*
+ * If this flag is set, then all the vector variables start out with
+ * zero bits like 2-state variables, instead of X bits. Designs that
+ * never drive X or Z bits then stay on the 2-state fast paths.
+ */
+extern bool two_state_flag;
+
 /*
  * If this file opened, then write debug information to this
  * file. This is used for debugging the VVP runtime itself.
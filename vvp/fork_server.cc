@@ -0,0 +1,655 @@
+/*
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "config.h"
+# include  "fork_server.h"
+# include  "vpi_priv.h"
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+# include  <string>
+# include  <vector>
+#ifndef __MINGW32__
+# include  <unistd.h>
+# include  <csignal>
+# include  <cerrno>
+# include  <ctime>
+# include  <fcntl.h>
+# include  <poll.h>
+# include  <sys/types.h>
+# include  <sys/socket.h>
+# include  <sys/un.h>
+# include  <sys/wait.h>
+#endif
+
+using namespace std;
+
+#ifndef __MINGW32__
+
+/*
+ * A run request is a header, which carries the standard files of the
+ * client as SCM_RIGHTS, followed by the strings of the request: the
+ * working directory and then the extended arguments. Each string is
+ * sent as a length and then the characters. The new copy of the
+ * simulation sends back its process id, and when it finishes, its
+ * exit code, both as 32bit ints. A header with no strings and no
+ * files asks the server to shut down, and is answered with a 0 exit
+ * code.
+ */
+static const uint32_t FORK_SERVER_MAGIC = 0x56565046; // "VVPF"
+
+struct fork_server_header_s {
+      uint32_t magic;
+      uint32_t nstrings;
+};
+
+  /* In a copy made by a fork server, this is the connection to the
+     client. */
+static int fork_server_client = -1;
+
+/*
+ * The server and the client both sleep in poll() until there is work
+ * to do. The signals that they handle write a byte into this pipe to
+ * wake the poll, so that a signal that comes just before the poll is
+ * not missed. The last of the stopping signals is kept in
+ * fork_server_signal.
+ */
+static int wake_pipe[2] = { -1, -1 };
+static volatile sig_atomic_t fork_server_signal = 0;
+
+extern "C" void fork_server_signal_handler(int signum)
+{
+      int save_errno = errno;
+      if (signum != SIGCHLD)
+	    fork_server_signal = signum;
+      ssize_t rc = write(wake_pipe[1], "", 1);
+      (void)rc;
+      errno = save_errno;
+}
+
+static bool open_wake_pipe_(void)
+{
+      if (pipe(wake_pipe) < 0)
+	    return false;
+      for (int idx = 0 ;  idx < 2 ;  idx += 1) {
+	    fcntl(wake_pipe[idx], F_SETFL, O_NONBLOCK);
+	    fcntl(wake_pipe[idx], F_SETFD, FD_CLOEXEC);
+      }
+      return true;
+}
+
+static void drain_wake_pipe_(void)
+{
+      char buf[64];
+      while (read(wake_pipe[0], buf, sizeof buf) > 0)
+	    ;
+}
+
+static void close_wake_pipe_(void)
+{
+      close(wake_pipe[0]);
+      close(wake_pipe[1]);
+      wake_pipe[0] = -1;
+      wake_pipe[1] = -1;
+}
+
+static bool write_all_(int fd, const void*buf, size_t cnt)
+{
+      const char*ptr = (const char*)buf;
+      while (cnt > 0) {
+	    ssize_t rc = write(fd, ptr, cnt);
+	    if (rc < 0 && errno == EINTR)
+		  continue;
+	    if (rc <= 0)
+		  return false;
+	    ptr += rc;
+	    cnt -= rc;
+      }
+      return true;
+}
+
+static bool read_all_(int fd, void*buf, size_t cnt)
+{
+      char*ptr = (char*)buf;
+      while (cnt > 0) {
+	    ssize_t rc = read(fd, ptr, cnt);
+	    if (rc < 0 && errno == EINTR)
+		  continue;
+	    if (rc <= 0)
+		  return false;
+	    ptr += rc;
+	    cnt -= rc;
+      }
+      return true;
+}
+
+static bool write_string_(int fd, const char*str)
+{
+      uint32_t len = strlen(str);
+      return write_all_(fd, &len, sizeof len) && write_all_(fd, str, len);
+}
+
+static bool read_string_(int fd, string&str)
+{
+      uint32_t len;
+      if (! read_all_(fd, &len, sizeof len))
+	    return false;
+
+      str.resize(len);
+      return len == 0 || read_all_(fd, &str[0], len);
+}
+
+/*
+ * Read the header of a request from the client on the connection,
+ * with the standard files of the client if it carries any. This is
+ * done by the server, so that it can tell a run request from a
+ * request to shut down. Return false if the header is broken.
+ */
+static bool read_header_(int conn, struct fork_server_header_s&head, int fds[3])
+{
+      char cbuf[CMSG_SPACE(3 * sizeof(int))];
+
+      struct iovec iov;
+      iov.iov_base = &head;
+      iov.iov_len = sizeof head;
+
+      struct msghdr msg;
+      memset(&msg, 0, sizeof msg);
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = cbuf;
+      msg.msg_controllen = sizeof cbuf;
+
+      if (recvmsg(conn, &msg, 0) != (ssize_t)sizeof head)
+	    return false;
+      if (head.magic != FORK_SERVER_MAGIC)
+	    return false;
+
+	/* A shut down request carries no strings and no files. */
+      if (head.nstrings == 0)
+	    return true;
+
+      struct cmsghdr*cmsg = CMSG_FIRSTHDR(&msg);
+      if (cmsg == 0 || cmsg->cmsg_type != SCM_RIGHTS
+	  || cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+	    return false;
+      memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+      return true;
+}
+
+/*
+ * Take a run request from the client on the connection. This is
+ * called in the new copy of the simulation, which replaces its
+ * standard files, working directory and extended arguments with those
+ * of the client. The copy then tells the client its process id, so
+ * that the client can forward signals to it. Return false if the
+ * request is broken.
+ */
+static bool take_request_(int conn, const struct fork_server_header_s&head,
+			  const int fds[3])
+{
+      extern void vpi_set_vlog_info(int, char**);
+
+      vector<string> strings (head.nstrings);
+      for (unsigned idx = 0 ;  idx < head.nstrings ;  idx += 1) {
+	    if (! read_string_(conn, strings[idx]))
+		  return false;
+      }
+
+      for (int fd = 0 ;  fd < 3 ;  fd += 1) {
+	    dup2(fds[fd], fd);
+	    close(fds[fd]);
+      }
+
+      if (chdir(strings[0].c_str()) < 0)
+	    perror(strings[0].c_str());
+
+	/* Keep the design file name as the first extended argument,
+	   and replace the rest with the arguments of the client. */
+      s_vpi_vlog_info info;
+      vpi_get_vlog_info(&info);
+      char**argv = new char*[head.nstrings];
+      argv[0] = info.argv[0];
+      for (unsigned idx = 1 ;  idx < head.nstrings ;  idx += 1)
+	    argv[idx] = strdup(strings[idx].c_str());
+      vpi_set_vlog_info(head.nstrings, argv);
+
+      int32_t pid = getpid();
+      if (! write_all_(conn, &pid, sizeof pid))
+	    return false;
+
+      fork_server_client = conn;
+      return true;
+}
+
+/*
+ * The server keeps the connection of each running copy, so that it
+ * can stop the copy if the client goes away before the copy is done.
+ * A copy that does not finish within FORK_SERVER_KILL_DELAY seconds
+ * of the SIGTERM is killed.
+ */
+static const time_t FORK_SERVER_KILL_DELAY = 5;
+
+struct fork_server_copy_s {
+      pid_t pid;
+      int conn;
+      time_t term_time;
+      bool killed;
+};
+
+/*
+ * This is the loop of the frozen copy of the simulation. It never
+ * returns in the server, and returns 1 in each new copy that it makes
+ * for a client. The server stays in the process group of the
+ * simulation that started it, so it is stopped along with that
+ * simulation by the signals of the terminal. Otherwise it sleeps until
+ * a client connects, a copy finishes or its client hangs up, and runs
+ * until it gets a signal or a client asks it to shut down.
+ */
+static PLI_INT32 serve_(int sock, const char*path)
+{
+      if (! open_wake_pipe_())
+	    _exit(1);
+
+	/* The simulation catches these signals to stop or finish the
+	   simulation, but the server is not simulating, so let them
+	   shut it down. The copies get the handlers back. */
+      struct sigaction act, sig_int, sig_term, sig_hup, sig_chld;
+      memset(&act, 0, sizeof act);
+      act.sa_handler = &fork_server_signal_handler;
+      sigemptyset(&act.sa_mask);
+      sigaction(SIGINT,  &act, &sig_int);
+      sigaction(SIGTERM, &act, &sig_term);
+      sigaction(SIGHUP,  &act, &sig_hup);
+      act.sa_flags = SA_NOCLDSTOP;
+      sigaction(SIGCHLD, &act, &sig_chld);
+
+      vector<fork_server_copy_s> copies;
+      bool shutdown_flag = false;
+
+      while (! shutdown_flag || ! copies.empty()) {
+	      /* Reap the copies that have finished. The connection is
+		 held open until then, so a client whose copy died
+		 without reporting an exit code sees the end of file. */
+	    pid_t pid;
+	    while ((pid = waitpid(-1, 0, WNOHANG)) > 0) {
+		  for (size_t idx = 0 ;  idx < copies.size() ;  idx += 1) {
+			if (copies[idx].pid != pid)
+			      continue;
+			close(copies[idx].conn);
+			copies[idx] = copies.back();
+			copies.pop_back();
+			break;
+		  }
+	    }
+
+	    if (! shutdown_flag && fork_server_signal != 0) {
+		  unlink(path);
+		  _exit(0);
+	    }
+
+	      /* Kill the copies that were stopped and did not finish
+		 in time. Sleep no longer than the next of those is due,
+		 or for as long as it takes if there are none. */
+	    time_t now = time(0);
+	    int timeout = -1;
+	    vector<struct pollfd> pfd (copies.size() + 2);
+	    for (size_t idx = 0 ;  idx < copies.size() ;  idx += 1) {
+		  fork_server_copy_s&cur = copies[idx];
+		  if (cur.term_time != 0 && ! cur.killed) {
+			time_t left = cur.term_time + FORK_SERVER_KILL_DELAY - now;
+			if (left <= 0) {
+			      kill(cur.pid, SIGKILL);
+			      cur.killed = true;
+			} else if (timeout < 0 || left*1000 < timeout) {
+			      timeout = left * 1000;
+			}
+		  }
+		  pfd[idx].fd = cur.term_time? -1 : cur.conn;
+		  pfd[idx].events = 0;
+	    }
+	    pfd[copies.size()].fd = shutdown_flag? -1 : sock;
+	    pfd[copies.size()].events = POLLIN;
+	    pfd[copies.size()+1].fd = wake_pipe[0];
+	    pfd[copies.size()+1].events = POLLIN;
+
+	    int rc = poll(&pfd[0], pfd.size(), timeout);
+	    if (rc <= 0)
+		  continue;
+
+	    if (pfd[copies.size()+1].revents & POLLIN)
+		  drain_wake_pipe_();
+
+	      /* A client that hangs up before its copy is done leaves
+		 nobody to report to, so stop the copy. */
+	    for (size_t idx = 0 ;  idx < copies.size() ;  idx += 1) {
+		  if ((pfd[idx].revents & (POLLHUP|POLLERR)) == 0)
+			continue;
+		  kill(copies[idx].pid, SIGTERM);
+		  copies[idx].term_time = now;
+	    }
+
+	    if ((pfd[copies.size()].revents & POLLIN) == 0)
+		  continue;
+
+	    int conn = accept(sock, 0, 0);
+	    if (conn < 0)
+		  continue;
+
+	    struct fork_server_header_s head;
+	    int fds[3];
+	    if (! read_header_(conn, head, fds)) {
+		  close(conn);
+		  continue;
+	    }
+
+	      /* A request to shut down removes the socket file, so
+		 that no new clients connect, and then waits for the
+		 running copies to finish. */
+	    if (head.nstrings == 0) {
+		  int32_t code = 0;
+		  unlink(path);
+		  close(sock);
+		  shutdown_flag = true;
+		  write_all_(conn, &code, sizeof code);
+		  close(conn);
+		  continue;
+	    }
+
+	    pid = fork();
+	    if (pid == 0) {
+		  close(sock);
+		  close_wake_pipe_();
+		  for (size_t idx = 0 ;  idx < copies.size() ;  idx += 1)
+			close(copies[idx].conn);
+		  sigaction(SIGINT,  &sig_int,  0);
+		  sigaction(SIGTERM, &sig_term, 0);
+		  sigaction(SIGHUP,  &sig_hup,  0);
+		  sigaction(SIGCHLD, &sig_chld, 0);
+		  if (take_request_(conn, head, fds))
+			return 1;
+		  _exit(1);
+	    }
+
+	    for (int fd = 0 ;  fd < 3 ;  fd += 1)
+		  close(fds[fd]);
+
+	    if (pid < 0) {
+		  close(conn);
+		  continue;
+	    }
+
+	    fork_server_copy_s cur;
+	    cur.pid = pid;
+	    cur.conn = conn;
+	    cur.term_time = 0;
+	    cur.killed = false;
+	    copies.push_back(cur);
+      }
+
+      _exit(0);
+}
+
+extern "C" PLI_INT32 vpip_fork_server(const char*path)
+{
+      struct sockaddr_un addr;
+      if (strlen(path) >= sizeof addr.sun_path) {
+	    fprintf(stderr, "%s: fork server file name is too long.\n", path);
+	    return -1;
+      }
+
+      memset(&addr, 0, sizeof addr);
+      addr.sun_family = AF_UNIX;
+      strcpy(addr.sun_path, path);
+
+      int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (sock < 0) {
+	    perror(path);
+	    return -1;
+      }
+
+      unlink(path);
+      if (bind(sock, (struct sockaddr*)&addr, sizeof addr) < 0
+	  || listen(sock, 16) < 0) {
+	    perror(path);
+	    close(sock);
+	    return -1;
+      }
+
+	/* Flush the output files, or the copies would write out the
+	   buffered output a second time. This also stops the writer
+	   thread, which the fork would not copy. */
+      vpip_mcd_sync();
+      fflush(0);
+
+      pid_t pid = fork();
+      if (pid < 0) {
+	    perror("fork");
+	    close(sock);
+	    unlink(path);
+	    return -1;
+      }
+
+	/* The server is forked from a short lived child, so that it is
+	   not left as a zombie of this simulation when it exits. It is
+	   still in the process group of this simulation. */
+      if (pid > 0) {
+	    int status;
+	    close(sock);
+	    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+		  ;
+	    if (! WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		  fprintf(stderr, "%s: unable to start the fork server.\n", path);
+		  unlink(path);
+		  return -1;
+	    }
+	    return 0;
+      }
+
+      pid = fork();
+      if (pid != 0)
+	    _exit(pid < 0? 1 : 0);
+
+      return serve_(sock, path);
+}
+
+static int connect_server_(const char*path)
+{
+      struct sockaddr_un addr;
+      if (strlen(path) >= sizeof addr.sun_path) {
+	    fprintf(stderr, "%s: fork server file name is too long.\n", path);
+	    return -1;
+      }
+
+      memset(&addr, 0, sizeof addr);
+      addr.sun_family = AF_UNIX;
+      strcpy(addr.sun_path, path);
+
+      int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (sock < 0 || connect(sock, (struct sockaddr*)&addr, sizeof addr) < 0) {
+	    perror(path);
+	    if (sock >= 0)
+		  close(sock);
+	    return -1;
+      }
+
+      return sock;
+}
+
+int fork_server_run(const char*path, int argc, char*argv[])
+{
+      int sock = connect_server_(path);
+      if (sock < 0)
+	    return 1;
+
+      struct fork_server_header_s head;
+      head.magic = FORK_SERVER_MAGIC;
+      head.nstrings = argc + 1;
+
+      int fds[3] = { 0, 1, 2 };
+      char cbuf[CMSG_SPACE(sizeof fds)];
+      memset(cbuf, 0, sizeof cbuf);
+
+      struct iovec iov;
+      iov.iov_base = &head;
+      iov.iov_len = sizeof head;
+
+      struct msghdr msg;
+      memset(&msg, 0, sizeof msg);
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = cbuf;
+      msg.msg_controllen = sizeof cbuf;
+
+      struct cmsghdr*cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof fds);
+      memcpy(CMSG_DATA(cmsg), fds, sizeof fds);
+
+      fflush(0);
+
+      bool ok = sendmsg(sock, &msg, 0) == (ssize_t)sizeof head;
+
+      char*cwd = getcwd(0, 0);
+      ok = ok && write_string_(sock, cwd? cwd : ".");
+      free(cwd);
+      for (int idx = 0 ;  ok && idx < argc ;  idx += 1)
+	    ok = write_string_(sock, argv[idx]);
+
+      int32_t pid;
+      if (! ok || ! read_all_(sock, &pid, sizeof pid)) {
+	    fprintf(stderr, "%s: unable to send the run request.\n", path);
+	    close(sock);
+	    return 1;
+      }
+
+	/* Wait for the exit code of the copy. An interrupt or a
+	   termination signal is passed on to the copy, which handles
+	   it as the simulation would have. If this process goes away
+	   first, the server stops the copy. */
+      if (! open_wake_pipe_()) {
+	    perror("pipe");
+	    close(sock);
+	    return 1;
+      }
+
+      struct sigaction act, old_int, old_term, old_hup;
+      memset(&act, 0, sizeof act);
+      act.sa_handler = &fork_server_signal_handler;
+      sigemptyset(&act.sa_mask);
+      sigaction(SIGINT,  &act, &old_int);
+      sigaction(SIGTERM, &act, &old_term);
+      sigaction(SIGHUP,  &act, &old_hup);
+
+      for (;;) {
+	    if (fork_server_signal != 0) {
+		  kill(pid, fork_server_signal);
+		  fork_server_signal = 0;
+	    }
+
+	    struct pollfd pfd[2];
+	    pfd[0].fd = sock;
+	    pfd[0].events = POLLIN;
+	    pfd[1].fd = wake_pipe[0];
+	    pfd[1].events = POLLIN;
+	    int prc = poll(pfd, 2, -1);
+	    if (prc < 0 && errno == EINTR)
+		  continue;
+	    if (prc > 0 && pfd[1].revents & POLLIN)
+		  drain_wake_pipe_();
+	    if (prc < 0 || pfd[0].revents != 0)
+		  break;
+      }
+
+      int32_t rc;
+      if (! read_all_(sock, &rc, sizeof rc)) {
+	    fprintf(stderr, "%s: the copy of the simulation did not finish.\n",
+		    path);
+	    rc = 1;
+      }
+
+      sigaction(SIGINT,  &old_int,  0);
+      sigaction(SIGTERM, &old_term, 0);
+      sigaction(SIGHUP,  &old_hup,  0);
+      close_wake_pipe_();
+
+      close(sock);
+      return rc;
+}
+
+int fork_server_shutdown(const char*path)
+{
+      int sock = connect_server_(path);
+      if (sock < 0)
+	    return 1;
+
+      struct fork_server_header_s head;
+      head.magic = FORK_SERVER_MAGIC;
+      head.nstrings = 0;
+
+      int32_t rc;
+      if (! write_all_(sock, &head, sizeof head)
+	  || ! read_all_(sock, &rc, sizeof rc)) {
+	    fprintf(stderr, "%s: the fork server did not shut down.\n", path);
+	    rc = 1;
+      }
+
+      close(sock);
+      return rc;
+}
+
+void fork_server_report_exit(int rc)
+{
+      if (fork_server_client < 0)
+	    return;
+
+      int32_t code = rc;
+      fflush(0);
+      write_all_(fork_server_client, &code, sizeof code);
+      close(fork_server_client);
+      fork_server_client = -1;
+}
+
+#else
+
+extern "C" PLI_INT32 vpip_fork_server(const char*path)
+{
+      fprintf(stderr, "%s: fork servers are not supported on this system.\n",
+	      path);
+      return -1;
+}
+
+int fork_server_run(const char*path, int, char*[])
+{
+      fprintf(stderr, "%s: fork servers are not supported on this system.\n",
+	      path);
+      return 1;
+}
+
+int fork_server_shutdown(const char*path)
+{
+      fprintf(stderr, "%s: fork servers are not supported on this system.\n",
+	      path);
+      return 1;
+}
+
+void fork_server_report_exit(int)
+{
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef IVL_fork_server_H
+#define IVL_fork_server_H
+/*
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * A fork server is a frozen copy of a running simulation. The
+ * $fork_server system task forks the vvp process, and the copy waits
+ * on a socket file. Each "vvp -r <file> [+args...]" that connects to
+ * the file gets a fresh copy of the frozen simulation, which takes
+ * over the standard files, the plusargs and the working directory of
+ * the connecting process, and continues the simulation from the
+ * $fork_server call.
+ *
+ * This is not a checkpoint in the sense of the IEEE $save and
+ * $restart tasks. Nothing of the simulation is written to the file,
+ * so the server only lives as long as its process, and only serves
+ * clients on the same machine.
+ *
+ * The server stays in the process group of the simulation that
+ * started it. It sleeps until a client connects, and lives until it
+ * is shut down with "vvp -R <file>" or stopped by a signal. The
+ * client passes SIGINT, SIGTERM and SIGHUP on to its copy, and the
+ * copy is stopped if the client goes away.
+ */
+
+/*
+ * Connect to the fork server at path and run a copy of it with the
+ * given extended arguments. Return the exit code of the copy.
+ */
+extern int fork_server_run(const char*path, int argc, char*argv[]);
+
+/*
+ * Ask the fork server at path to shut down. It stops taking clients
+ * at once, and exits when the copies that are running finish. Return
+ * the exit code for vvp.
+ */
+extern int fork_server_shutdown(const char*path);
+
+/*
+ * If this process is a copy made by a fork server, tell the client
+ * the exit code. Otherwise, do nothing.
+ */
+extern void fork_server_report_exit(int rc);
+
+#endif /* IVL_fork_server_H */
@@ -240,11 +240,22 @@ inline vvp_vector8_t resolve_ambiguous(const vvp_vector8_t&a,
                                        unsigned str_map[8])
 {
       assert(a.size() == b.size());
-      vvp_vector8_t out (a.size());
-
-      for (unsigned idx = 0 ;  idx < out.size() ;  idx += 1) {
-	    vvp_scalar_t a_bit = a.value(idx);
+      vvp_vector8_t tmp (b.size());
+
+	// First map the strengths of b through the switch. The bits
+	// of a vector usually share a few distinct values, so
+	// remember the last mapping and skip the work when the next
+	// bit has the same value.
+      vvp_scalar_t last_in, last_out;
+      bool have_last = false;
+      for (unsigned idx = 0 ;  idx < tmp.size() ;  idx += 1) {
 	    vvp_scalar_t b_bit = b.value(idx);
+	    if (have_last && b_bit.eeq(last_in)) {
+		  tmp.set_bit(idx, last_out);
+		  continue;
+	    }
+
+	    last_in = b_bit;
             b_bit = vvp_scalar_t(b_bit.value(),
                                  str_map[b_bit.strength0()],
                                  str_map[b_bit.strength1()]);
@@ -260,9 +271,14 @@ inline vvp_vector8_t resolve_ambiguous(const vvp_vector8_t&a,
 			break;
 		  }
 	    }
-	    out.set_bit(idx, resolve(a_bit, b_bit));
+	    last_out = b_bit;
+	    have_last = true;
+	    tmp.set_bit(idx, b_bit);
       }
-      return out;
+
+	// Then resolve the mapped value with a, which works on
+	// groups of bits at a time.
+      return resolve(a, tmp);
 }
 
 static void push_value_through_branches(const vvp_vector8_t&val,
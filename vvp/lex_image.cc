@@ -0,0 +1,404 @@
+/*
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "version_base.h"
+# include  "version_tag.h"
+# include  "config.h"
+# include  "lex_image.h"
+# include  "parse_misc.h"
+# include  "compile.h"
+# include  "parse.h"
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+# include  <cassert>
+# include  <string>
+# include  <map>
+# include  <sys/types.h>
+# include  <sys/stat.h>
+# include  <fcntl.h>
+#ifndef __MINGW32__
+# include  <unistd.h>
+# include  <sys/mman.h>
+#endif
+# include  "ivl_alloc.h"
+
+using namespace std;
+
+/*
+ * The image is a header, then the token code, then a table of the
+ * null terminated strings that the code refers to by offset. Each
+ * string is in the table once. The code is a stream of unsigned
+ * numbers, each written 7 bits at a time, low bits first, with the
+ * top bit set in all but the last byte. A token is its number, then
+ * the number of lines since the last token, then, for a T_NUMBER, its
+ * value, for a T_VECTOR, its width and the offset of its text, or for
+ * the other tokens with text, the offset of the text. The version
+ * string is that of the vvp that wrote the image, and the numbers of
+ * the header are in the byte order of the host.
+ */
+static const char LEX_IMAGE_MAGIC[8] = { 'V','V','P','L','E','X','\n','\0' };
+
+struct lex_image_header_s {
+      char magic[8];
+      char version[64];
+	// Offset in the string table of the name of the source file.
+      uint64_t source;
+      uint64_t code_size;
+      uint64_t strtab_size;
+};
+
+static const char*image_version(void)
+{
+      return VERSION " (" VERSION_TAG ")";
+}
+
+static bool token_has_text(int token)
+{
+      switch (token) {
+	  case T_INSTR:
+	  case T_LABEL:
+	  case T_STRING:
+	  case T_SYMBOL:
+	  case T_VECTOR:
+	    return true;
+	  default:
+	    return false;
+      }
+}
+
+/*
+ * The image that is being read.
+ */
+static const char*in_base = 0;
+static size_t in_size = 0;
+static bool in_mapped = false;
+static const unsigned char*in_code = 0;
+static const unsigned char*in_code_end = 0;
+static const char*in_strtab = 0;
+static uint64_t in_strtab_size = 0;
+static string in_source;
+
+/*
+ * The image that is being written. The code is written as the lexor
+ * returns the tokens, and the header and string table are written
+ * when the parse is done.
+ */
+static FILE*out_file = 0;
+static string out_path;
+static string out_strtab;
+static map<string,uint64_t> out_strings;
+static uint64_t out_code_size = 0;
+static uint64_t out_source = 0;
+static unsigned out_line = 0;
+
+static uint64_t add_string(const char*text)
+{
+      pair<map<string,uint64_t>::iterator,bool> res
+	    = out_strings.insert(make_pair(string(text), (uint64_t)out_strtab.size()));
+      if (res.second) {
+	    out_strtab.append(text);
+	    out_strtab.push_back(0);
+      }
+      return res.first->second;
+}
+
+static void put_number(uint64_t val)
+{
+      while (val >= 0x80) {
+	    putc((int)(val & 0x7f) | 0x80, out_file);
+	    val >>= 7;
+	    out_code_size += 1;
+      }
+      putc((int)val, out_file);
+      out_code_size += 1;
+}
+
+static void write_token(int token)
+{
+      put_number(token);
+      put_number(yyline - out_line);
+      out_line = yyline;
+
+      switch (token) {
+	  case T_NUMBER:
+	    put_number(yylval.numb);
+	    break;
+	  case T_VECTOR:
+	    put_number(yylval.vect.idx);
+	    put_number(add_string(yylval.vect.text));
+	    break;
+	  default:
+	    if (token_has_text(token))
+		  put_number(add_string(yylval.text));
+	    break;
+      }
+}
+
+static bool get_number(uint64_t&val)
+{
+      val = 0;
+      for (unsigned shift = 0 ; shift < 64 ; shift += 7) {
+	    if (in_code == in_code_end)
+		  return false;
+	    unsigned char byte = *in_code++;
+	    val |= (uint64_t)(byte & 0x7f) << shift;
+	    if ((byte & 0x80) == 0)
+		  return true;
+      }
+      return false;
+}
+
+static const char*get_text(void)
+{
+      uint64_t off;
+      if (! get_number(off) || off >= in_strtab_size)
+	    return 0;
+      return in_strtab + off;
+}
+
+/*
+ * Give the parser a copy of a string in the image. The parser frees
+ * the text of the tokens the way the lexor allocates it: the text of
+ * a T_STRING with delete[] and all the others with free().
+ */
+static int read_token(void)
+{
+      if (in_code == in_code_end)
+	    return 0;
+
+      uint64_t token, lines;
+      if (! get_number(token) || ! get_number(lines))
+	    goto corrupt;
+      yyline += lines;
+
+      if (token == T_NUMBER) {
+	    if (! get_number(yylval.numb))
+		  goto corrupt;
+	    return (int)token;
+      }
+
+      if (token == T_VECTOR) {
+	    uint64_t idx;
+	    if (! get_number(idx))
+		  goto corrupt;
+	    const char*text = get_text();
+	    if (text == 0)
+		  goto corrupt;
+	    yylval.vect.idx = idx;
+	    yylval.vect.text = strdup(text);
+	    assert(yylval.vect.text);
+	    return (int)token;
+      }
+
+      if (token_has_text(token)) {
+	    const char*text = get_text();
+	    if (text == 0)
+		  goto corrupt;
+	    if (token == T_STRING) {
+		  yylval.text = strcpy(new char [strlen(text)+1], text);
+	    } else {
+		  yylval.text = strdup(text);
+		  assert(yylval.text);
+	    }
+      }
+      return (int)token;
+
+ corrupt:
+      yyerror("corrupt lex image");
+      in_code = in_code_end;
+      return 0;
+}
+
+int lex_image_lex(void)
+{
+      if (in_base)
+	    return read_token();
+
+      int token = yylex();
+      if (out_file && token != 0)
+	    write_token(token);
+      return token;
+}
+
+static void unmap_image(void)
+{
+#ifndef __MINGW32__
+      if (in_mapped)
+	    munmap(const_cast<char*>(in_base), in_size);
+      else
+#endif
+	    free(const_cast<char*>(in_base));
+      in_base = 0;
+      in_size = 0;
+      in_mapped = false;
+}
+
+/*
+ * Map the file if it can be mapped, and otherwise read it into
+ * memory. Only a file that starts with the image magic is kept.
+ */
+static int load_image(const char*path)
+{
+      int fd = open(path, O_RDONLY);
+      if (fd < 0)
+	    return 0;
+
+      struct stat sb;
+      if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(lex_image_header_s)) {
+	    close(fd);
+	    return 0;
+      }
+
+      char magic[sizeof LEX_IMAGE_MAGIC];
+      if (read(fd, magic, sizeof magic) != (ssize_t)sizeof magic
+	  || memcmp(magic, LEX_IMAGE_MAGIC, sizeof magic) != 0) {
+	    close(fd);
+	    return 0;
+      }
+
+      in_size = sb.st_size;
+#ifndef __MINGW32__
+      void*map = mmap(0, in_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map != MAP_FAILED) {
+	    in_base = (const char*)map;
+	    in_mapped = true;
+	    close(fd);
+	    return 1;
+      }
+#endif
+      char*buf = (char*)malloc(in_size);
+      size_t got = 0;
+      if (lseek(fd, 0, SEEK_SET) == 0) {
+	    ssize_t rc;
+	    while (got < in_size && (rc = read(fd, buf+got, in_size-got)) > 0)
+		  got += rc;
+      }
+      close(fd);
+      in_base = buf;
+      if (got != in_size) {
+	    fprintf(stderr, "%s: Unable to read lex image.\n", path);
+	    unmap_image();
+	    return -1;
+      }
+      return 1;
+}
+
+int lex_image_open(const char*path)
+{
+      int rc = load_image(path);
+      if (rc <= 0)
+	    return rc;
+
+      lex_image_header_s hdr;
+      memcpy(&hdr, in_base, sizeof hdr);
+
+      if (strncmp(hdr.version, image_version(), sizeof hdr.version) != 0) {
+	    fprintf(stderr, "%s: This lex image was written by vvp %.*s, "
+		    "and can only be read by that version.\n", path,
+		    (int)sizeof hdr.version, hdr.version);
+	    unmap_image();
+	    return -1;
+      }
+
+      if (hdr.code_size > in_size - sizeof hdr
+	  || sizeof hdr + hdr.code_size + hdr.strtab_size != in_size
+	  || hdr.strtab_size == 0
+	  || hdr.source >= hdr.strtab_size
+	  || in_base[in_size-1] != 0) {
+	    fprintf(stderr, "%s: Corrupt lex image.\n", path);
+	    unmap_image();
+	    return -1;
+      }
+
+      in_code = (const unsigned char*)in_base + sizeof hdr;
+      in_code_end = in_code + hdr.code_size;
+      in_strtab = in_base + sizeof hdr + hdr.code_size;
+      in_strtab_size = hdr.strtab_size;
+      in_source = in_strtab + hdr.source;
+      yypath = in_source.c_str();
+      return 1;
+}
+
+void lex_image_close(void)
+{
+      if (in_base)
+	    unmap_image();
+      in_code = 0;
+      in_code_end = 0;
+      in_strtab = 0;
+}
+
+bool lex_image_write_start(const char*path, const char*source)
+{
+      out_file = fopen(path, "wb");
+      if (out_file == 0) {
+	    fprintf(stderr, "%s: Unable to open lex image for writing.\n", path);
+	    return false;
+      }
+
+      out_path = path;
+      out_strtab.clear();
+      out_strings.clear();
+      out_code_size = 0;
+      out_line = 1;
+      out_source = add_string(source);
+
+	/* Leave room for the header, which is written at the end. */
+      lex_image_header_s hdr;
+      memset(&hdr, 0, sizeof hdr);
+      fwrite(&hdr, sizeof hdr, 1, out_file);
+      return true;
+}
+
+bool lex_image_write_finish(bool keep)
+{
+      if (out_file == 0)
+	    return false;
+
+      if (! keep) {
+	    fclose(out_file);
+	    out_file = 0;
+	    out_strtab.clear();
+	    remove(out_path.c_str());
+	    return true;
+      }
+
+      lex_image_header_s hdr;
+      memset(&hdr, 0, sizeof hdr);
+      memcpy(hdr.magic, LEX_IMAGE_MAGIC, sizeof hdr.magic);
+      strncpy(hdr.version, image_version(), sizeof hdr.version - 1);
+      hdr.source = out_source;
+      hdr.code_size = out_code_size;
+      hdr.strtab_size = out_strtab.size();
+
+      fwrite(out_strtab.data(), 1, out_strtab.size(), out_file);
+      bool ok = fseek(out_file, 0, SEEK_SET) == 0
+	    && fwrite(&hdr, sizeof hdr, 1, out_file) == 1
+	    && ! ferror(out_file);
+      if (fclose(out_file) != 0)
+	    ok = false;
+      out_file = 0;
+      out_strtab.clear();
+      out_strings.clear();
+
+      if (! ok) {
+	    fprintf(stderr, "%s: Unable to write lex image.\n", out_path.c_str());
+	    remove(out_path.c_str());
+      }
+      return ok;
+}
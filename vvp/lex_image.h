@@ -0,0 +1,57 @@
+#ifndef IVL_lex_image_H
+#define IVL_lex_image_H
+/*
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * A lex image is the token stream of a vvp input file, written in a
+ * binary form that vvp can map into memory and pass to the parser
+ * without running the lexor again. "vvp -o <image> <file>" writes the
+ * image of the file, and vvp runs an image the same way it runs the
+ * text file. Each token carries its line in the text file, so errors
+ * in an image refer to the original source.
+ *
+ * The image holds the token numbers of the parser that wrote it, so
+ * it can only be read by the same vvp build.
+ */
+
+/*
+ * The parser gets its tokens from here. This reads the image if one
+ * is open, and otherwise calls the lexor and, if an image is being
+ * written, adds the token to the image.
+ */
+extern int lex_image_lex(void);
+
+/*
+ * Open the file at path as an image. Return 1 if it is an image and
+ * it is ready to be read, 0 if it is not an image, or -1 if it is an
+ * image that this vvp can not read. This sets yypath to the name of
+ * the original source.
+ */
+extern int lex_image_open(const char*path);
+extern void lex_image_close(void);
+
+/*
+ * Start writing the tokens that the lexor returns to an image at
+ * path, and finish the image once the parse is done. If keep is
+ * false, the parse failed and the image is removed. Both return false
+ * and print a message if the file can not be written.
+ */
+extern bool lex_image_write_start(const char*path, const char*source);
+extern bool lex_image_write_finish(bool keep);
+
+#endif /* IVL_lex_image_H */
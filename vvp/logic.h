@@ -38,6 +38,8 @@ class vvp_fun_boolean_ : public vvp_net_fun_t, protected vvp_gen_event_s {
 			unsigned base, unsigned wid, unsigned vwid,
                         vvp_context_t);
 
+      vvp_gen_event_s* levelize_event() { return this; }
+
     protected:
       vvp_vector4_t input_[4];
       vvp_net_t*net_;
@@ -92,6 +94,8 @@ class vvp_fun_buf: public vvp_net_fun_t, private vvp_gen_event_s {
 			unsigned base, unsigned wid, unsigned vwid,
                         vvp_context_t);
 
+      vvp_gen_event_s* levelize_event() { return this; }
+
     private:
       void run_run();
 
@@ -158,6 +162,8 @@ class vvp_fun_muxz : public vvp_net_fun_t, private vvp_gen_event_s {
 			unsigned base, unsigned wid, unsigned vwid,
                         vvp_context_t);
 
+      vvp_gen_event_s* levelize_event() { return this; }
+
     private:
       void run_run();
 
@@ -180,6 +186,8 @@ class vvp_fun_muxr : public vvp_net_fun_t, private vvp_gen_event_s {
       void recv_real(vvp_net_ptr_t p, double bit,
                      vvp_context_t);
 
+      vvp_gen_event_s* levelize_event() { return this; }
+
     private:
       void run_run();
 
@@ -202,6 +210,8 @@ class vvp_fun_not: public vvp_net_fun_t, private vvp_gen_event_s {
 			unsigned base, unsigned wid, unsigned vwid,
                         vvp_context_t);
 
+      vvp_gen_event_s* levelize_event() { return this; }
+
     private:
       void run_run();
 
@@ -23,6 +23,9 @@
 # include  "parse_misc.h"
 # include  "compile.h"
 # include  "schedule.h"
+# include  "codes.h"
+# include  "fork_server.h"
+# include  "lex_image.h"
 # include  "vpi_priv.h"
 # include  "statistics.h"
 # include  "vvp_cleanup.h"
@@ -57,7 +60,10 @@ extern "C" const char*optarg;
 #endif
 
 bool verbose_flag = false;
+bool two_state_flag = false;
 bool version_flag = false;
+static bool async_io_flag = false;
+static bool levelize_flag = false;
 static int vvp_return_value = 0;
 
 void vpip_set_return_value(int value)
@@ -65,6 +71,11 @@ void vpip_set_return_value(int value)
       vvp_return_value = value;
 }
 
+int vpip_get_return_value(void)
+{
+      return vvp_return_value;
+}
+
 static char log_buffer[4096];
 
 #if defined(HAVE_SYS_RESOURCE_H)
@@ -247,7 +258,7 @@ static void final_cleanup()
 unsigned module_cnt = 0;
 const char*module_tab[64];
 
-extern void vpip_mcd_init(FILE *log);
+extern void vpip_mcd_init(FILE *log, bool async);
 extern void vvp_vpi_init(void);
 
 int main(int argc, char*argv[])
@@ -255,6 +266,9 @@ int main(int argc, char*argv[])
       int opt;
       unsigned flag_errors = 0;
       const char*design_path = 0;
+      const char*server_path = 0;
+      const char*shutdown_path = 0;
+      const char*image_path = 0;
       struct rusage cycles[3];
       const char *logfile_name = 0x0;
       FILE *logfile = 0x0;
@@ -278,11 +292,15 @@ int main(int argc, char*argv[])
         /* For non-interactive runs we do not want to run the interactive
          * debugger, so make $stop just execute a $finish. */
       stop_is_finish = false;
-      while ((opt = getopt(argc, argv, "+hil:M:m:nNsvV")) != EOF) switch (opt) {
+      while ((opt = getopt(argc, argv, "+2acd:hil:M:m:nNo:q:r:R:svV")) != EOF) switch (opt) {
          case 'h':
            fprintf(stderr,
                    "Usage: vvp [options] input-file [+plusargs...]\n"
                    "Options:\n"
+                   " -2             Start variables at 0 instead of X.\n"
+                   " -a             Write output files from a writer thread.\n"
+                   " -c             Levelize the combinational functors.\n"
+                   " -d engine      Instruction dispatch (fused, call or profile).\n"
                    " -h             Print this help message.\n"
                    " -i             Interactive mode (unbuffered stdio).\n"
                    " -l file        Logfile, '-' for <stderr>\n"
@@ -291,10 +309,30 @@ int main(int argc, char*argv[])
                    " -m module      Load vpi module.\n"
 		   " -n             Non-interactive ($stop = $finish).\n"
                    " -N             Same as -n, but exit code is 1 instead of 0\n"
+                   " -o file        Write the lex image of the input file to file.\n"
+                   " -q queue       Event time queue (wheel or list).\n"
+                   " -r file        Run a copy of the $fork_server at file.\n"
+                   " -R file        Shut down the $fork_server at file.\n"
 		   " -s             $stop right away.\n"
                    " -v             Verbose progress messages.\n"
                    " -V             Print the version information.\n" );
            exit(0);
+	  case '2':
+	    two_state_flag = true;
+	    break;
+	  case 'a':
+	    async_io_flag = true;
+	    break;
+	  case 'c':
+	    levelize_flag = true;
+	    break;
+	  case 'd':
+	    if (! codespace_select_dispatch(optarg)) {
+		  fprintf(stderr, "%s: unknown dispatch engine \"%s\".\n",
+			  argv[0], optarg);
+		  flag_errors += 1;
+	    }
+	    break;
 	  case 'i':
 	    setvbuf(stdout, 0, _IONBF, 0);
 	    break;
@@ -318,6 +356,22 @@ int main(int argc, char*argv[])
             stop_is_finish = true;
             stop_is_finish_exit_code = 1;
             break;
+	  case 'o':
+	    image_path = optarg;
+	    break;
+	  case 'q':
+	    if (! schedule_select_time_queue(optarg)) {
+		  fprintf(stderr, "%s: unknown event queue \"%s\".\n",
+			  argv[0], optarg);
+		  flag_errors += 1;
+	    }
+	    break;
+	  case 'r':
+	    server_path = optarg;
+	    break;
+	  case 'R':
+	    shutdown_path = optarg;
+	    break;
 	  case 's':
 	    schedule_stop(0);
 	    break;
@@ -358,6 +412,13 @@ int main(int argc, char*argv[])
 	    return 0;
       }
 
+	/* A fork server runs a copy of its frozen simulation, which
+	   has all the state of the design, so there is no input file. */
+      if (server_path)
+	    return fork_server_run(server_path, argc-optind, argv+optind);
+      if (shutdown_path)
+	    return fork_server_shutdown(shutdown_path);
+
       if (optind == argc) {
 	    fprintf(stderr, "%s: no input file.\n", argv[0]);
 	    return -1;
@@ -389,7 +450,7 @@ int main(int argc, char*argv[])
 	    }
       }
 
-      vpip_mcd_init(logfile);
+      vpip_mcd_init(logfile, async_io_flag);
 
       if (verbose_flag) {
 	    my_getrusage(cycles+0);
@@ -406,9 +467,20 @@ int main(int argc, char*argv[])
       for (unsigned idx = 0 ;  idx < module_cnt ;  idx += 1)
 	    vpip_load_module(module_tab[idx]);
 
+      if (image_path && ! lex_image_write_start(image_path, design_path))
+	    return 1;
+
       int ret_cd = compile_design(design_path);
       destroy_lexor();
       print_vpi_call_errors();
+
+	/* Writing the lex image only compiles the design, and does
+	   not run it. */
+      if (image_path) {
+	    if (! lex_image_write_finish(ret_cd == 0) && ret_cd == 0)
+		  ret_cd = 1;
+	    return ret_cd;
+      }
       if (ret_cd) return ret_cd;
 
       if (!have_ivl_version) {
@@ -430,6 +502,11 @@ int main(int argc, char*argv[])
 	    return compile_errors;
       }
 
+      unsigned long count_levelized = 0;
+      unsigned levelized_levels = 0;
+      if (levelize_flag)
+	    count_levelized = schedule_levelize_functors(levelized_levels);
+
       if (verbose_flag) {
 	    vpi_mcd_printf(1, " ... %8lu functors (net_fun pool=%zu bytes)\n",
 			   count_functors, vvp_net_fun_t::heap_total());
@@ -437,13 +514,19 @@ int main(int argc, char*argv[])
 	    vpi_mcd_printf(1, "           %8lu bufif\n",  count_functors_bufif);
 	    vpi_mcd_printf(1, "           %8lu resolv\n",count_functors_resolv);
 	    vpi_mcd_printf(1, "           %8lu signals\n", count_functors_sig);
+	    if (levelize_flag)
+		  vpi_mcd_printf(1, "           %8lu levelized (%u levels)\n",
+				 count_levelized, levelized_levels);
 	    vpi_mcd_printf(1, " ... %8lu filters (net_fil pool=%zu bytes)\n",
 			   count_filters, vvp_net_fil_t::heap_total());
 	    vpi_mcd_printf(1, " ... %8lu opcodes (%zu bytes)\n",
 	                   count_opcodes, size_opcodes);
+	    vpi_mcd_printf(1, "           %8lu fused\n", count_opcodes_fused);
 	    vpi_mcd_printf(1, " ... %8lu nets\n",     count_vpi_nets);
 	    vpi_mcd_printf(1, " ... %8lu vvp_nets (%zu bytes)\n",
 			   count_vvp_nets, size_vvp_nets);
+	    vpi_mcd_printf(1, "           %8lu fanouts (%zu bytes)\n",
+			   count_vvp_fanouts, size_vvp_fanouts);
 	    vpi_mcd_printf(1, " ... %8lu arrays (%lu words)\n",
 			   count_net_arrays, count_net_array_words);
 	    vpi_mcd_printf(1, " ... %8lu memories\n",
@@ -464,6 +547,12 @@ int main(int argc, char*argv[])
 
       schedule_simulate();
 
+	/* Write out the output that is still buffered for the writer
+	   thread, now that the simulation is over. */
+      vpip_mcd_sync();
+
+      vthread_profile_report();
+
       if (verbose_flag) {
 	    my_getrusage(cycles+2);
 	    print_rusage(cycles+2, cycles+1);
@@ -491,5 +580,6 @@ int main(int argc, char*argv[])
 
       final_cleanup();
 
+      fork_server_report_exit(vvp_return_value);
       return vvp_return_value;
 }
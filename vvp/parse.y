@@ -22,6 +22,7 @@
 # include  "parse_misc.h"
 # include  "compile.h"
 # include  "delay.h"
+# include  "lex_image.h"
 # include  <list>
 # include  <cstdio>
 # include  <cstdlib>
@@ -34,6 +35,12 @@
  */
 extern FILE*yyin;
 
+/*
+ * The parser reads its tokens through the lex image, which may read
+ * them from an image file instead of running the lexor.
+ */
+# define yylex lex_image_lex
+
 vector <const char*> file_names;
 
 /*
@@ -1241,13 +1248,23 @@ int compile_design(const char*path)
 {
       yypath = path;
       yyline = 1;
+
+      int rc = lex_image_open(path);
+      if (rc < 0)
+	    return -1;
+      if (rc > 0) {
+	    rc = yyparse();
+	    lex_image_close();
+	    return rc;
+      }
+
       yyin = fopen(path, "r");
       if (yyin == 0) {
 	    fprintf(stderr, "%s: Unable to open input file.\n", path);
 	    return -1;
       }
 
-      int rc = yyparse();
+      rc = yyparse();
       fclose(yyin);
       return rc;
 }
@@ -56,6 +56,8 @@ class vvp_fun_part_sa  : public vvp_fun_part, public vvp_gen_event_s {
 			unsigned, unsigned, unsigned,
                         vvp_context_t);
 
+      vvp_gen_event_s* levelize_event() { return this; }
+
     private:
       void run_run();
 
@@ -98,7 +98,7 @@ resolv_extend::~resolv_extend()
 
 
 resolv_tri::resolv_tri(unsigned nports, vvp_net_t*net, vvp_scalar_t hiz_value)
-: resolv_core(nports, net), hiz_value_(hiz_value)
+: resolv_core(nports, net), hiz_value_(hiz_value), val4_(0)
 {
         // count the input (leaf) nodes
       unsigned nnodes = nports;
@@ -113,23 +113,100 @@ resolv_tri::resolv_tri(unsigned nports, vvp_net_t*net, vvp_scalar_t hiz_value)
       if (nnodes > 1)
             nnodes += 1;
 
+      nnodes_ = nnodes;
       val_ = new vvp_vector8_t [nnodes];
+
+	// Without a puller, start out resolving strong values.
+      if (hiz_value_.is_hiz())
+	    val4_ = new vvp_vector4_t [nnodes];
 }
 
 resolv_tri::~resolv_tri()
 {
       delete[] val_;
+      delete[] val4_;
 }
 
 void resolv_tri::recv_vec4_(unsigned port, const vvp_vector4_t&bit)
 {
+      if (val4_) {
+	    recv_strong_(port, bit);
+	    return;
+      }
+
       recv_vec8_(port, vvp_vector8_t(bit, 6,6 /* STRONG */));
 }
 
+/*
+ * As long as all the drivers are strong (or HiZ), which is the case
+ * for continuous assignments and most gates, the resolution can be
+ * done with 4-state words, and the strengths are added only to the
+ * output value. The val4_ tree mirrors the val_ tree. The first
+ * driver with any other strength switches the resolver to the
+ * strength tree for good.
+ */
+void resolv_tri::recv_strong_(unsigned port, const vvp_vector4_t&bit)
+{
+      assert(port < nports_);
+
+      if (val4_[port].eeq(bit))
+	    return;
+
+      val4_[port] = bit;
+
+	// This is the same tree walk as in recv_vec8_.
+      unsigned base = 0;
+      unsigned span = nports_;
+      while (span > 1) {
+            unsigned next_base = base + span;
+            unsigned ip = base + (port & ~0x3);
+            unsigned op = next_base + (port / 4);
+            unsigned ll = min(ip + 4, next_base);
+
+            vvp_vector4_t out = val4_[ip];
+            for (ip = ip + 1; ip < ll; ip += 1) {
+                  if (val4_[ip].size() == 0)
+                        continue;
+                  if (out.size() == 0)
+                        out = val4_[ip];
+                  else
+                        out = resolve4(out, val4_[ip]);
+            }
+            if (val4_[op].eeq(out))
+                  return;
+            val4_[op] = out;
+
+            base = next_base;
+            span = (span + 3) / 4;
+            port = port / 4;
+      }
+
+      net_->send_vec8(vvp_vector8_t(val4_[base], 6,6 /* STRONG */));
+}
+
+void resolv_tri::leave_strong_()
+{
+      for (unsigned idx = 0 ;  idx < nnodes_ ;  idx += 1) {
+	    if (val4_[idx].size() > 0)
+		  val_[idx] = vvp_vector8_t(val4_[idx], 6,6 /* STRONG */);
+      }
+
+      delete[] val4_;
+      val4_ = 0;
+}
+
 void resolv_tri::recv_vec8_(unsigned port, const vvp_vector8_t&bit)
 {
       assert(port < nports_);
 
+      if (val4_) {
+	    if (bit.is_strong()) {
+		  recv_strong_(port, reduce4(bit));
+		  return;
+	    }
+	    leave_strong_();
+      }
+
       if (val_[port].eeq(bit))
 	    return;
 
@@ -180,6 +257,16 @@ void resolv_tri::recv_vec8_(unsigned port, const vvp_vector8_t&bit)
 
 void resolv_tri::count_drivers(unsigned bit_idx, unsigned counts[3])
 {
+      if (val4_) {
+	    for (unsigned idx = 0 ; idx < nports_ ; idx += 1) {
+		  if (val4_[idx].size() == 0)
+			continue;
+
+		  update_driver_counts(val4_[idx].value(bit_idx), counts);
+	    }
+	    return;
+      }
+
       for (unsigned idx = 0 ; idx < nports_ ; idx += 1) {
 	    if (val_[idx].size() == 0)
 	          continue;
@@ -285,27 +372,7 @@ resolv_triand::~resolv_triand()
 
 vvp_vector4_t resolv_triand::wired_logic_math_(vvp_vector4_t&a, vvp_vector4_t&b)
 {
-      assert(a.size() == b.size());
-
-      vvp_vector4_t out (a.size());
-
-      for (unsigned idx = 0 ; idx < out.size() ; idx += 1) {
-	    vvp_bit4_t abit = a.value(idx);
-	    vvp_bit4_t bbit = b.value(idx);
-	    if (abit == BIT4_Z) {
-		  out.set_bit(idx, bbit);
-	    } else if (bbit == BIT4_Z) {
-		  out.set_bit(idx, abit);
-	    } else if (abit == BIT4_0 || bbit == BIT4_0) {
-		  out.set_bit(idx, BIT4_0);
-	    } else if (abit == BIT4_X || bbit == BIT4_X) {
-		  out.set_bit(idx, BIT4_X);
-	    } else {
-		  out.set_bit(idx, BIT4_1);
-	    }
-      }
-
-      return out;
+      return resolve4_wand(a, b);
 }
 
 
@@ -320,25 +387,5 @@ resolv_trior::~resolv_trior()
 
 vvp_vector4_t resolv_trior::wired_logic_math_(vvp_vector4_t&a, vvp_vector4_t&b)
 {
-      assert(a.size() == b.size());
-
-      vvp_vector4_t out (a.size());
-
-      for (unsigned idx = 0 ; idx < out.size() ; idx += 1) {
-	    vvp_bit4_t abit = a.value(idx);
-	    vvp_bit4_t bbit = b.value(idx);
-	    if (abit == BIT4_Z) {
-		  out.set_bit(idx, bbit);
-	    } else if (bbit == BIT4_Z) {
-		  out.set_bit(idx, abit);
-	    } else if (abit == BIT4_1 || bbit == BIT4_1) {
-		  out.set_bit(idx, BIT4_1);
-	    } else if (abit == BIT4_X || bbit == BIT4_X) {
-		  out.set_bit(idx, BIT4_X);
-	    } else {
-		  out.set_bit(idx, BIT4_0);
-	    }
-      }
-
-      return out;
+      return resolve4_wor(a, b);
 }
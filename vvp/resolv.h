@@ -93,6 +93,8 @@ class resolv_extend : public vvp_net_fun_t {
             { core_->recv_vec8_pv_(port_base_ + port.port(), bit,
                                    base, wid, vwid); }
 
+      vvp_net_t* levelize_core_net() { return core_->net_; }
+
     private:
       resolv_core*core_;
       unsigned port_base_;
@@ -123,11 +125,19 @@ class resolv_tri : public resolv_core {
       void recv_vec4_(unsigned port, const vvp_vector4_t&bit);
       void recv_vec8_(unsigned port, const vvp_vector8_t&bit);
 
+      void recv_strong_(unsigned port, const vvp_vector4_t&bit);
+      void leave_strong_();
+
     private:
         // The puller value to be used when a bit is not driven.
       vvp_scalar_t hiz_value_;
+        // The number of nodes in the tree.
+      unsigned nnodes_;
         // The array of input values.
       vvp_vector8_t*val_;
+        // The array of 4-state input values, used instead of val_
+        // while all the inputs are strong. This is nil otherwise.
+      vvp_vector4_t*val4_;
 };
 
 /*
@@ -24,12 +24,16 @@
 # include  "vvp_net_sig.h"
 # include  "slab.h"
 # include  "compile.h"
+# include  "statistics.h"
 # include  <new>
 # include  <typeinfo>
 # include  <csignal>
 # include  <cstdlib>
+# include  <cstring>
 # include  <cassert>
 # include  <iostream>
+# include  <map>
+# include  <vector>
 #ifdef CHECK_WITH_VALGRIND
 # include  "vvp_cleanup.h"
 # include  "ivl_alloc.h"
@@ -49,6 +53,8 @@ unsigned long count_time_events = 0;
  *
  * The event_time_s objects are one per time step. Each time step in
  * turn contains a list of event_s objects that are the actual events.
+ * The pending time steps are held in an event_time_queue_s (see
+ * below) that keeps them ordered by absolute simulation time.
  *
  * The event_s objects are base classes for the more specific sort of
  * event.
@@ -83,7 +89,8 @@ struct event_time_s {
 	    del_thr = 0;
 	    next = NULL;
       }
-      vvp_time64_t delay;
+	// The absolute simulation time of this time step.
+      vvp_time64_t time;
 
       struct event_s*start;
       struct event_s*active;
@@ -93,6 +100,7 @@ struct event_time_s {
       struct event_s*rosync;
       struct event_s*del_thr;
 
+	// Link used by the list time queue.
       struct event_time_s*next;
 
       static void* operator new (size_t);
@@ -552,11 +560,276 @@ inline void event_time_s::operator delete(void*ptr, size_t)
 unsigned long count_time_pool(void) { return event_time_heap.pool; }
 
 /*
- * This is the head of the list of pending events. This includes all
- * the events that have not been executed yet, and reaches into the
- * future.
+ * The event_time_queue_s holds the pending time steps. This includes
+ * all the events that have not been executed yet, and reaches into
+ * the future. The scheduler only ever asks for the earliest time step
+ * (the front) and for the time step at a given absolute time, which
+ * is created if it does not yet exist. Time never goes backwards, so
+ * the requested time is never before the front.
  */
-static struct event_time_s* sched_list = 0;
+class event_time_queue_s {
+    public:
+      virtual ~event_time_queue_s() { }
+	// Return the time step for the given absolute time, creating
+	// it if necessary.
+      virtual event_time_s* find_time(vvp_time64_t time) =0;
+	// Return the earliest pending time step, or nil if there are
+	// no more pending time steps.
+      inline event_time_s* front() const { return front_; }
+	// Remove the front time step from the queue. The caller
+	// takes over the event_time_s object.
+      virtual void pop_front() =0;
+
+    protected:
+      event_time_s*front_;
+};
+
+/*
+ * The list queue is a sorted, singly linked list of time steps. This
+ * is simple and fast when only a few time steps are pending, but an
+ * insertion must walk the list, so the cost grows with the number of
+ * distinct times in the future.
+ */
+class event_time_list_s : public event_time_queue_s {
+    public:
+      event_time_list_s() { front_ = 0; }
+
+      event_time_s* find_time(vvp_time64_t time);
+      void pop_front();
+};
+
+event_time_s* event_time_list_s::find_time(vvp_time64_t time)
+{
+      struct event_time_s**cur = &front_;
+      while (*cur && (*cur)->time < time)
+	    cur = &(*cur)->next;
+
+      if (*cur && (*cur)->time == time)
+	    return *cur;
+
+      struct event_time_s*tmp = new struct event_time_s;
+      tmp->time = time;
+      tmp->next = *cur;
+      *cur = tmp;
+      return tmp;
+}
+
+void event_time_list_s::pop_front()
+{
+      assert(front_);
+      front_ = front_->next;
+}
+
+/*
+ * The wheel queue is a two level timing wheel. Time steps within
+ * WHEEL_SIZE of the base time are kept in a circular array of slots
+ * indexed by the low bits of the time, and a two level bitmap of the
+ * occupied slots makes finding the next time step a couple of bit
+ * scans. Time steps further in the future are kept in an ordered
+ * overflow map and are moved into the wheel as time advances towards
+ * them. Insertion is therefore constant time for the near future and
+ * logarithmic in the number of far future time steps.
+ */
+class event_time_wheel_s : public event_time_queue_s {
+
+      static const unsigned WHEEL_BITS = 12;
+      static const unsigned WHEEL_SIZE = 1U << WHEEL_BITS;
+      static const unsigned WHEEL_MASK = WHEEL_SIZE - 1;
+      static const unsigned MAP_WORDS  = WHEEL_SIZE / 64;
+
+    public:
+      event_time_wheel_s();
+
+      event_time_s* find_time(vvp_time64_t time);
+      void pop_front();
+
+    private:
+      inline bool in_wheel_(vvp_time64_t time) const
+      { return time - base_ < WHEEL_SIZE; }
+      void set_slot_(event_time_s*ctim);
+      void clr_slot_(unsigned idx);
+      unsigned next_slot_(unsigned idx) const;
+
+    private:
+	// All the time steps in the wheel are in [base_, base_+WHEEL_SIZE).
+      vvp_time64_t base_;
+      unsigned wheel_count_;
+      event_time_s*slot_[WHEEL_SIZE];
+	// Bit N of map_[W] is set if slot W*64+N is occupied, and bit
+	// W of summary_ is set if map_[W] is not zero.
+      uint64_t map_[MAP_WORDS];
+      uint64_t summary_;
+	// These are the time steps at or beyond base_+WHEEL_SIZE.
+      std::map<vvp_time64_t,event_time_s*> far_;
+};
+
+static inline unsigned find_first_bit(uint64_t word)
+{
+      assert(word != 0);
+#if defined(__GNUC__)
+      return __builtin_ctzll(word);
+#else
+      unsigned idx = 0;
+      while ((word & 1) == 0) {
+	    word >>= 1;
+	    idx += 1;
+      }
+      return idx;
+#endif
+}
+
+event_time_wheel_s::event_time_wheel_s()
+{
+      front_ = 0;
+      base_ = 0;
+      wheel_count_ = 0;
+      for (unsigned idx = 0 ; idx < WHEEL_SIZE ; idx += 1)
+	    slot_[idx] = 0;
+      for (unsigned idx = 0 ; idx < MAP_WORDS ; idx += 1)
+	    map_[idx] = 0;
+      summary_ = 0;
+}
+
+inline void event_time_wheel_s::set_slot_(event_time_s*ctim)
+{
+      unsigned idx = ctim->time & WHEEL_MASK;
+      assert(slot_[idx] == 0);
+      slot_[idx] = ctim;
+      map_[idx/64] |= (uint64_t)1 << (idx%64);
+      summary_ |= (uint64_t)1 << (idx/64);
+      wheel_count_ += 1;
+}
+
+inline void event_time_wheel_s::clr_slot_(unsigned idx)
+{
+      slot_[idx] = 0;
+      map_[idx/64] &= ~((uint64_t)1 << (idx%64));
+      if (map_[idx/64] == 0)
+	    summary_ &= ~((uint64_t)1 << (idx/64));
+      wheel_count_ -= 1;
+}
+
+/*
+ * Return the first occupied slot at or after idx, wrapping around the
+ * end of the wheel. The wheel must not be empty.
+ */
+unsigned event_time_wheel_s::next_slot_(unsigned idx) const
+{
+      assert(summary_ != 0);
+      unsigned word = idx / 64;
+      uint64_t bits = map_[word] & (~(uint64_t)0 << (idx%64));
+      if (bits)
+	    return word*64 + find_first_bit(bits);
+
+      uint64_t words = summary_;
+      if (word+1 < MAP_WORDS) {
+	    uint64_t above = summary_ & (~(uint64_t)0 << (word+1));
+	    if (above) words = above;
+      }
+
+      word = find_first_bit(words);
+      return word*64 + find_first_bit(map_[word]);
+}
+
+event_time_s* event_time_wheel_s::find_time(vvp_time64_t time)
+{
+	// Most events are scheduled for the current time step.
+      if (front_ && front_->time == time)
+	    return front_;
+
+      assert(time >= base_);
+
+      event_time_s*ctim;
+      if (in_wheel_(time)) {
+	    ctim = slot_[time & WHEEL_MASK];
+	    if (ctim) {
+		  assert(ctim->time == time);
+		  return ctim;
+	    }
+
+	    ctim = new struct event_time_s;
+	    ctim->time = time;
+	    set_slot_(ctim);
+
+      } else {
+	    std::map<vvp_time64_t,event_time_s*>::iterator cur = far_.lower_bound(time);
+	    if (cur != far_.end() && cur->first == time)
+		  return cur->second;
+
+	    ctim = new struct event_time_s;
+	    ctim->time = time;
+	    far_.insert(cur, std::make_pair(time, ctim));
+      }
+
+      if (front_ == 0 || time < front_->time)
+	    front_ = ctim;
+
+      return ctim;
+}
+
+void event_time_wheel_s::pop_front()
+{
+      assert(front_);
+
+      if (in_wheel_(front_->time)) {
+	    clr_slot_(front_->time & WHEEL_MASK);
+      } else {
+	      // The front can only be outside the wheel if the wheel
+	      // is empty.
+	    assert(wheel_count_ == 0);
+	    assert(far_.begin()->second == front_);
+	    far_.erase(far_.begin());
+      }
+
+	// Nothing that remains is earlier than the time step that was
+	// just removed, so the wheel can advance to that time. If the
+	// wheel is now empty, skip ahead to the first far time step.
+      base_ = front_->time;
+      if (wheel_count_ == 0 && !far_.empty())
+	    base_ = far_.begin()->first;
+
+	// Move the far time steps that now fit into the wheel.
+      while (!far_.empty() && in_wheel_(far_.begin()->first)) {
+	    set_slot_(far_.begin()->second);
+	    far_.erase(far_.begin());
+      }
+
+      if (wheel_count_ == 0)
+	    front_ = 0;
+      else
+	    front_ = slot_[next_slot_(base_ & WHEEL_MASK)];
+}
+
+/*
+ * The kind of time queue to use is selected by the command line. The
+ * queue itself is created when the first event is scheduled.
+ */
+static bool sched_use_list = false;
+static event_time_queue_s*sched_queue = 0;
+
+bool schedule_select_time_queue(const char*name)
+{
+      assert(sched_queue == 0);
+      if (strcmp(name, "wheel") == 0) {
+	    sched_use_list = false;
+      } else if (strcmp(name, "list") == 0) {
+	    sched_use_list = true;
+      } else {
+	    return false;
+      }
+      return true;
+}
+
+static inline event_time_queue_s* sched_time_queue(void)
+{
+      if (sched_queue == 0) {
+	    if (sched_use_list)
+		  sched_queue = new event_time_list_s;
+	    else
+		  sched_queue = new event_time_wheel_s;
+      }
+      return sched_queue;
+}
 
 /*
  * This is a list of initialization events. The setup puts
@@ -672,68 +945,21 @@ static void schedule_final_event(struct event_s*cur)
 
 /*
  * This function does all the hard work of putting an event into the
- * event queue. The event delay is taken from the event structure
- * itself, and the structure is placed in the right place in the
- * queue.
+ * event queue. The delay is relative to the current simulation time,
+ * and the time queue finds (or creates) the time step for it. The
+ * event is then placed in the right place in that time step.
  */
 typedef enum event_queue_e { SEQ_START, SEQ_ACTIVE, SEQ_INACTIVE, SEQ_NBASSIGN,
 			     SEQ_RWSYNC, SEQ_ROSYNC, DEL_THREAD } event_queue_t;
 
+static vvp_time64_t schedule_time;
+
 static void schedule_event_(struct event_s*cur, vvp_time64_t delay,
 			    event_queue_t select_queue)
 {
       cur->next = cur;
-      struct event_time_s*ctim = sched_list;
-
-      if (sched_list == 0) {
-	      /* Is the event_time list completely empty? Create the
-		 first event_time object. */
-	    ctim = new struct event_time_s;
-	    ctim->delay = delay;
-	    ctim->next  = 0;
-	    sched_list = ctim;
-
-      } else if (sched_list->delay > delay) {
-
-	      /* Am I looking for an event before the first event_time?
-		 If so, create a new event_time to go in front. */
-	    struct event_time_s*tmp = new struct event_time_s;
-	    tmp->delay = delay;
-	    tmp->next = ctim;
-	    ctim->delay -= delay;
-	    ctim = tmp;
-	    sched_list = ctim;
-
-      } else {
-	    struct event_time_s*prev = 0;
-
-	    while (ctim->next && (ctim->delay < delay)) {
-		  delay -= ctim->delay;
-		  prev = ctim;
-		  ctim = ctim->next;
-	    }
-
-	    if (ctim->delay > delay) {
-		  struct event_time_s*tmp = new struct event_time_s;
-		  tmp->delay = delay;
-		  tmp->next  = prev->next;
-		  prev->next = tmp;
-
-		  tmp->next->delay -= delay;
-		  ctim = tmp;
-
-	    } else if (ctim->delay == delay) {
-
-	    } else {
-		  assert(ctim->next == 0);
-		  struct event_time_s*tmp = new struct event_time_s;
-		  tmp->delay = delay - ctim->delay;
-		  tmp->next = 0;
-		  ctim->next = tmp;
-
-		  ctim = tmp;
-	    }
-      }
+      struct event_time_s*ctim
+	    = sched_time_queue()->find_time(schedule_time + delay);
 
 	/* By this point, ctim is the event_time structure that is to
 	   receive the event at hand. Put the event in to the
@@ -784,13 +1010,12 @@ static void schedule_event_(struct event_s*cur, vvp_time64_t delay,
 
 static void schedule_event_push_(struct event_s*cur)
 {
-      if ((sched_list == 0) || (sched_list->delay > 0)) {
+      struct event_time_s*ctim = sched_time_queue()->front();
+      if ((ctim == 0) || (ctim->time > schedule_time)) {
 	    schedule_event_(cur, 0, SEQ_ACTIVE);
 	    return;
       }
 
-      struct event_time_s*ctim = sched_list;
-
       if (ctim->active == 0) {
 	    cur->next = cur;
 	    ctim->active = cur;
@@ -1007,8 +1232,32 @@ void schedule_generic(vvp_gen_event_t obj, vvp_time64_t delay,
 
 static bool sim_started;
 
+/*
+ * The levelized functors that are waiting to run are kept in a list
+ * for each level, and run in the order that they were scheduled
+ * within a level. functor_level_low is the lowest level that may
+ * have a functor in its list.
+ */
+struct functor_level_s {
+      functor_level_s() : head(0) { }
+      std::vector<vvp_gen_event_t> list;
+      size_t head;
+};
+static std::vector<functor_level_s> functor_levels;
+static unsigned functor_level_low = 0;
+static unsigned long functor_level_count = 0;
+
 void schedule_functor(vvp_gen_event_t obj)
 {
+      if (sim_started && obj->sched_level) {
+	    unsigned level = obj->sched_level;
+	    functor_levels[level].list.push_back(obj);
+	    functor_level_count += 1;
+	    if (level < functor_level_low)
+		  functor_level_low = level;
+	    return;
+      }
+
       struct generic_event_s*cur = new generic_event_s;
 
       cur->obj = obj;
@@ -1020,6 +1269,132 @@ void schedule_functor(vvp_gen_event_t obj)
       }
 }
 
+/*
+ * Run the levelized functors, lowest level first, until there are
+ * none left. A functor may schedule functors at higher levels, or at
+ * lower levels if it is in a loop, and those are run too.
+ */
+static void run_levelized_functors(void)
+{
+      while (functor_level_count > 0) {
+	    functor_level_s&cur = functor_levels[functor_level_low];
+	    if (cur.head == cur.list.size()) {
+		  cur.list.clear();
+		  cur.head = 0;
+		  functor_level_low += 1;
+		  continue;
+	    }
+
+	    vvp_gen_event_t obj = cur.list[cur.head];
+	    cur.head += 1;
+	    functor_level_count -= 1;
+	    count_gen_events += 1;
+	    obj->run_run();
+      }
+}
+
+/*
+ * The level of a functor is found from its height, which is the
+ * length of the longest path from its net to a net with no fan-out.
+ * A net that passes its inputs on to a core net has an edge to that
+ * net as well as to its fan-out. The heights are found with a depth
+ * first search that uses its own stack, because the paths may be very
+ * long, and an edge back to a net that is still on the stack is
+ * ignored, which cuts the loops.
+ */
+struct levelize_frame_s {
+      unsigned long idx;
+      vvp_net_t*net;
+      vvp_net_ptr_t next;
+      bool core_done;
+      unsigned height;
+};
+
+static vvp_net_t* levelize_next(levelize_frame_s&frame)
+{
+      if (! frame.core_done) {
+	    frame.core_done = true;
+	    if (frame.net->fun) {
+		  if (vvp_net_t*core = frame.net->fun->levelize_core_net())
+			return core;
+	    }
+      }
+
+      vvp_net_t*dst = frame.next.ptr();
+      if (dst)
+	    frame.next = dst->port[frame.next.port()];
+      return dst;
+}
+
+unsigned long schedule_levelize_functors(unsigned&levels)
+{
+      enum { NEW = 0, OPEN, DONE };
+      std::vector<unsigned> height (count_vvp_nets, 0);
+      std::vector<unsigned char> state (count_vvp_nets, NEW);
+      std::vector<levelize_frame_s> stack;
+      unsigned max_height = 0;
+
+      for (unsigned long root = 0 ; root < count_vvp_nets ; root += 1) {
+	    if (state[root] != NEW)
+		  continue;
+
+	    levelize_frame_s frame;
+	    frame.idx = root;
+	    frame.net = vvp_net_from_index(root);
+	    frame.next = frame.net->fanout();
+	    frame.core_done = false;
+	    frame.height = 0;
+	    state[root] = OPEN;
+	    stack.push_back(frame);
+
+	    while (! stack.empty()) {
+		  levelize_frame_s&top = stack.back();
+		  if (vvp_net_t*dst = levelize_next(top)) {
+			unsigned long idx = vvp_net_to_index(dst);
+			if (state[idx] == DONE) {
+			      if (height[idx] + 1 > top.height)
+				    top.height = height[idx] + 1;
+			} else if (state[idx] == NEW) {
+			      frame.idx = idx;
+			      frame.net = dst;
+			      frame.next = dst->fanout();
+			      frame.core_done = false;
+			      frame.height = 0;
+			      state[idx] = OPEN;
+			      stack.push_back(frame);
+			}
+			continue;
+		  }
+
+		  unsigned long idx = top.idx;
+		  height[idx] = top.height;
+		  state[idx] = DONE;
+		  if (top.height > max_height)
+			max_height = top.height;
+		  stack.pop_back();
+		  if (! stack.empty() && height[idx] + 1 > stack.back().height)
+			stack.back().height = height[idx] + 1;
+	    }
+      }
+
+      unsigned long count = 0;
+      for (unsigned long idx = 0 ; idx < count_vvp_nets ; idx += 1) {
+	    vvp_net_t*net = vvp_net_from_index(idx);
+	    if (net->fun == 0)
+		  continue;
+	    vvp_gen_event_s*obj = net->fun->levelize_event();
+	    if (obj == 0)
+		  continue;
+	    obj->sched_level = max_height - height[idx] + 1;
+	    count += 1;
+      }
+
+      levels = max_height + 1;
+      functor_levels.resize(max_height + 2);
+      functor_level_low = max_height + 2;
+      return count;
+}
+
 void schedule_at_start_of_simtime(vvp_gen_event_t obj, vvp_time64_t delay)
 {
       struct generic_event_s*cur = new generic_event_s;
@@ -1043,7 +1418,6 @@ void schedule_at_end_of_simtime(vvp_gen_event_t obj, vvp_time64_t delay)
       schedule_event_(cur, delay, SEQ_RWSYNC);
 }
 
-static vvp_time64_t schedule_time;
 vvp_time64_t schedule_simtime(void)
 { return schedule_time; }
 
@@ -1094,7 +1468,8 @@ static void run_rosync(struct event_time_s*ctim)
 	    delete cur;
       }
 
-      if (ctim->active || ctim->inactive || ctim->nbassign || ctim->rwsync) {
+      if (ctim->active || ctim->inactive || ctim->nbassign || ctim->rwsync
+	  || functor_level_count) {
 	    cerr << "SCHEDULER ERROR: read-only sync events "
 		 << "created RW events!" << endl;
       }
@@ -1149,7 +1524,8 @@ void schedule_simulate(void)
       // process events and when done run the final blocks.
       run_finals = schedule_runnable;
 
-      if (schedule_runnable) while (sched_list) {
+      event_time_queue_s*queue = sched_time_queue();
+      if (schedule_runnable) while (queue->front()) {
 
 	    if (schedule_stopped_flag) {
 		  schedule_stopped_flag = false;
@@ -1160,21 +1536,20 @@ void schedule_simulate(void)
 	    }
 
 	      /* ctim is the current time step. */
-	    struct event_time_s* ctim = sched_list;
+	    struct event_time_s* ctim = queue->front();
 
 	      /* If the time is advancing, then first run the
 		 postponed sync events. Run them all. */
-	    if (ctim->delay > 0) {
+	    if (ctim->time > schedule_time) {
 
 		  if (!schedule_runnable) break;
-		  schedule_time += ctim->delay;
+		  schedule_time = ctim->time;
 		    /* When the design is being traced (we are emitting
 		     * file/line information) also print any time changes. */
 		  if (show_file_line) {
 			cerr << "Advancing to simulation time: "
 			     << schedule_time << endl;
 		  }
-		  ctim->delay = 0;
 
 		  vpiNextSimTime();
 		    // Process the cbAtStartOfSimTime callbacks.
@@ -1191,6 +1566,13 @@ void schedule_simulate(void)
 	    }
 
 
+	      /* Run the levelized functors when the active queue is
+		 empty. They may in turn schedule active events. */
+	    if (ctim->active == 0 && functor_level_count > 0) {
+		  run_levelized_functors();
+		  continue;
+	    }
+
 	      /* If there are no more active events, advance the event
 		 queues. If there are not events at all, then release
 		 the event_time object. */
@@ -1211,7 +1593,7 @@ void schedule_simulate(void)
 				   deletes threads as needed. */
 			      if (ctim->active == 0) {
 				    run_rosync(ctim);
-				    sched_list = ctim->next;
+				    queue->pop_front();
 				    delete ctim;
 				    continue;
 			      }
@@ -1276,6 +1658,8 @@ void schedule_delete(void)
       array_w_heap.delete_pool();
       array_r_w_heap.delete_pool();
       generic_event_heap.delete_pool();
+      delete sched_queue;
+      sched_queue = 0;
       event_time_heap.delete_pool();
 }
 #endif
@@ -155,11 +155,38 @@ extern void schedule_del_thr(vthread_t thr);
 
 struct vvp_gen_event_s
 {
+      vvp_gen_event_s() : sched_level(0) { }
       virtual ~vvp_gen_event_s() =0;
       virtual void run_run() =0;
       virtual void single_step_display(void);
+
+	// The level that schedule_levelize_functors gave this functor,
+	// or 0 if schedule_functor puts it in the active queue.
+      unsigned sched_level;
 };
 
+/*
+ * Levelize the functors that evaluate their inputs through
+ * schedule_functor. Each such functor gets a level that is higher
+ * than the levels of the functors that drive it, and from then on
+ * schedule_functor holds it in a queue for its level instead of the
+ * active queue. When the active queue is empty, the held functors are
+ * run, lowest level first, so a functor of a combinational cone runs
+ * once after all its inputs have settled. Functors in a loop get
+ * levels as if the loop were cut. This must be called after the
+ * design is linked and before the simulation starts, and it returns
+ * the number of functors that were levelized.
+ */
+extern unsigned long schedule_levelize_functors(unsigned&levels);
+
+/*
+ * Select the data structure that holds the pending time steps. The
+ * name is "wheel" (the default) for a timing wheel, or "list" for the
+ * traditional sorted list. This must be called before any events are
+ * scheduled, and returns false if the name is not recognized.
+ */
+extern bool schedule_select_time_queue(const char*name);
+
 /*
  * This runs the simulator. It runs until all the functors run out or
  * the simulation is otherwise finished.
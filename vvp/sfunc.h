@@ -30,6 +30,8 @@ class sfunc_core : public vvp_wide_fun_core, protected vvp_gen_event_s {
       void recv_vec4(vvp_net_ptr_t port, const vvp_vector4_t&bit,
                      vvp_context_t context);
 
+      vvp_gen_event_s* levelize_event() { return this; }
+
     private:
       void recv_vec4_from_inputs(unsigned port);
       void recv_real_from_inputs(unsigned port);
@@ -24,6 +24,12 @@
  */
 unsigned long count_opcodes = 0;
 
+/*
+ * This is a count of the opcodes that were replaced with
+ * superinstructions by the codespace_fuse pass.
+ */
+unsigned long count_opcodes_fused = 0;
+
 unsigned long count_functors = 0;
 unsigned long count_functors_logic = 0;
 unsigned long count_functors_bufif = 0;
@@ -27,6 +27,7 @@
 #endif
 
 extern unsigned long count_opcodes;
+extern unsigned long count_opcodes_fused;
 extern unsigned long count_functors;
 extern unsigned long count_functors_logic;
 extern unsigned long count_functors_bufif;
@@ -34,6 +35,7 @@ extern unsigned long count_functors_resolv;
 extern unsigned long count_functors_sig;
 extern unsigned long count_filters;
 extern unsigned long count_vvp_nets;
+extern unsigned long count_vvp_fanouts;
 extern unsigned long count_vpi_nets;
 extern unsigned long count_vpi_scopes;
 
@@ -60,6 +62,7 @@ extern unsigned long count_gen_pool(void);
 
 extern size_t size_opcodes;
 extern size_t size_vvp_nets;
+extern size_t size_vvp_fanouts;
 extern size_t size_vvp_net_funs;
 
 #endif /* IVL_statistics_H */
@@ -260,20 +260,12 @@ symbol_value_t symbol_table_s::find_value_(struct tree_node_*cur,
 {
       if (cur->leaf_flag) {
 
-	    unsigned idx = 0;
-	    for (;;) {
-		    /* If we run out of keys in the leaf, then add
-		       this at the end of the leaf. */
-		  if (idx == cur->count) {
-			cur->leaf[idx].key = key_strdup_(key);
-			cur->leaf[idx].val = val;
-			cur->count += 1;
-			if (cur->count == leaf_width)
-			      split_leaf_(cur);
-
-			return val;
-		  }
-
+	      /* Do a binary search within the leaf. When the search
+		 ends, min is the position where the key belongs. */
+	    unsigned min = 0;
+	    unsigned max = cur->count;
+	    while (min < max) {
+		  unsigned idx = min + (max-min)/2;
 		  int rc = strcmp(key, cur->leaf[idx].key);
 
 		    /* If we found the key already in the table, then
@@ -284,24 +276,24 @@ symbol_value_t symbol_table_s::find_value_(struct tree_node_*cur,
 			return cur->leaf[idx].val;
 		  }
 
-		    /* If this key goes before the current key, then
-		       push all the following entries back and add
-		       this key here. */
-		  if (rc < 0) {
-			for (unsigned tmp = cur->count; tmp > idx; tmp -= 1)
-			      cur->leaf[tmp] = cur->leaf[tmp-1];
+		  if (rc < 0)
+			max = idx;
+		  else
+			min = idx + 1;
+	    }
 
-			cur->leaf[idx].key = key_strdup_(key);
-			cur->leaf[idx].val = val;
-			cur->count += 1;
-			if (cur->count == leaf_width)
-			      split_leaf_(cur);
+	      /* The key is not in the table, so push all the
+		 following entries back and add this key here. */
+	    for (unsigned tmp = cur->count; tmp > min; tmp -= 1)
+		  cur->leaf[tmp] = cur->leaf[tmp-1];
 
-			return val;
-		  }
+	    cur->leaf[min].key = key_strdup_(key);
+	    cur->leaf[min].val = val;
+	    cur->count += 1;
+	    if (cur->count == leaf_width)
+		  split_leaf_(cur);
 
-		  idx += 1;
-	    }
+	    return val;
 
       } else {
 	      /* Do a binary search within the inner node. */
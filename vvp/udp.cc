@@ -118,6 +118,59 @@ vvp_bit4_t vvp_udp_s::get_init() const
       return init_;
 }
 
+/*
+ * The lookup tables are indexed by the packed state of the device,
+ * which has 2 bits for each position: 00 for a 0, 01 for a 1 and 10
+ * for an x (or z). The first port is in the least significant
+ * bits. The tables are made only if the packed state of a device fits
+ * in UDP_LUT_BITS bits.
+ */
+static const unsigned UDP_LUT_BITS = 20;
+
+static inline unsigned long udp_spread_bits(unsigned long val)
+{
+      val &= 0xffffUL;
+      val = (val | (val << 8)) & 0x00ff00ffUL;
+      val = (val | (val << 4)) & 0x0f0f0f0fUL;
+      val = (val | (val << 2)) & 0x33333333UL;
+      val = (val | (val << 1)) & 0x55555555UL;
+      return val;
+}
+
+static inline unsigned long udp_lut_key(const udp_levels_table&cur)
+{
+      return udp_spread_bits(cur.mask1) | (udp_spread_bits(cur.maskx) << 1);
+}
+
+/*
+ * Make the levels table for the packed state KEY of NPOS
+ * positions. Return false if the key is not a valid state.
+ */
+static bool udp_lut_levels(udp_levels_table&cur, unsigned long key,
+			   unsigned npos)
+{
+      cur.mask0 = 0;
+      cur.mask1 = 0;
+      cur.maskx = 0;
+      for (unsigned pp = 0 ;  pp < npos ;  pp += 1) {
+	    unsigned long mask_bit = 1UL << pp;
+	    switch ((key >> 2*pp) & 3) {
+		case 0:
+		  cur.mask0 |= mask_bit;
+		  break;
+		case 1:
+		  cur.mask1 |= mask_bit;
+		  break;
+		case 2:
+		  cur.maskx |= mask_bit;
+		  break;
+		default:
+		  return false;
+	    }
+      }
+      return true;
+}
+
 vvp_udp_comb_s::vvp_udp_comb_s(char*label, char*name__, unsigned ports)
 : vvp_udp_s(label, name__, ports, BIT4_X, false)
 {
@@ -125,12 +178,14 @@ vvp_udp_comb_s::vvp_udp_comb_s(char*label, char*name__, unsigned ports)
       levels1_ = 0;
       nlevels0_ = 0;
       nlevels1_ = 0;
+      lut_ = 0;
 }
 
 vvp_udp_comb_s::~vvp_udp_comb_s()
 {
       delete[] levels0_;
       delete[] levels1_;
+      delete[] lut_;
 }
 
 /*
@@ -188,6 +243,9 @@ vvp_bit4_t vvp_udp_comb_s::calculate_output(const udp_levels_table&cur,
 					    const udp_levels_table&,
 					    vvp_bit4_t)
 {
+      if (lut_)
+	    return (vvp_bit4_t) lut_[udp_lut_key(cur)];
+
       return test_levels(cur);
 }
 
@@ -290,6 +348,20 @@ void vvp_udp_comb_s::compile_table(char**tab)
 
       assert(nrows0 == nlevels0_);
       assert(nrows1 == nlevels1_);
+
+	/* Run the rows for every state of the inputs to fill the
+	   lookup table. */
+      if (2*port_count() <= UDP_LUT_BITS) {
+	    unsigned long size = 1UL << 2*port_count();
+	    lut_ = new unsigned char[size];
+	    for (unsigned long key = 0 ;  key < size ;  key += 1) {
+		  struct udp_levels_table cur;
+		  if (udp_lut_levels(cur, key, port_count()))
+			lut_[key] = test_levels(cur);
+		  else
+			lut_[key] = BIT4_X;
+	    }
+      }
 }
 
 vvp_udp_seq_s::vvp_udp_seq_s(char*label, char*name__,
@@ -313,6 +385,9 @@ vvp_udp_seq_s::vvp_udp_seq_s(char*label, char*name__,
       nedges0_ = 0;
       nedges1_ = 0;
       nedgesL_ = 0;
+
+      levels_lut_ = 0;
+      edges_lut_ = 0;
 }
 
 vvp_udp_seq_s::~vvp_udp_seq_s()
@@ -324,6 +399,8 @@ vvp_udp_seq_s::~vvp_udp_seq_s()
       delete[] edges0_;
       delete[] edges1_;
       delete[] edgesL_;
+      delete[] levels_lut_;
+      delete[] edges_lut_;
 }
 
 void edge_based_on_char(struct udp_edges_table&cur, char chr, unsigned pos)
@@ -670,6 +747,78 @@ void vvp_udp_seq_s::compile_table(char**tab)
       assert(idx_edg1 == nedges1_);
       assert(idx_edgL == nedgesL_);
 
+      compile_lut_();
+}
+
+/*
+ * The state of a sequential device includes the current output, in
+ * the position after the last input. The edges lookup table has, for
+ * each state, port_count() groups of 4 entries, one for each input
+ * that may have changed, and each group is indexed by the packed
+ * previous value of that input. The entries are the full result of
+ * calculate_output, so that a change of an input is a single lookup.
+ */
+void vvp_udp_seq_s::compile_lut_()
+{
+      unsigned npos = port_count() + 1;
+      if (2*npos > UDP_LUT_BITS)
+	    return;
+
+      unsigned long nstates = 1UL << 2*npos;
+      unsigned long mask_in = ~ (-1UL << port_count());
+
+      if (nstates * port_count() * 4 <= (1UL << UDP_LUT_BITS)) {
+	    edges_lut_ = new unsigned char[nstates * port_count() * 4];
+	    memset(edges_lut_, BIT4_X, nstates * port_count() * 4);
+
+	    for (unsigned long key = 0 ;  key < nstates ;  key += 1) {
+		  struct udp_levels_table cur;
+		  if (! udp_lut_levels(cur, key, npos))
+			continue;
+
+		  vvp_bit4_t lev = test_levels_(cur);
+		  unsigned char*ent = edges_lut_ + key * port_count() * 4;
+
+		  for (unsigned pp = 0 ;  pp < port_count() ;  pp += 1) {
+			unsigned long mask_bit = 1UL << pp;
+			for (unsigned code = 0 ;  code < 3 ;  code += 1) {
+			      if (code == ((key >> 2*pp) & 3))
+				    continue;
+
+			      struct udp_levels_table prev;
+			      prev.mask0 = cur.mask0 & mask_in & ~mask_bit;
+			      prev.mask1 = cur.mask1 & mask_in & ~mask_bit;
+			      prev.maskx = cur.maskx & mask_in & ~mask_bit;
+			      switch (code) {
+				  case 0:
+				    prev.mask0 |= mask_bit;
+				    break;
+				  case 1:
+				    prev.mask1 |= mask_bit;
+				    break;
+				  default:
+				    prev.maskx |= mask_bit;
+				    break;
+			      }
+
+			      if (lev != BIT4_Z)
+				    ent[4*pp + code] = lev;
+			      else
+				    ent[4*pp + code] = test_edges_(cur, prev);
+			}
+		  }
+	    }
+	    return;
+      }
+
+      levels_lut_ = new unsigned char[nstates];
+      for (unsigned long key = 0 ;  key < nstates ;  key += 1) {
+	    struct udp_levels_table cur;
+	    if (udp_lut_levels(cur, key, npos))
+		  levels_lut_[key] = test_levels_(cur);
+	    else
+		  levels_lut_[key] = BIT4_Z;
+      }
 }
 
 bool operator == (const udp_levels_table&a, const udp_levels_table&b)
@@ -705,7 +854,33 @@ vvp_bit4_t vvp_udp_seq_s::calculate_output(const udp_levels_table&cur,
 	    break;
       }
 
-      vvp_bit4_t lev = test_levels_(cur_tmp);
+      if (edges_lut_) {
+	      /* Find the input that changed, and its previous value. */
+	    unsigned long edge_mask = (cur.mask0 ^ prev.mask0)
+		  | (cur.mask1 ^ prev.mask1)
+		  | (cur.maskx ^ prev.maskx);
+	    unsigned edge_position = 0;
+	    while ((edge_mask&1) == 0) {
+		  edge_mask >>= 1;
+		  edge_position += 1;
+	    }
+
+	    unsigned long mask_bit = 1UL << edge_position;
+	    unsigned code = 0;
+	    if (prev.mask1 & mask_bit)
+		  code = 1;
+	    else if (prev.maskx & mask_bit)
+		  code = 2;
+
+	    unsigned long idx = udp_lut_key(cur_tmp) * port_count() + edge_position;
+	    return (vvp_bit4_t) edges_lut_[4*idx + code];
+      }
+
+      vvp_bit4_t lev;
+      if (levels_lut_)
+	    lev = (vvp_bit4_t) levels_lut_[udp_lut_key(cur_tmp)];
+      else
+	    lev = test_levels_(cur_tmp);
       if (lev == BIT4_Z) {
 	    lev = test_edges_(cur_tmp, prev);
       }
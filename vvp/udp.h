@@ -102,6 +102,11 @@ struct vvp_udp_s {
  *   ?  -- 0, x or 1
  *
  * Only 0, 1 and x characters are allowed in the output position.
+ *
+ * If the device does not have too many inputs, compile_table also
+ * fills a direct lookup table with the output for every possible
+ * input state, and calculate_output uses that instead of testing the
+ * rows. The rows are still the definition of the device.
  */
 
 struct udp_levels_table {
@@ -131,6 +136,9 @@ class vvp_udp_comb_s : public vvp_udp_s {
       struct udp_levels_table*levels0_;
       struct udp_levels_table*levels1_;
       unsigned nlevels0_, nlevels1_;
+
+	// Output for each packed input state, or nil.
+      unsigned char*lut_;
 };
 
 /*
@@ -166,6 +174,13 @@ class vvp_udp_comb_s : public vvp_udp_s {
  * position, and the edge_position the bit that has shifted. In the
  * edge case, the mask* members give the final position and the
  * edge_mask* bits the initial position of the bit.
+ *
+ * Like the combinational device, a sequential device with few inputs
+ * gets lookup tables. The edges lookup table holds the next output for
+ * each state, input that changed and previous value of that input. If
+ * that table would be too large, the levels lookup table holds the
+ * result of test_levels_ for each state, and the edge rows are tested
+ * only when no level row matches.
  */
 struct udp_edges_table {
       unsigned long edge_position : 8;
@@ -208,6 +223,11 @@ class vvp_udp_seq_s : public vvp_udp_s {
       struct udp_edges_table*edgesL_;
       unsigned nedges0_, nedges1_, nedgesL_;
 
+      void compile_lut_();
+
+	// Lookup tables indexed by packed states, or nil.
+      unsigned char*levels_lut_;
+      unsigned char*edges_lut_;
 };
 
 /*
@@ -230,6 +250,8 @@ class vvp_udp_fun_core  : public vvp_wide_fun_core, private vvp_gen_event_s {
 
       void recv_vec4_from_inputs(unsigned);
 
+      vvp_gen_event_s* levelize_event() { return this; }
+
     private:
       void run_run();
 
@@ -37,6 +37,9 @@
 # include  <cstdio>
 # include  <cassert>
 # include  <cstdlib>
+# include  <cstring>
+# include  <set>
+# include  <vector>
 /*
  * Callback handles are created when the VPI function registers a
  * callback. The handle is stored by the run time, and it triggered
@@ -276,6 +279,285 @@ static value_callback* make_value_change(p_cb_data data)
       return obj;
 }
 
+/*
+ * The cbValueChangeCoalesced callbacks that have the same cb_rtn,
+ * user_data and time type share a coalesced_group. The first change
+ * of an object in a time step puts its callback in the dirty list of
+ * its group, and the first dirty group of the time step schedules the
+ * read-only sync event that calls all the dirty groups. So the cost at
+ * the end of the time step is in the number of objects that changed,
+ * and not in the number of changes. A group is deleted when the last
+ * of its callbacks is removed.
+ */
+class value_coalesced_callback;
+
+struct coalesced_group {
+      s_cb_data cb_data;
+      struct t_vpi_time cb_time;
+      std::vector<value_coalesced_callback*> members;
+	// The objects of the members, to find a second callback on an
+	// object without a scan of the members.
+      std::set<vpiHandle> objects;
+      std::vector<value_coalesced_callback*> dirty;
+      bool pending;
+};
+
+static std::vector<coalesced_group*> coalesced_groups;
+static std::vector<coalesced_group*> coalesced_pending;
+
+  /* The groups that coalesced_cb::run_run is calling. A group that
+     loses its last callback while it is in this list is deleted by
+     run_run when it is done with the list. */
+static std::vector<coalesced_group*> coalesced_running;
+
+  /* This counts the read-only sync events that call the dirty
+     groups. A callback has already put itself in the dirty list if
+     its mark is the current count. */
+static unsigned long coalesced_step = 1;
+
+struct coalesced_cb : public vvp_gen_event_s {
+      ~coalesced_cb() { }
+
+      virtual void run_run();
+};
+
+class value_coalesced_callback : public value_callback {
+    public:
+      value_coalesced_callback(p_cb_data data, coalesced_group*grp);
+
+      bool test_value_callback_ready(void);
+	// Take the callback out of its group, for vpi_remove_cb.
+      void leave_group(void);
+
+    private:
+      coalesced_group*group_;
+      unsigned long mark_;
+};
+
+inline value_coalesced_callback::value_coalesced_callback(p_cb_data data,
+							  coalesced_group*grp)
+: value_callback(data), group_(grp), mark_(0)
+{
+      grp->members.push_back(this);
+      grp->objects.insert(data->obj);
+}
+
+static void erase_coalesced(std::vector<value_coalesced_callback*>&list,
+			    value_coalesced_callback*cb)
+{
+      for (size_t idx = 0 ;  idx < list.size() ;  idx += 1) {
+	    if (list[idx] != cb)
+		  continue;
+	    list.erase(list.begin() + idx);
+	    return;
+      }
+}
+
+static void erase_coalesced(std::vector<coalesced_group*>&list,
+			    coalesced_group*grp)
+{
+      for (size_t idx = 0 ;  idx < list.size() ;  idx += 1) {
+	    if (list[idx] != grp)
+		  continue;
+	    list.erase(list.begin() + idx);
+	    return;
+      }
+}
+
+/*
+ * Mark the object as changed instead of calling the callback. This
+ * always returns false, so run_vpi_callbacks does not get the value
+ * or call the callback now.
+ */
+bool value_coalesced_callback::test_value_callback_ready(void)
+{
+      if (mark_ == coalesced_step)
+	    return false;
+
+      mark_ = coalesced_step;
+      group_->dirty.push_back(this);
+
+      if (! group_->pending) {
+	    group_->pending = true;
+	    if (coalesced_pending.empty())
+		  schedule_generic(new coalesced_cb, 0, true, true, true);
+	    coalesced_pending.push_back(group_);
+      }
+
+      return false;
+}
+
+void value_coalesced_callback::leave_group(void)
+{
+      coalesced_group*grp = group_;
+      group_ = 0;
+      if (grp == 0)
+	    return;
+
+      erase_coalesced(grp->members, this);
+      grp->objects.erase(cb_data.obj);
+      erase_coalesced(grp->dirty, this);
+      if (grp->dirty.empty() && grp->pending) {
+	    grp->pending = false;
+	    erase_coalesced(coalesced_pending, grp);
+      }
+
+      if (! grp->members.empty())
+	    return;
+
+      erase_coalesced(coalesced_groups, grp);
+      for (size_t idx = 0 ;  idx < coalesced_running.size() ;  idx += 1) {
+	    if (coalesced_running[idx] == grp)
+		  return;
+      }
+      delete grp;
+}
+
+void coalesced_cb::run_run()
+{
+      assert(coalesced_running.empty());
+      coalesced_running.swap(coalesced_pending);
+      coalesced_step += 1;
+
+      assert(vpi_mode_flag == VPI_MODE_NONE);
+      vpi_mode_flag = VPI_MODE_ROSYNC;
+
+      for (size_t idx = 0 ;  idx < coalesced_running.size() ;  idx += 1) {
+	    coalesced_group*grp = coalesced_running[idx];
+	    grp->pending = false;
+
+	      /* A callback of an earlier group may have removed all
+		 the changed objects of this group. */
+	    unsigned cnt = grp->dirty.size();
+	    if (cnt == 0)
+		  continue;
+
+	    vpiHandle*args = (vpiHandle*)malloc(cnt * sizeof(vpiHandle));
+	    for (unsigned jdx = 0 ;  jdx < cnt ;  jdx += 1)
+		  args[jdx] = grp->dirty[jdx]->cb_data.obj;
+	    grp->dirty.clear();
+
+	    switch (grp->cb_time.type) {
+		case vpiSimTime:
+		  vpip_time_to_timestruct(&grp->cb_time, schedule_simtime());
+		  break;
+		case vpiScaledRealTime:
+		  grp->cb_time.real = vpip_time_to_scaled_real(schedule_simtime(),
+			       (__vpiScope *) vpi_handle(vpiScope, args[0]));
+		  break;
+		default:
+		  break;
+	    }
+
+	    grp->cb_data.obj = vpip_make_iterator(cnt, args, true);
+	    grp->cb_data.index = cnt;
+	    (grp->cb_data.cb_rtn)(&grp->cb_data);
+      }
+
+      vpi_mode_flag = VPI_MODE_NONE;
+
+      std::vector<coalesced_group*> groups;
+      groups.swap(coalesced_running);
+      for (size_t idx = 0 ;  idx < groups.size() ;  idx += 1) {
+	    if (groups[idx]->members.empty())
+		  delete groups[idx];
+      }
+}
+
+static coalesced_group* find_coalesced_group(p_cb_data data)
+{
+      PLI_INT32 time_type = data->time? data->time->type : vpiSuppressTime;
+
+      for (size_t idx = 0 ;  idx < coalesced_groups.size() ;  idx += 1) {
+	    coalesced_group*grp = coalesced_groups[idx];
+	    if (grp->cb_data.cb_rtn == data->cb_rtn
+		&& grp->cb_data.user_data == data->user_data
+		&& grp->cb_time.type == time_type)
+		  return grp;
+      }
+
+      coalesced_group*grp = new coalesced_group;
+      grp->cb_data = *data;
+      if (data->time) {
+	    grp->cb_time = *(data->time);
+      } else {
+	    grp->cb_time.type = vpiSuppressTime;
+      }
+      grp->cb_data.time = &grp->cb_time;
+      grp->cb_data.value = 0;
+      grp->pending = false;
+      coalesced_groups.push_back(grp);
+      return grp;
+}
+
+/*
+ * An object can be in a group only once, or it would be listed twice
+ * in the iterator when it changes.
+ */
+static bool coalesced_group_has(const coalesced_group*grp, vpiHandle obj)
+{
+      return grp->objects.find(obj) != grp->objects.end();
+}
+
+/*
+ * A coalesced value change callback is attached to the signal like
+ * a value change callback, but only signals and real variables are
+ * supported.
+ */
+static value_callback* make_value_change_coalesced(p_cb_data data)
+{
+      assert(data->obj);
+      if (vpi_get(vpiAutomatic, data->obj)) {
+            fprintf(stderr, "vpi error: cannot place value change "
+                            "callback on automatically allocated "
+                            "variable '%s'\n",
+                            vpi_get_str(vpiName, data->obj));
+            return 0;
+      }
+
+      value_callback*obj = 0;
+      coalesced_group*grp;
+      switch (data->obj->get_type_code()) {
+
+	  case vpiReg:
+	  case vpiNet:
+	  case vpiIntegerVar:
+	  case vpiBitVar:
+	  case vpiByteVar:
+	  case vpiShortIntVar:
+	  case vpiIntVar:
+	  case vpiLongIntVar:
+	  case vpiRealVar:
+	    break;
+
+	  default:
+	    fprintf(stderr, "make_value_change_coalesced: sorry: I cannot "
+		    "callback values on type code=%d\n",
+		    data->obj->get_type_code());
+	    return 0;
+      }
+
+      grp = find_coalesced_group(data);
+      if (coalesced_group_has(grp, data->obj)) {
+	    fprintf(stderr, "vpi error: '%s' already has a coalesced value "
+		    "change callback with the same routine, user data "
+		    "and time type.\n", vpi_get_str(vpiFullName, data->obj));
+	    return 0;
+      }
+
+      obj = new value_coalesced_callback(data, grp);
+      if (data->obj->get_type_code() == vpiRealVar) {
+	    vpip_real_value_change(obj, data->obj);
+      } else {
+	    struct __vpiSignal*sig = dynamic_cast<__vpiSignal*>(data->obj);
+	    vvp_net_fil_t*sig_fil = dynamic_cast<vvp_net_fil_t*>(sig->node->fil);
+	    assert(sig_fil);
+	    sig_fil->add_vpi_callback(obj);
+      }
+
+      return obj;
+}
+
 class sync_callback : public __vpiCallback {
     public:
       explicit sync_callback(p_cb_data data);
@@ -574,9 +856,15 @@ void vpiNextSimTime(void)
       assert(vpi_mode_flag == VPI_MODE_NONE);
       vpi_mode_flag = VPI_MODE_RWSYNC;
 
-      while (NextSimTime) {
-	    cur = NextSimTime;
-	    NextSimTime = dynamic_cast<simulator_callback*>(cur->next);
+	/* Take the list first, so that a callback that registers
+	   another cbNextSimTime callback gets it at the next time
+	   step, and not again at this one. */
+      simulator_callback*list = NextSimTime;
+      NextSimTime = 0;
+
+      while (list) {
+	    cur = list;
+	    list = dynamic_cast<simulator_callback*>(cur->next);
 	    (cur->cb_data.cb_rtn)(&cur->cb_data);
 	    delete cur;
       }
@@ -621,6 +909,10 @@ vpiHandle vpi_register_cb(p_cb_data data)
 	    obj = make_value_change(data);
 	    break;
 
+	  case cbValueChangeCoalesced:
+	    obj = make_value_change_coalesced(data);
+	    break;
+
 	  case cbReadOnlySynch:
 	    obj = make_sync(data, true);
 	    break;
@@ -669,6 +961,9 @@ PLI_INT32 vpi_remove_cb(vpiHandle ref)
       assert(obj);
       obj->cb_data.cb_rtn = 0;
 
+      if (value_coalesced_callback*cur = dynamic_cast<value_coalesced_callback*>(obj))
+	    cur->leave_group();
+
       return 1;
 }
 
@@ -776,7 +1071,9 @@ void vvp_vpi_callback::run_vpi_callbacks()
 
       while (next) {
 	    value_callback*cur = next;
-	    next = dynamic_cast<value_callback*>(cur->next);
+	      // Only value callbacks are added to this list, so the
+	      // cast does not need to be checked.
+	    next = static_cast<value_callback*>(cur->next);
 
 	    if (cur->cb_data.cb_rtn != 0) {
 		  if (cur->test_value_callback_ready()) {
@@ -821,10 +1118,8 @@ void vvp_signal_value::get_signal_value(struct t_vpi_value*vp)
 	  case vpiStringVal:
 	  case vpiRealVal: {
 	    unsigned wid = value_size();
-	    vvp_vector4_t vec4(wid);
-	    for (unsigned idx = 0; idx < wid; idx += 1) {
-		  vec4.set_bit(idx, value(idx));
-	    }
+	    vvp_vector4_t vec4;
+	    vec4_value(vec4);
 	    vpip_vec4_get_value(vec4, wid, false, vp);
 	    break;
 	  }
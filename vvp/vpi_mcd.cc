@@ -27,6 +27,9 @@
 # include  <cstdio>
 # include  <cstdlib>
 # include  <cstring>
+#ifdef HAVE_LIBPTHREAD
+# include  <pthread.h>
+#endif
 # include  "ivl_alloc.h"
 
 extern FILE* vpi_trace;
@@ -48,6 +51,10 @@ extern FILE* vpi_trace;
 typedef struct mcd_entry {
 	FILE *fp;
 	char *filename;
+	  /* The output not yet handed to the writer thread, if the
+	     file is written by the writer thread. */
+	char *abuf;
+	size_t alen;
 } mcd_entry_s;
 static mcd_entry_s mcd_table[31];
 static mcd_entry_s *fd_table = NULL;
@@ -55,16 +62,222 @@ static unsigned fd_table_len = 0;
 
 static FILE* logfile;
 
+/*
+ * With the -a flag, the files that the design opens only for writing
+ * are written by a writer thread. The output for each such file is
+ * collected in a large buffer, and the full buffers are handed to the
+ * writer thread in a single queue, so the output of each file is
+ * written in order. The simulation waits for the queue to empty
+ * before it uses the FILE of such a file itself ($fflush, $fclose, or
+ * a module that gets the FILE with vpi_get_file), and before it ends
+ * or forks. The standard files and the log file are always written
+ * directly, so they stay in order with the messages of the runtime.
+ */
+static bool async_flag = false;
+static const size_t ASYNC_BUF_SIZE = 256*1024;
+
+#ifdef HAVE_LIBPTHREAD
+struct async_chunk_s {
+      FILE*fp;
+      char*data;
+      size_t len;
+      struct async_chunk_s*next;
+};
+
+static pthread_mutex_t async_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t async_idle = PTHREAD_COND_INITIALIZER;
+static struct async_chunk_s*async_head = 0;
+static struct async_chunk_s*async_tail = 0;
+  /* The number of chunks queued or being written. */
+static unsigned async_pending = 0;
+static bool async_running = false;
+static bool async_quit = false;
+static pthread_t async_thread;
+
+static void* async_writer(void*)
+{
+      pthread_mutex_lock(&async_mutex);
+      for (;;) {
+	    while (async_head == 0 && !async_quit)
+		  pthread_cond_wait(&async_work, &async_mutex);
+	    if (async_head == 0)
+		  break;
+
+	    struct async_chunk_s*cur = async_head;
+	    async_head = cur->next;
+	    if (async_head == 0) async_tail = 0;
+	    pthread_mutex_unlock(&async_mutex);
+
+	    fwrite(cur->data, 1, cur->len, cur->fp);
+	    free(cur->data);
+	    free(cur);
+
+	    pthread_mutex_lock(&async_mutex);
+	    async_pending -= 1;
+	    if (async_pending == 0)
+		  pthread_cond_broadcast(&async_idle);
+      }
+      pthread_mutex_unlock(&async_mutex);
+      return 0;
+}
+
+/*
+ * Hand the buffered output of the entry to the writer thread, which
+ * is started if it is not running.
+ */
+static void async_handoff(mcd_entry_s*ent)
+{
+      if (ent->alen == 0)
+	    return;
+
+      struct async_chunk_s*cur = (struct async_chunk_s*)
+	    malloc(sizeof(struct async_chunk_s));
+      cur->fp = ent->fp;
+      cur->data = ent->abuf;
+      cur->len = ent->alen;
+      cur->next = 0;
+      ent->abuf = (char*)malloc(ASYNC_BUF_SIZE);
+      ent->alen = 0;
+
+      pthread_mutex_lock(&async_mutex);
+      if (! async_running) {
+	    async_quit = false;
+	    if (pthread_create(&async_thread, 0, async_writer, 0) != 0) {
+		    /* Without a thread, write the output here. */
+		  pthread_mutex_unlock(&async_mutex);
+		  fwrite(cur->data, 1, cur->len, cur->fp);
+		  free(cur->data);
+		  free(cur);
+		  return;
+	    }
+	    async_running = true;
+      }
+      if (async_tail) async_tail->next = cur;
+      else async_head = cur;
+      async_tail = cur;
+      async_pending += 1;
+      pthread_cond_signal(&async_work);
+      pthread_mutex_unlock(&async_mutex);
+}
+
+/* Wait until the writer thread has written all the queued output. */
+static void async_wait(void)
+{
+      pthread_mutex_lock(&async_mutex);
+      while (async_pending > 0)
+	    pthread_cond_wait(&async_idle, &async_mutex);
+      pthread_mutex_unlock(&async_mutex);
+}
+#else
+static void async_handoff(mcd_entry_s*ent)
+{
+      fwrite(ent->abuf, 1, ent->alen, ent->fp);
+      ent->alen = 0;
+}
+
+static void async_wait(void)
+{
+}
+#endif
+
+/*
+ * Make all the output of the entry written to its FILE, so that the
+ * FILE can be used directly.
+ */
+static void async_sync(mcd_entry_s*ent)
+{
+      if (ent->abuf == 0)
+	    return;
+      async_handoff(ent);
+      async_wait();
+}
+
+static void async_start(mcd_entry_s*ent, const char*mode)
+{
+      ent->abuf = 0;
+      ent->alen = 0;
+	/* Files that are also read are used through their FILE. */
+      if (!async_flag || strchr(mode, 'r') || strchr(mode, '+'))
+	    return;
+      ent->abuf = (char*)malloc(ASYNC_BUF_SIZE);
+}
+
+static void async_finish(mcd_entry_s*ent)
+{
+      async_sync(ent);
+      free(ent->abuf);
+      ent->abuf = 0;
+}
+
+/* Write to the file of the entry, or to its buffer. */
+static void mcd_entry_write(mcd_entry_s*ent, const char*buf, size_t cnt)
+{
+      if (ent->abuf == 0) {
+	    fwrite(buf, 1, cnt, ent->fp);
+	    return;
+      }
+
+      while (ent->alen + cnt > ASYNC_BUF_SIZE) {
+	    size_t part = ASYNC_BUF_SIZE - ent->alen;
+	    memcpy(ent->abuf + ent->alen, buf, part);
+	    ent->alen += part;
+	    buf += part;
+	    cnt -= part;
+	    async_handoff(ent);
+      }
+      memcpy(ent->abuf + ent->alen, buf, cnt);
+      ent->alen += cnt;
+}
+
+/* Make all the output of all the entries written to their FILEs. */
+static void async_sync_all(void)
+{
+      for (unsigned idx = 0; idx < 31; idx += 1) {
+	    if (mcd_table[idx].abuf) async_handoff(mcd_table+idx);
+      }
+      for (unsigned idx = 0; idx < fd_table_len; idx += 1) {
+	    if (fd_table[idx].abuf) async_handoff(fd_table+idx);
+      }
+      async_wait();
+}
+
+/*
+ * Write out all the buffered output and stop the writer thread. The
+ * thread is started again if there is more output.
+ */
+void vpip_mcd_sync(void)
+{
+      async_sync_all();
+
+#ifdef HAVE_LIBPTHREAD
+      pthread_mutex_lock(&async_mutex);
+      bool running = async_running;
+      async_quit = true;
+      async_running = false;
+      pthread_cond_signal(&async_work);
+      pthread_mutex_unlock(&async_mutex);
+      if (running) pthread_join(async_thread, 0);
+#endif
+}
+
+static void vpip_mcd_sync_at_exit(void)
+{
+      vpip_mcd_sync();
+}
+
 /* Initialize mcd portion of vpi.  Must be called before
  * any vpi_mcd routines can be used.
  */
-void vpip_mcd_init(FILE *log)
+void vpip_mcd_init(FILE *log, bool async)
 {
       fd_table_len = FD_INCR;
       fd_table = (mcd_entry_s *) malloc(fd_table_len*sizeof(mcd_entry_s));
       for (unsigned idx = 0; idx < fd_table_len; idx += 1) {
 	    fd_table[idx].fp = NULL;
 	    fd_table[idx].filename = NULL;
+	    fd_table[idx].abuf = NULL;
+	    fd_table[idx].alen = 0;
       }
 
       mcd_table[0].fp = stdout;
@@ -78,6 +291,9 @@ void vpip_mcd_init(FILE *log)
       fd_table[2].filename = strdup("stderr");
 
       logfile = log;
+
+      async_flag = async;
+      if (async_flag) atexit(vpip_mcd_sync_at_exit);
 }
 
 #ifdef CHECK_WITH_VALGRIND
@@ -117,6 +333,7 @@ extern "C" PLI_UINT32 vpi_mcd_close(PLI_UINT32 mcd)
 	    for(int i = 1; i < 31; i++) {
 		  if ((mcd>>i) & 1) {
 			if (mcd_table[i].fp) {
+			      async_finish(mcd_table+i);
 			      if (fclose(mcd_table[i].fp)) rc |= 1<<i;
 			      free(mcd_table[i].filename);
 			      mcd_table[i].fp = NULL;
@@ -129,6 +346,7 @@ extern "C" PLI_UINT32 vpi_mcd_close(PLI_UINT32 mcd)
       } else {
 	    unsigned idx = FD_IDX(mcd);
 	    if (idx > 2 && idx < fd_table_len && fd_table[idx].fp) {
+		  async_finish(fd_table+idx);
 		  if (fclose(fd_table[idx].fp)) rc = mcd;
 		  free(fd_table[idx].filename);
 		  fd_table[idx].fp = NULL;
@@ -175,6 +393,7 @@ got_entry:
 	if(mcd_table[i].fp == NULL)
 		return 0;
 	mcd_table[i].filename = strdup(name);
+	async_start(mcd_table+i, "w");
 
 	if (vpi_trace) {
 	      fprintf(vpi_trace, "vpi_mcd_open(%s) --> 0x%08x\n",
@@ -213,6 +432,11 @@ vpi_mcd_vprintf(PLI_UINT32 mcd, const char*fmt, va_list ap)
 	    rc = vsnprintf(buf_ptr, rc+1, fmt, saved_ap);
       }
       va_end(saved_ap);
+      if (rc < 0) {
+	    if (need_free) free(buf_ptr);
+	    return EOF;
+      }
+      size_t len = rc;
 
       for(int i = 0; i < 31; i++) {
 	    if((mcd>>i) & 1) {
@@ -220,7 +444,7 @@ vpi_mcd_vprintf(PLI_UINT32 mcd, const char*fmt, va_list ap)
 			  // echo to logfile
 			if (i == 0 && logfile)
 			      fputs(buf_ptr, logfile);
-			fputs(buf_ptr, mcd_table[i].fp);
+			mcd_entry_write(mcd_table+i, buf_ptr, len);
 		  } else {
 			rc = EOF;
 		  }
@@ -242,7 +466,12 @@ extern "C" PLI_INT32 vpi_mcd_printf(PLI_UINT32 mcd, const char *fmt, ...)
 
 extern "C" void vpip_mcd_rawwrite(PLI_UINT32 mcd, const char*buf, size_t cnt)
 {
-      if (!IS_MCD(mcd)) return;
+      if (!IS_MCD(mcd)) {
+	    unsigned idx = FD_IDX(mcd);
+	    if (idx < fd_table_len && fd_table[idx].fp)
+		  mcd_entry_write(fd_table+idx, buf, cnt);
+	    return;
+      }
 
       for(int idx = 0; idx < 31; idx += 1) {
 	    if (((mcd>>idx) & 1) == 0)
@@ -251,27 +480,37 @@ extern "C" void vpip_mcd_rawwrite(PLI_UINT32 mcd, const char*buf, size_t cnt)
 	    if (mcd_table[idx].fp == 0)
 		  continue;
 
-	    fwrite(buf, 1, cnt, mcd_table[idx].fp);
+	    mcd_entry_write(mcd_table+idx, buf, cnt);
 	    if (idx == 0 && logfile)
 		  fwrite(buf, 1, cnt, logfile);
 
       }
 }
 
+/*
+ * As an extension, an mcd of zero flushes all the open files.
+ */
 extern "C" PLI_INT32 vpi_mcd_flush(PLI_UINT32 mcd)
 {
 	int rc = 0;
 
-	if (IS_MCD(mcd)) {
+	if (mcd == 0) {
+		async_sync_all();
+		rc = fflush(NULL);
+	} else if (IS_MCD(mcd)) {
 		for(int i = 0; i < 31; i++) {
 			if((mcd>>i) & 1) {
 				if (i == 0 && logfile) fflush(logfile);
+				async_sync(mcd_table+i);
 				if (fflush(mcd_table[i].fp)) rc |= 1<<i;
 			}
 		}
 	} else {
 		unsigned idx = FD_IDX(mcd);
-		if (idx < fd_table_len) rc = fflush(fd_table[idx].fp);
+		if (idx < fd_table_len) {
+			async_sync(fd_table+idx);
+			rc = fflush(fd_table[idx].fp);
+		}
 	}
 	return rc;
 }
@@ -305,6 +544,8 @@ extern "C" PLI_INT32 vpi_fopen(const char*name, const char*mode)
       for (unsigned idx = i; idx < fd_table_len; idx += 1) {
 	    fd_table[idx].fp = NULL;
 	    fd_table[idx].filename = NULL;
+	    fd_table[idx].abuf = NULL;
+	    fd_table[idx].alen = 0;
       }
 
 got_entry:
@@ -318,6 +559,7 @@ got_entry:
 #endif
       if (fd_table[i].fp == NULL) return 0;
       fd_table[i].filename = strdup(name);
+      async_start(fd_table+i, mode);
       return ((1U<<31)|i);
 }
 
@@ -329,5 +571,7 @@ extern "C" FILE *vpi_get_file(PLI_INT32 fd)
 	// Only know about fd_table_len indices
       if (FD_IDX(fd) >= fd_table_len) return NULL;
 
+	// The caller uses the FILE directly.
+      async_sync(fd_table+FD_IDX(fd));
       return fd_table[FD_IDX(fd)].fp;
 }
@@ -1746,5 +1746,8 @@ vpip_routines_s vpi_routines = {
     .make_systf_system_defined  = vpip_make_systf_system_defined,
     .mcd_rawwrite               = vpip_mcd_rawwrite,
     .set_return_value           = vpip_set_return_value,
+    .fork_server                = vpip_fork_server,
+    .get_vecval_multi           = vpip_get_vecval_multi,
+    .get_return_value           = vpip_get_return_value,
 };
 #endif
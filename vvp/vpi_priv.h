@@ -617,7 +617,7 @@ class __vpiStringVar : public __vpiBaseVar {
 extern vpiHandle vpip_make_string_var(const char*name, vvp_net_t*net);
 
 struct __vpiArrayBase {
-      __vpiArrayBase() : vals_words(NULL) {}
+      __vpiArrayBase() {}
       virtual ~__vpiArrayBase() {}
 
       virtual unsigned get_size(void) const = 0;
@@ -637,9 +637,14 @@ struct __vpiArrayBase {
     // code in the following function
       vpiHandle vpi_array_base_iterate(int code);
 
-      virtual void make_vals_words();
+	// Return the handle for the word at the index, making it (and
+	// the other handles of its page) the first time it is asked for.
+      vpiHandle get_vals_word(unsigned idx);
+      void delete_vals_words();
 
-      struct __vpiArrayWord*vals_words;
+    private:
+      enum { VALS_WORDS_PAGE = 1024 };
+      std::vector<struct __vpiArrayWord*> vals_words;
 };
 
 /*
@@ -660,12 +665,12 @@ struct __vpiArrayBase {
 * - Array of vector4 words.
 * In this case, the nets pointer is nil, and the vals4 member points
 * to a vvl_vector4array_t object that is a compact representation of
-* an array of vvp_vector4_t vectors.
+* an array of vvp_vector4_t vectors. For a static array the words are
+* kept in pages that are allocated when they are first written.
 *
 * - Array of real variables
-* The vals member points to a dynamic array objects that has an
-* array of double variables. This is very much like the way the
-* vector4 array works.
+* The vals member points to a vvp_darray_real_sparse object that
+* keeps the double variables in pages, like the vector4 array.
 */
 struct __vpiArray : public __vpiArrayBase, public __vpiHandle {
       int get_type_code(void) const { return vpiMemory; }
@@ -914,6 +919,15 @@ extern void vpip_clear_module_paths();
 extern void vpip_add_module_path(const char *path);
 extern void vpip_add_env_and_default_module_paths();
 
+/*
+ * With the -a flag, the files that the design opens for writing are
+ * written by a writer thread. This function writes out all the output
+ * that is still buffered for that thread and stops the thread, which
+ * is started again if there is more output. It is called when the
+ * simulation ends, and before the simulation forks.
+ */
+extern void vpip_mcd_sync(void);
+
 /*
  * The vpip_build_vpi_call function creates a __vpiSysTaskCall object
  * and returns the handle. The compiler uses this function when it
@@ -159,6 +159,25 @@ static void format_vpiBinStrVal(vvp_signal_value*sig, int base, unsigned wid,
       long offset = end - 1;
       long ssize = (signed)sig->value_size();
 
+	/* For more than a single bit, get the whole value at once
+	   instead of a bit at a time through the signal. This is the
+	   format that the waveform dumpers ask for on every change. */
+      if (wid > 1) {
+	    vvp_vector4_t vec4;
+	    sig->vec4_value(vec4);
+	    for (long idx = base ;  idx < end ;  idx += 1) {
+		  if (idx < 0 || idx >= ssize) {
+			rbuf[offset-idx] = 'x';
+		  } else {
+			rbuf[offset-idx] = vvp_bit4_to_ascii(vec4.value(idx));
+		  }
+	    }
+	    rbuf[wid] = 0;
+
+	    vp->value.str = rbuf;
+	    return;
+      }
+
       for (long idx = base ;  idx < end ;  idx += 1) {
 	    if (idx < 0 || idx >= ssize) {
                   rbuf[offset-idx] = 'x';
@@ -496,6 +515,14 @@ static void format_vpiVectorVal(vvp_signal_value*sig, int base, unsigned wid,
                          need_result_buf(hwid * sizeof(s_vpi_vecval), RBUF_VAL);
       vp->value.vector = op;
 
+	/* The whole value can be copied a word at a time. */
+      if (base == 0 && wid == sig->value_size()) {
+	    vvp_vector4_t tmp;
+	    sig->vec4_value(tmp);
+	    tmp.get_vecval(op);
+	    return;
+      }
+
       op->aval = op->bval = 0;
       for (long idx = base ;  idx < end ;  idx += 1) {
 	    if (base >= 0 && base < (signed)sig->value_size()) {
@@ -904,6 +931,49 @@ static void signal_get_value(vpiHandle ref, s_vpi_value*vp)
       }
 }
 
+/*
+ * This is an Icarus extension that gets the values of many objects
+ * in one call. The values are written one after the other into the
+ * vals array that the caller passes, each as (vpiSize+31)/32 vector
+ * words, and the return value is the number of words written. The
+ * values are copied straight from the signal into vals, and not
+ * through the result buffer that vpi_get_value uses, so a callback
+ * can keep its own buffer and read the same set of signals at each
+ * cbReadOnlySynch without any other allocation.
+ *
+ * Only signals with vector values can be read this way. If any of
+ * the objects is something else, for example a real variable or a
+ * part select, this returns -1 and the caller must read that object
+ * with vpi_get_value.
+ */
+extern "C" PLI_INT32 vpip_get_vecval_multi(PLI_INT32 count,
+					   const vpiHandle*refs,
+					   s_vpi_vecval*vals)
+{
+      s_vpi_vecval*op = vals;
+      vvp_vector4_t tmp;
+
+      for (PLI_INT32 idx = 0 ;  idx < count ;  idx += 1) {
+	    struct __vpiSignal*rfp = dynamic_cast<__vpiSignal*>(refs[idx]);
+	    if (rfp == 0)
+		  return -1;
+
+	    vvp_signal_value*vsig = dynamic_cast<vvp_signal_value*>(rfp->node->fil);
+	    if (vsig == 0)
+		  return -1;
+
+	    unsigned wid = rfp->width();
+	    if (vsig->value_size() != wid)
+		  return -1;
+
+	    vsig->vec4_value(tmp);
+	    tmp.get_vecval(op);
+	    op += (wid + 31) / 32;
+      }
+
+      return op - vals;
+}
+
 /*
  * The put_value method writes the value into the vector, and returns
  * the affected ref. This operation works much like the %set or
@@ -31,6 +31,8 @@
 #ifdef CHECK_WITH_VALGRIND
 # include  "vvp_cleanup.h"
 #endif
+# include  <algorithm>
+# include  <map>
 # include  <set>
 # include  <typeinfo>
 # include  <vector>
@@ -113,44 +115,103 @@ struct vthread_s {
       vector<unsigned> args_vec4;
 
     private:
+	// The vec4 stack is the first stack_vec4_size_ entries of the
+	// stack_vec4_ array. Popped entries are not destroyed, but
+	// are kept with their word storage so that later pushes of
+	// vectors the same width can reuse it without going to the
+	// heap.
       vector<vvp_vector4_t>stack_vec4_;
+      unsigned stack_vec4_size_;
+
+	// Vectors that fit in a word have no word storage, and wider
+	// vectors can reuse storage with the same number of words.
+      static inline unsigned vec4_words_(unsigned wid)
+      {
+	    const unsigned bits = 8*sizeof(unsigned long);
+	    return wid <= bits? 0 : (wid+bits-1) / bits;
+      }
+	// Get the next free slot ready to hold a vector of the given
+	// width. If the slot does not have matching storage, look for
+	// a retained slot that does and swap it into place, so that
+	// mixing narrow and wide values on the stack does not keep
+	// freeing and allocating the wide storage. If there is none,
+	// then move the storage of this slot to a new spare slot at
+	// the end, so long as that does not grow the array (which
+	// may hold the value being pushed) and there are not already
+	// too many spares.
+      inline void prepare_vec4_(unsigned wid)
+      {
+	    unsigned nwords = vec4_words_(wid);
+	    unsigned top = stack_vec4_size_;
+	    unsigned have = vec4_words_(stack_vec4_[top].size());
+	    if (have == nwords)
+		  return;
+	    for (unsigned idx = top+1 ; idx < stack_vec4_.size() ; idx += 1) {
+		  if (vec4_words_(stack_vec4_[idx].size()) == nwords) {
+			stack_vec4_[top].swap(stack_vec4_[idx]);
+			return;
+		  }
+	    }
+	    if (have == 0)
+		  return;
+	    if (stack_vec4_.size() == stack_vec4_.capacity())
+		  return;
+	    if (stack_vec4_.size() >= top + 8)
+		  return;
+	    stack_vec4_.push_back(vvp_vector4_t());
+	    stack_vec4_.back().swap(stack_vec4_[top]);
+      }
     public:
       inline vvp_vector4_t pop_vec4(void)
       {
-	    assert(! stack_vec4_.empty());
-	    vvp_vector4_t val = stack_vec4_.back();
-	    stack_vec4_.pop_back();
-	    return val;
+	    assert(stack_vec4_size_ > 0);
+	    stack_vec4_size_ -= 1;
+	    return stack_vec4_[stack_vec4_size_];
+      }
+	// Make room for a new top of the stack, that the caller will
+	// assign a value of the given width into.
+      inline vvp_vector4_t& reserve_vec4(unsigned wid)
+      {
+	    if (stack_vec4_size_ == stack_vec4_.size())
+		  stack_vec4_.push_back(vvp_vector4_t());
+	    else
+		  prepare_vec4_(wid);
+	    stack_vec4_size_ += 1;
+	    return stack_vec4_[stack_vec4_size_-1];
       }
       inline void push_vec4(const vvp_vector4_t&val)
       {
-	    stack_vec4_.push_back(val);
+	    if (stack_vec4_size_ == stack_vec4_.size()) {
+		  stack_vec4_.push_back(val);
+	    } else {
+		  prepare_vec4_(val.size());
+		  stack_vec4_[stack_vec4_size_] = val;
+	    }
+	    stack_vec4_size_ += 1;
       }
-      inline const vvp_vector4_t& peek_vec4(unsigned depth)
+      inline vvp_vector4_t& peek_vec4(unsigned depth)
       {
-	    unsigned size = stack_vec4_.size();
+	    unsigned size = stack_vec4_size_;
 	    assert(depth < size);
 	    unsigned use_index = size-1-depth;
 	    return stack_vec4_[use_index];
       }
       inline vvp_vector4_t& peek_vec4(void)
       {
-	    unsigned use_index = stack_vec4_.size();
+	    unsigned use_index = stack_vec4_size_;
 	    assert(use_index >= 1);
 	    return stack_vec4_[use_index-1];
       }
       inline void poke_vec4(unsigned depth, const vvp_vector4_t&val)
       {
-	    assert(depth < stack_vec4_.size());
-	    unsigned use_index = stack_vec4_.size()-1-depth;
+	    assert(depth < stack_vec4_size_);
+	    unsigned use_index = stack_vec4_size_-1-depth;
 	    stack_vec4_[use_index] = val;
       }
       inline void pop_vec4(unsigned cnt)
       {
-	    while (cnt > 0) {
-		  stack_vec4_.pop_back();
-		  cnt -= 1;
-	    }
+	    assert(cnt <= stack_vec4_size_);
+	    stack_vec4_size_ -= cnt;
       }
 
 
@@ -299,14 +360,14 @@ struct vthread_s {
       inline void cleanup()
       {
 	    if (i_was_disabled) {
-		  stack_vec4_.clear();
+		  stack_vec4_size_ = 0;
 		  stack_real_.clear();
 		  stack_str_.clear();
 		  pop_object(stack_obj_size_);
 	    }
 	    free(filenm_);
 	    filenm_ = 0;
-	    assert(stack_vec4_.empty());
+	    assert(stack_vec4_size_ == 0);
 	    assert(stack_real_.empty());
 	    assert(stack_str_.empty());
 	    assert(stack_obj_size_ == 0);
@@ -315,6 +376,8 @@ struct vthread_s {
 
 inline vthread_s::vthread_s()
 {
+      stack_vec4_.reserve(8);
+      stack_vec4_size_ = 0;
       stack_obj_size_ = 0;
       filenm_ = 0;
       lineno_ = 0;
@@ -350,8 +413,8 @@ void vthread_s::debug_dump(ostream&fd, const char*label)
 	    fd << flags[idx];
       fd << endl;
       fd << "**** vec4 stack..." << endl;
-      for (size_t idx = stack_vec4_.size() ; idx > 0 ; idx -= 1)
-	    fd << "    " << (stack_vec4_.size()-idx) << ": " << stack_vec4_[idx-1] << endl;
+      for (size_t idx = stack_vec4_size_ ; idx > 0 ; idx -= 1)
+	    fd << "    " << (stack_vec4_size_-idx) << ": " << stack_vec4_[idx-1] << endl;
       fd << "**** str stack (" << stack_str_.size() << ")..." << endl;
       fd << "**** obj stack (" << stack_obj_size_ << ")..." << endl;
       fd << "**** args_vec4 array (" << args_vec4.size() << ")..." << endl;
@@ -785,6 +848,129 @@ void vthread_delay_delete()
 	    running_thread->delay_delete = 1;
 }
 
+/*
+ * These are the counts that the profiling run loop collects. A block
+ * is entered whenever a thread starts or resumes, or an instruction
+ * jumps, and the block is identified by the address of its first
+ * instruction. The scope is the scope of the first thread that
+ * entered the block, to help the report say where the code came from.
+ */
+struct profile_block_s {
+      unsigned long count;
+      __vpiScope*scope;
+};
+
+static bool profile_flag = false;
+static map<vvp_code_fun,unsigned long> profile_opcodes;
+static map<vvp_code_t,profile_block_s> profile_blocks;
+
+void vthread_enable_profile(void)
+{
+      profile_flag = true;
+}
+
+/*
+ * Count the instruction that the profiling loop is about to run. The
+ * next is the instruction after the last one that the thread ran, or
+ * nil if the thread just started or resumed. A new block is counted
+ * if this instruction is not that one, unless the last was only the
+ * link to the next chunk of code.
+ */
+static void profile_count(vthread_t thr, vvp_code_t cp, vvp_code_t next)
+{
+      if (cp != next && (next == 0 || next[-1].opcode != &of_CHUNK_LINK)) {
+	    profile_block_s&blk = profile_blocks[cp];
+	    if (blk.count == 0)
+		  blk.scope = thr->parent_scope;
+	    blk.count += 1;
+      }
+      profile_opcodes[cp->opcode] += 1;
+}
+
+/*
+ * This is vthread_run with the counting added. It is a loop of its
+ * own so that the default run loop does not test for profiling at
+ * every instruction.
+ */
+static void vthread_run_profile(vthread_t thr)
+{
+      while (thr != 0) {
+	    vthread_t tmp = thr->wait_next;
+	    thr->wait_next = 0;
+
+	    assert(thr->is_scheduled);
+	    thr->is_scheduled = 0;
+
+            running_thread = thr;
+
+	    vvp_code_t next = 0;
+	    for (;;) {
+		  vvp_code_t cp = thr->pc;
+		  thr->pc += 1;
+
+		  profile_count(thr, cp, next);
+
+		  bool rc = (cp->opcode)(thr, cp);
+		  if (rc == false)
+			break;
+
+		  next = cp + 1;
+	    }
+
+	    thr = tmp;
+      }
+      running_thread = 0;
+}
+
+template <class T> static bool profile_count_greater(const pair<unsigned long,T>&a,
+						     const pair<unsigned long,T>&b)
+{
+      return a.first > b.first;
+}
+
+void vthread_profile_report(void)
+{
+      if (! profile_flag)
+	    return;
+
+      unsigned long total = 0;
+      vector<pair<unsigned long,vvp_code_fun> > opcodes;
+      for (map<vvp_code_fun,unsigned long>::const_iterator cur = profile_opcodes.begin()
+		 ; cur != profile_opcodes.end() ; ++ cur) {
+	    opcodes.push_back(pair<unsigned long,vvp_code_fun>(cur->second, cur->first));
+	    total += cur->second;
+      }
+      sort(opcodes.begin(), opcodes.end(), profile_count_greater<vvp_code_fun>);
+
+      if (total == 0)
+	    return;
+
+      fprintf(stderr, "Opcode profile (%lu opcodes executed):\n", total);
+      for (size_t idx = 0 ; idx < opcodes.size() && idx < 20 ; idx += 1) {
+	    const char*name = compile_opcode_name(opcodes[idx].second);
+	    fprintf(stderr, "    %12lu %5.1f%%  %s\n", opcodes[idx].first,
+		    100.0 * opcodes[idx].first / total,
+		    name? name : "(internal)");
+      }
+
+      vector<pair<unsigned long,vvp_code_t> > blocks;
+      for (map<vvp_code_t,profile_block_s>::const_iterator cur = profile_blocks.begin()
+		 ; cur != profile_blocks.end() ; ++ cur) {
+	    blocks.push_back(pair<unsigned long,vvp_code_t>(cur->second.count, cur->first));
+      }
+      sort(blocks.begin(), blocks.end(), profile_count_greater<vvp_code_t>);
+
+      fprintf(stderr, "Hot blocks (%zu blocks entered):\n", blocks.size());
+      for (size_t idx = 0 ; idx < blocks.size() && idx < 10 ; idx += 1) {
+	    vvp_code_t code = blocks[idx].second;
+	    const char*name = compile_opcode_name(code->opcode);
+	    __vpiScope*scope = profile_blocks[code].scope;
+	    fprintf(stderr, "    %12lu  %-16s in %s\n", blocks[idx].first,
+		    name? name : "(internal)",
+		    scope? scope->vpi_get_str(vpiFullName) : "(root)");
+      }
+}
+
 /*
  * This function runs each thread by fetching an instruction,
  * incrementing the PC, and executing the instruction. The thread may
@@ -792,6 +978,11 @@ void vthread_delay_delete()
  */
 void vthread_run(vthread_t thr)
 {
+      if (profile_flag) {
+	    vthread_run_profile(thr);
+	    return;
+      }
+
       while (thr != 0) {
 	    vthread_t tmp = thr->wait_next;
 	    thr->wait_next = 0;
@@ -829,6 +1020,92 @@ bool of_CHUNK_LINK(vthread_t thr, vvp_code_t code)
       return true;
 }
 
+/*
+ * A superinstruction does the work of two adjacent opcodes with a
+ * single dispatch through the run loop. The first opcode of the pair
+ * must be one that always returns true and does not touch the thread
+ * pc, so that running it and then the second opcode in place is the
+ * same as running them one after the other. The second opcode may do
+ * anything, including jump or yield the thread, so it is run with the
+ * pc set just as if it were dispatched normally.
+ *
+ * The codespace_fuse pass writes these into the first instruction of
+ * a pair. The second instruction is left alone so that jumps to it
+ * still work.
+ */
+template <vvp_code_fun FIRST, vvp_code_fun SECOND>
+static bool of_FUSED(vthread_t thr, vvp_code_t cp)
+{
+      FIRST(thr, cp);
+      thr->pc = cp + 2;
+      return SECOND(thr, cp + 1);
+}
+
+struct fused_opcode_s {
+      vvp_code_fun first;
+      vvp_code_fun second;
+      vvp_code_fun fused;
+};
+
+# define FUSE(a, b) { &a, &b, &of_FUSED<&a, &b> }
+# define FUSE_CMP(a) FUSE(a, of_JMP0), FUSE(a, of_JMP0XZ), \
+		     FUSE(a, of_JMP1), FUSE(a, of_JMP1XZ)
+
+/*
+ * These are the opcode pairs that tgt-vvp most often emits next to
+ * each other: loading operands, storing and assigning results, and
+ * compares that feed a conditional jump.
+ */
+static const struct fused_opcode_s fused_table[] = {
+      FUSE(of_LOAD_VEC4,  of_ASSIGN_VEC4),
+      FUSE(of_LOAD_VEC4,  of_STORE_VEC4),
+      FUSE(of_LOAD_VEC4,  of_LOAD_VEC4),
+      FUSE(of_LOAD_VEC4,  of_PUSHI_VEC4),
+      FUSE(of_LOAD_VEC4,  of_ADD),
+      FUSE(of_LOAD_VEC4,  of_SUB),
+      FUSE(of_LOAD_VEC4,  of_AND),
+      FUSE(of_LOAD_VEC4,  of_OR),
+      FUSE(of_LOAD_VEC4,  of_XOR),
+      FUSE(of_LOAD_VEC4,  of_CMPE),
+      FUSE(of_LOAD_VEC4,  of_CMPNE),
+      FUSE(of_LOAD_VEC4,  of_CMPS),
+      FUSE(of_LOAD_VEC4,  of_CMPU),
+      FUSE(of_PUSHI_VEC4, of_ASSIGN_VEC4),
+      FUSE(of_PUSHI_VEC4, of_STORE_VEC4),
+      FUSE(of_PUSHI_VEC4, of_ADD),
+      FUSE(of_PUSHI_VEC4, of_SUB),
+      FUSE(of_PUSHI_VEC4, of_CMPE),
+      FUSE(of_PUSHI_VEC4, of_CMPNE),
+      FUSE(of_PUSHI_VEC4, of_CMPS),
+      FUSE(of_PUSHI_VEC4, of_CMPU),
+      FUSE(of_ADDI,       of_STORE_VEC4),
+      FUSE(of_SUBI,       of_STORE_VEC4),
+      FUSE_CMP(of_CMPE),
+      FUSE_CMP(of_CMPNE),
+      FUSE_CMP(of_CMPIE),
+      FUSE_CMP(of_CMPINE),
+      FUSE_CMP(of_CMPS),
+      FUSE_CMP(of_CMPIS),
+      FUSE_CMP(of_CMPU),
+      FUSE_CMP(of_CMPIU),
+      FUSE_CMP(of_CMPX),
+      FUSE_CMP(of_CMPZ),
+      { 0, 0, 0 }
+};
+
+# undef FUSE_CMP
+# undef FUSE
+
+vvp_code_fun vthread_fused_opcode(vvp_code_fun first, vvp_code_fun second)
+{
+      for (const struct fused_opcode_s*cur = fused_table ; cur->first ; cur += 1) {
+	    if (cur->first == first && cur->second == second)
+		  return cur->fused;
+      }
+
+      return 0;
+}
+
 /*
  * This is called by an event functor to wake up all the threads on
  * its list. I in fact created that list in the %wait instruction, and
@@ -895,10 +1172,11 @@ bool of_ALLOC(vthread_t thr, vvp_code_t cp)
 
 bool of_AND(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valb = thr->pop_vec4();
-      vvp_vector4_t&vala = thr->peek_vec4();
+      const vvp_vector4_t&valb = thr->peek_vec4(0);
+      vvp_vector4_t&vala = thr->peek_vec4(1);
       assert(vala.size() == valb.size());
       vala &= valb;
+      thr->pop_vec4(1);
       return true;
 }
 
@@ -964,13 +1242,14 @@ static void get_immediate_rval(vvp_code_t cp, vvp_vector4_t&val)
  */
 bool of_ADD(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t r = thr->pop_vec4();
-	// Rather then pop l, use it directly from the stack. When we
-	// assign to 'l', that will edit the top of the stack, which
-	// replaces a pop and a pull.
-      vvp_vector4_t&l = thr->peek_vec4();
+	// Rather then pop r and l, use them directly from the
+	// stack. When we assign to 'l', that will edit the stack in
+	// place, and popping r leaves l as the new top of the stack.
+      const vvp_vector4_t&r = thr->peek_vec4(0);
+      vvp_vector4_t&l = thr->peek_vec4(1);
 
       l.add(r);
+      thr->pop_vec4(1);
 
       return true;
 }
@@ -2016,6 +2295,10 @@ static void of_CMPU_the_hard_way(vthread_t thr, unsigned wid,
       thr->flags[6] = eeq;
 }
 
+/* Compares of vectors up to this many words wide work in arrays on
+   the C stack instead of the heap. */
+static const unsigned CMP_STACK_WORDS = 16;
+
 static void do_CMPU(vthread_t thr, const vvp_vector4_t&lval, const vvp_vector4_t&rval)
 {
       vvp_bit4_t eq = BIT4_1;
@@ -2029,18 +2312,22 @@ static void do_CMPU(vthread_t thr, const vvp_vector4_t&lval, const vvp_vector4_t
       assert(rval.size() == lval.size());
       unsigned wid = lval.size();
 
-      unsigned long*larray = lval.subarray(0,wid);
-      if (larray == 0) return of_CMPU_the_hard_way(thr, wid, lval, rval);
+      unsigned words = (wid+CPU_WORD_BITS-1) / CPU_WORD_BITS;
 
-      unsigned long*rarray = rval.subarray(0,wid);
-      if (rarray == 0) {
-	    delete[]larray;
-	    return of_CMPU_the_hard_way(thr, wid, lval, rval);
+	// Get the binary values into arrays on the stack, unless the
+	// vectors are too wide for that.
+      unsigned long lbuf[CMP_STACK_WORDS], rbuf[CMP_STACK_WORDS];
+      unsigned long*larray = lbuf;
+      unsigned long*rarray = rbuf;
+      if (words > CMP_STACK_WORDS) {
+	    larray = new unsigned long[words];
+	    rarray = new unsigned long[words];
       }
 
-      unsigned words = (wid+CPU_WORD_BITS-1) / CPU_WORD_BITS;
+      bool defined_flag = lval.subarray_to(larray, 0, wid)
+			&& rval.subarray_to(rarray, 0, wid);
 
-      for (unsigned wdx = 0 ; wdx < words ; wdx += 1) {
+      if (defined_flag) for (unsigned wdx = 0 ; wdx < words ; wdx += 1) {
 	    if (larray[wdx] == rarray[wdx])
 		  continue;
 
@@ -2051,8 +2338,13 @@ static void do_CMPU(vthread_t thr, const vvp_vector4_t&lval, const vvp_vector4_t
 		  lt = BIT4_0;
       }
 
-      delete[]larray;
-      delete[]rarray;
+      if (larray != lbuf) {
+	    delete[]larray;
+	    delete[]rarray;
+      }
+
+      if (! defined_flag)
+	    return of_CMPU_the_hard_way(thr, wid, lval, rval);
 
       thr->flags[4] = eq;
       thr->flags[5] = lt;
@@ -3931,12 +4223,6 @@ bool of_LOAD_STRA(vthread_t thr, vvp_code_t cp)
  */
 bool of_LOAD_VEC4(vthread_t thr, vvp_code_t cp)
 {
-	// Push a placeholder onto the stack in order to reserve the
-	// stack space. Use a reference for the stack top as a target
-	// for the load.
-      thr->push_vec4(vvp_vector4_t());
-      vvp_vector4_t&sig_value = thr->peek_vec4();
-
       vvp_net_t*net = cp->net;
 
 	// For the %load to work, the functor must actually be a
@@ -3949,8 +4235,12 @@ bool of_LOAD_VEC4(vthread_t thr, vvp_code_t cp)
 	    assert(sig);
       }
 
-	// Extract the value from the signal and directly into the
-	// target stack position.
+	// Reserve the stack space and use a reference for the stack
+	// top as a target for the load. The reserved slot may still
+	// have word storage from an earlier value, which the load can
+	// reuse. Extract the value from the signal and directly into
+	// the target stack position.
+      vvp_vector4_t&sig_value = thr->reserve_vec4(sig->value_size());
       sig->vec4_value(sig_value);
 
       return true;
@@ -4462,8 +4752,8 @@ bool of_MUL_WR(vthread_t thr, vvp_code_t)
 
 bool of_NAND(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valr = thr->pop_vec4();
-      vvp_vector4_t&vall = thr->peek_vec4();
+      const vvp_vector4_t&valr = thr->peek_vec4(0);
+      vvp_vector4_t&vall = thr->peek_vec4(1);
       assert(vall.size() == valr.size());
       unsigned wid = vall.size();
 
@@ -4473,6 +4763,7 @@ bool of_NAND(vthread_t thr, vvp_code_t)
 	    vall.set_bit(idx, ~(lb&rb));
       }
 
+      thr->pop_vec4(1);
       return true;
 }
 
@@ -4715,9 +5006,10 @@ bool of_XNORR(vthread_t thr, vvp_code_t)
  */
 bool of_OR(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valb = thr->pop_vec4();
-      vvp_vector4_t&vala = thr->peek_vec4();
+      const vvp_vector4_t&valb = thr->peek_vec4(0);
+      vvp_vector4_t&vala = thr->peek_vec4(1);
       vala |= valb;
+      thr->pop_vec4(1);
       return true;
 }
 
@@ -4726,8 +5018,8 @@ bool of_OR(vthread_t thr, vvp_code_t)
  */
 bool of_NOR(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valr = thr->pop_vec4();
-      vvp_vector4_t&vall = thr->peek_vec4();
+      const vvp_vector4_t&valr = thr->peek_vec4(0);
+      vvp_vector4_t&vall = thr->peek_vec4(1);
       assert(vall.size() == valr.size());
       unsigned wid = vall.size();
 
@@ -4737,6 +5029,7 @@ bool of_NOR(vthread_t thr, vvp_code_t)
 	    vall.set_bit(idx, ~(lb|rb));
       }
 
+      thr->pop_vec4(1);
       return true;
 }
 
@@ -6359,10 +6652,11 @@ bool of_STORE_VEC4A(vthread_t thr, vvp_code_t cp)
  */
 bool of_SUB(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t r = thr->pop_vec4();
-      vvp_vector4_t&l = thr->peek_vec4();
+      const vvp_vector4_t&r = thr->peek_vec4(0);
+      vvp_vector4_t&l = thr->peek_vec4(1);
 
       l.sub(r);
+      thr->pop_vec4(1);
       return true;
 }
 
@@ -6609,8 +6903,8 @@ bool of_WAIT_FORK(vthread_t thr, vvp_code_t)
  */
 bool of_XNOR(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valr = thr->pop_vec4();
-      vvp_vector4_t&vall = thr->peek_vec4();
+      const vvp_vector4_t&valr = thr->peek_vec4(0);
+      vvp_vector4_t&vall = thr->peek_vec4(1);
       assert(vall.size() == valr.size());
       unsigned wid = vall.size();
 
@@ -6621,6 +6915,7 @@ bool of_XNOR(vthread_t thr, vvp_code_t)
 	    vall.set_bit(idx, ~(lb ^ rb));
       }
 
+      thr->pop_vec4(1);
       return true;
 }
 
@@ -6629,8 +6924,8 @@ bool of_XNOR(vthread_t thr, vvp_code_t)
  */
 bool of_XOR(vthread_t thr, vvp_code_t)
 {
-      vvp_vector4_t valr = thr->pop_vec4();
-      vvp_vector4_t&vall = thr->peek_vec4();
+      const vvp_vector4_t&valr = thr->peek_vec4(0);
+      vvp_vector4_t&vall = thr->peek_vec4(1);
       assert(vall.size() == valr.size());
       unsigned wid = vall.size();
 
@@ -6641,6 +6936,7 @@ bool of_XOR(vthread_t thr, vvp_code_t)
 	    vall.set_bit(idx, lb ^ rb);
       }
 
+      thr->pop_vec4(1);
       return true;
 }
 
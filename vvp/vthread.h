@@ -65,6 +65,16 @@ extern void vthread_delay_delete();
  */
 extern void vthread_run(vthread_t thr);
 
+/*
+ * Run threads through a slower loop that counts every opcode executed
+ * and every entry into a block of straight-line code. The
+ * vthread_profile_report function prints the counts to stderr. This
+ * is used to find the procedural code that a design spends its time
+ * in.
+ */
+extern void vthread_enable_profile(void);
+extern void vthread_profile_report(void);
+
 /*
  * This function schedules all the threads in the list to be scheduled
  * for execution with delay 0. The thr pointer is taken to be the head
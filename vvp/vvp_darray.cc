@@ -20,6 +20,7 @@
 # include  "vvp_darray.h"
 # include  <iostream>
 # include  <typeinfo>
+# include  <cmath>
 
 using namespace std;
 
@@ -370,6 +371,53 @@ vvp_vector4_t vvp_darray_real::get_bitstream(bool)
       return vec;
 }
 
+vvp_darray_real_sparse::vvp_darray_real_sparse(size_t siz)
+: size_(siz), pages_(siz/PAGE_WORDS + (siz%PAGE_WORDS? 1 : 0), (double*)0)
+{
+      page_words_ = siz < PAGE_WORDS? siz : (size_t)PAGE_WORDS;
+}
+
+vvp_darray_real_sparse::~vvp_darray_real_sparse()
+{
+      for (size_t idx = 0 ; idx < pages_.size() ; idx += 1)
+	    delete[]pages_[idx];
+}
+
+size_t vvp_darray_real_sparse::get_size() const
+{
+      return size_;
+}
+
+void vvp_darray_real_sparse::set_word(unsigned adr, double value)
+{
+      if (adr >= size_)
+	    return;
+
+      double*&page = pages_[adr >> PAGE_SHIFT];
+      if (page == 0) {
+	      /* The words of a missing page are already 0.0, but
+		 keep a -0.0 so that its sign is not lost. */
+	    if (value == 0.0 && !signbit(value))
+		  return;
+	    page = new double[page_words_];
+	    for (unsigned idx = 0 ; idx < page_words_ ; idx += 1)
+		  page[idx] = 0.0;
+      }
+
+      page[adr & (PAGE_WORDS-1)] = value;
+}
+
+void vvp_darray_real_sparse::get_word(unsigned adr, double&value)
+{
+      if (adr >= size_) {
+	    value = 0.0;
+	    return;
+      }
+
+      const double*page = pages_[adr >> PAGE_SHIFT];
+      value = page? page[adr & (PAGE_WORDS-1)] : 0.0;
+}
+
 vvp_darray_string::~vvp_darray_string()
 {
 }
@@ -118,6 +118,30 @@ class vvp_darray_real : public vvp_darray {
       std::vector<double> array_;
 };
 
+/*
+ * This holds the words of a fixed size real array (a real memory). The
+ * words are kept in pages that are only allocated when a word in them
+ * is first written with a value other than 0.0, so a huge memory that
+ * is only touched in a few places takes little space.
+ */
+class vvp_darray_real_sparse : public vvp_darray {
+
+    public:
+      explicit vvp_darray_real_sparse(size_t siz);
+      ~vvp_darray_real_sparse();
+
+      size_t get_size(void) const;
+      void set_word(unsigned adr, double value);
+      void get_word(unsigned adr, double&value);
+
+    private:
+      enum { PAGE_SHIFT = 10, PAGE_WORDS = 1 << PAGE_SHIFT };
+
+      size_t size_;
+      unsigned page_words_;
+      std::vector<double*> pages_;
+};
+
 class vvp_darray_string : public vvp_darray {
 
     public:
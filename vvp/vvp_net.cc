@@ -33,6 +33,8 @@
 # include  <climits>
 # include  <cmath>
 # include  <cassert>
+# include  <vector>
+# include  <algorithm>
 #ifdef CHECK_WITH_VALGRIND
 # include  <valgrind/memcheck.h>
 # include  <map>
@@ -61,6 +63,20 @@ static size_t vvp_net_alloc_remaining = 0;
 // chunks allocated.
 unsigned long count_vvp_nets = 0;
 size_t size_vvp_nets = 0;
+// The flattened fan-out lists, and the number of entries in them.
+static vvp_fanout_s*vvp_fanout_table = 0;
+unsigned long count_vvp_fanouts = 0;
+size_t size_vvp_fanouts = 0;
+// All the alloc chunks in allocation order, and the same chunks sorted
+// by their address, for mapping between nets and net indices.
+struct vvp_net_chunk_s {
+      const vvp_net_t*base;
+      unsigned long num;
+      bool operator < (const vvp_net_chunk_s&that) const
+	    { return base < that.base; }
+};
+static vector<vvp_net_t*> vvp_net_chunks;
+static vector<vvp_net_chunk_s> vvp_net_chunks_sorted;
 
 void* vvp_net_t::operator new (size_t size)
 {
@@ -69,6 +85,13 @@ void* vvp_net_t::operator new (size_t size)
 	    vvp_net_alloc_table = ::new vvp_net_t[VVP_NET_CHUNK];
 	    vvp_net_alloc_remaining = VVP_NET_CHUNK;
 	    size_vvp_nets += size*VVP_NET_CHUNK;
+	    vvp_net_chunk_s chunk;
+	    chunk.base = vvp_net_alloc_table;
+	    chunk.num = vvp_net_chunks.size();
+	    vvp_net_chunks.push_back(vvp_net_alloc_table);
+	    vvp_net_chunks_sorted.insert(upper_bound(vvp_net_chunks_sorted.begin(),
+						     vvp_net_chunks_sorted.end(),
+						     chunk), chunk);
 #ifdef CHECK_WITH_VALGRIND
 	    VALGRIND_MAKE_MEM_NOACCESS(vvp_net_alloc_table, size*VVP_NET_CHUNK);
 	    VALGRIND_CREATE_MEMPOOL(vvp_net_alloc_table, 0, 0);
@@ -91,6 +114,27 @@ void* vvp_net_t::operator new (size_t size)
       return return_this;
 }
 
+vvp_net_t* vvp_net_from_index(unsigned long idx)
+{
+      assert(idx < count_vvp_nets);
+      return vvp_net_chunks[idx / VVP_NET_CHUNK] + idx % VVP_NET_CHUNK;
+}
+
+unsigned long vvp_net_to_index(const vvp_net_t*net)
+{
+      vvp_net_chunk_s key;
+      key.base = net;
+      key.num = 0;
+      vector<vvp_net_chunk_s>::const_iterator cur
+	    = upper_bound(vvp_net_chunks_sorted.begin(),
+			  vvp_net_chunks_sorted.end(), key);
+      assert(cur != vvp_net_chunks_sorted.begin());
+      --cur;
+      unsigned long off = net - cur->base;
+      assert(off < VVP_NET_CHUNK);
+      return cur->num * VVP_NET_CHUNK + off;
+}
+
 #ifdef CHECK_WITH_VALGRIND
 static map<vvp_net_t*, bool> vvp_net_map;
 static map<sfunc_core*, bool> sfunc_map;
@@ -179,6 +223,11 @@ void vvp_net_pool_delete()
       free(vvp_net_pool);
       vvp_net_pool = NULL;
       vvp_net_pool_count = 0;
+      vvp_net_chunks.clear();
+      vvp_net_chunk_map.clear();
+
+      delete [] vvp_fanout_table;
+      vvp_fanout_table = 0;
 }
 #endif
 
@@ -188,7 +237,7 @@ void vvp_net_t::operator delete(void*)
 }
 
 vvp_net_t::vvp_net_t()
-: out_(vvp_net_ptr_t(0,0))
+: out_(vvp_net_ptr_t(0,0)), flat_(0)
 {
       fun = 0;
       fil = 0;
@@ -199,6 +248,7 @@ void vvp_net_t::link(vvp_net_ptr_t port_to_link)
       vvp_net_t*net = port_to_link.ptr();
       net->port[port_to_link.port()] = out_;
       out_ = port_to_link;
+      flat_ = 0;
 }
 
 /*
@@ -232,9 +282,83 @@ void vvp_net_t::unlink(vvp_net_ptr_t dst_ptr)
 	    if (cur_net) cur_net->port[cur_port] = net->port[net_port];
       }
 
+      flat_ = 0;
+
       net->port[net_port] = vvp_net_ptr_t(0,0);
 }
 
+/*
+ * Lay the fan-out lists out in the order that a breadth-first walk of
+ * the netlist reaches the nets, so that the lists of a net and of the
+ * nets that it drives are near each other. Receivers without a functor
+ * are left out, as the chain walk skips them anyway. The order within
+ * each list is the order of the chain, so values are delivered in the
+ * same order either way.
+ */
+void vvp_net_flatten_fanout(void)
+{
+      unsigned long total = 0;
+      for (unsigned long idx = 0 ; idx < count_vvp_nets ; idx += 1) {
+	    vvp_net_t*net = vvp_net_from_index(idx);
+	    if (net->out_.nil())
+		  continue;
+	    vvp_net_ptr_t cur = net->out_;
+	    while (vvp_net_t*dst = cur.ptr()) {
+		  if (dst->fun)
+			total += 1;
+		  cur = dst->port[cur.port()];
+	    }
+	    total += 1;
+      }
+
+      if (total == 0)
+	    return;
+
+      vvp_fanout_table = new vvp_fanout_s[total];
+      count_vvp_fanouts = total;
+      size_vvp_fanouts = total * sizeof(vvp_fanout_s);
+
+      vector<bool> visited (count_vvp_nets);
+      vector<vvp_net_t*> queue;
+      queue.reserve(count_vvp_nets);
+      vvp_fanout_s*fill = vvp_fanout_table;
+
+      for (unsigned long idx = 0 ; idx < count_vvp_nets ; idx += 1) {
+	    if (visited[idx])
+		  continue;
+	    visited[idx] = true;
+	    queue.clear();
+	    queue.push_back(vvp_net_from_index(idx));
+
+	    for (size_t head = 0 ; head < queue.size() ; head += 1) {
+		  vvp_net_t*net = queue[head];
+		  if (net->out_.nil())
+			continue;
+
+		  net->flat_ = fill;
+		  vvp_net_ptr_t cur = net->out_;
+		  while (vvp_net_t*dst = cur.ptr()) {
+			if (dst->fun) {
+			      fill->dst = cur;
+			      fill->fun = dst->fun;
+			      fill += 1;
+			}
+			unsigned long dst_idx = vvp_net_to_index(dst);
+			if (! visited[dst_idx]) {
+			      visited[dst_idx] = true;
+			      queue.push_back(dst);
+			}
+			cur = dst->port[cur.port()];
+		  }
+		  fill->dst = vvp_net_ptr_t(0,0);
+		  fill->fun = 0;
+		  fill += 1;
+	    }
+      }
+
+      assert(fill == vvp_fanout_table + total);
+}
+
 void vvp_net_t::count_drivers(unsigned idx, unsigned counts[4])
 {
       counts[0] = 0;
@@ -701,6 +825,18 @@ void vvp_vector4_t::copy_from_big_(const vvp_vector4_t&that)
       abits_ptr_ = new unsigned long[2*words];
       bbits_ptr_ = abits_ptr_ + words;
 
+      copy_words_big_(that);
+}
+
+/*
+ * Copy the words of that big vector into the storage already
+ * allocated for this vector. The caller makes sure the word counts
+ * are the same.
+ */
+void vvp_vector4_t::copy_words_big_(const vvp_vector4_t&that)
+{
+      unsigned words = (size_+BITS_PER_WORD-1) / BITS_PER_WORD;
+
       for (unsigned idx = 0 ;  idx < words ;  idx += 1)
 	    abits_ptr_[idx] = that.abits_ptr_[idx];
       for (unsigned idx = 0 ;  idx < words ;  idx += 1)
@@ -1060,6 +1196,19 @@ unsigned long* vvp_vector4_t::subarray(unsigned adr, unsigned wid, bool xz_to_0)
       unsigned awid = (wid + BIT2_PER_WORD - 1) / (BIT2_PER_WORD);
       unsigned long*val = new unsigned long[awid];
 
+      if (! subarray_to(val, adr, wid, xz_to_0)) {
+	    delete[]val;
+	    return 0;
+      }
+
+      return val;
+}
+
+bool vvp_vector4_t::subarray_to(unsigned long*val, unsigned adr, unsigned wid, bool xz_to_0) const
+{
+      const unsigned BIT2_PER_WORD = 8*sizeof(unsigned long);
+      unsigned awid = (wid + BIT2_PER_WORD - 1) / (BIT2_PER_WORD);
+
       for (unsigned idx = 0 ;  idx < awid ;  idx += 1)
 	    val[idx] = 0;
 
@@ -1125,11 +1274,10 @@ unsigned long* vvp_vector4_t::subarray(unsigned adr, unsigned wid, bool xz_to_0)
 	    }
       }
 
-      return val;
+      return true;
 
  x_out:
-      delete[]val;
-      return 0;
+      return false;
 }
 
 void vvp_vector4_t::setarray(unsigned adr, unsigned wid, const unsigned long*val)
@@ -1727,13 +1875,13 @@ bool vvp_vector4_t::eeq(const vvp_vector4_t&that) const
 		  && (bbits_val_ == that.bbits_val_);
       }
 
+	// The full words are compared as blocks of memory, which
+	// the C library does many words at a time.
       unsigned words = size_ / BITS_PER_WORD;
-      for (unsigned idx = 0 ;  idx < words ;  idx += 1) {
-	    if (abits_ptr_[idx] != that.abits_ptr_[idx])
-		  return false;
-	    if (bbits_ptr_[idx] != that.bbits_ptr_[idx])
-		  return false;
-      }
+      if (memcmp(abits_ptr_, that.abits_ptr_, words*sizeof(unsigned long)) != 0)
+	    return false;
+      if (memcmp(bbits_ptr_, that.bbits_ptr_, words*sizeof(unsigned long)) != 0)
+	    return false;
 
       unsigned long mask = size_%BITS_PER_WORD;
       if (mask > 0) {
@@ -1790,16 +1938,29 @@ bool vvp_vector4_t::has_xz() const
 	    return bbits_val_;
       }
 
+	// Or the bbits together in blocks of words without an early
+	// exit for each word, so that the compiler can vectorize the
+	// inner loop. X and Z bits are rare, so the whole vector is
+	// usually scanned anyhow.
+      const unsigned long*bbits = bbits_ptr_;
       unsigned words = size_ / BITS_PER_WORD;
-      for (unsigned idx = 0 ; idx < words ; idx += 1) {
-	    if (bbits_ptr_[idx])
+      unsigned idx = 0;
+      while (idx < words) {
+	    unsigned cnt = words - idx;
+	    if (cnt > 16)
+		  cnt = 16;
+	    unsigned long tmp = 0;
+	    for (unsigned wdx = 0 ;  wdx < cnt ;  wdx += 1)
+		  tmp |= bbits[idx+wdx];
+	    if (tmp)
 		  return true;
+	    idx += cnt;
       }
 
       unsigned long mask = size_%BITS_PER_WORD;
       if (mask > 0) {
 	    mask = -1UL >> (BITS_PER_WORD - mask);
-	    return bbits_ptr_[words]&mask;
+	    return bbits[words]&mask;
       }
 
       return false;
@@ -1836,6 +1997,27 @@ void vvp_vector4_t::set_to_x()
       }
 }
 
+void vvp_vector4_t::get_vecval(s_vpi_vecval*vals) const
+{
+      const unsigned long*abits = abits_words_();
+      const unsigned long*bbits = bbits_words_();
+      unsigned nvals = (size_ + 31) / 32;
+
+      for (unsigned idx = 0 ;  idx < nvals ;  idx += 1) {
+	    unsigned word = idx*32 / BITS_PER_WORD;
+	    unsigned off = idx*32 % BITS_PER_WORD;
+	    vals[idx].aval = (PLI_INT32)(PLI_UINT32)(abits[word] >> off);
+	    vals[idx].bval = (PLI_INT32)(PLI_UINT32)(bbits[word] >> off);
+      }
+
+	/* Clear the bits past the end of the vector. */
+      if (size_ % 32) {
+	    PLI_UINT32 mask = (1U << (size_ % 32)) - 1;
+	    vals[nvals-1].aval &= mask;
+	    vals[nvals-1].bval &= mask;
+      }
+}
+
 char* vvp_vector4_t::as_string(char*buf, size_t buf_len) const
 {
       char*res = buf;
@@ -1903,14 +2085,19 @@ vvp_vector4_t& vvp_vector4_t::operator &= (const vvp_vector4_t&that)
 	    abits_val_ = tmp1 & tmp2;
 	    bbits_val_ = (tmp1 & that.bbits_val_) | (tmp2 & bbits_val_);
       } else {
+	      // Keep the word pointers in locals so that the compiler
+	      // knows they do not change, and can vectorize the loop.
+	    unsigned long*abits = abits_ptr_;
+	    unsigned long*bbits = bbits_ptr_;
+	    const unsigned long*that_abits = that.abits_ptr_;
+	    const unsigned long*that_bbits = that.bbits_ptr_;
 	    unsigned words = (size_ + BITS_PER_WORD - 1) / BITS_PER_WORD;
 	    for (unsigned idx = 0; idx < words ; idx += 1) {
-		  unsigned long tmp1 = abits_ptr_[idx] | bbits_ptr_[idx];
-		  unsigned long tmp2 = that.abits_ptr_[idx] |
-		                       that.bbits_ptr_[idx];
-		  abits_ptr_[idx] = tmp1 & tmp2;
-		  bbits_ptr_[idx] = (tmp1 & that.bbits_ptr_[idx]) |
-		                    (tmp2 & bbits_ptr_[idx]);
+		  unsigned long tmp1 = abits[idx] | bbits[idx];
+		  unsigned long tmp2 = that_abits[idx] | that_bbits[idx];
+		  abits[idx] = tmp1 & tmp2;
+		  bbits[idx] = (tmp1 & that_bbits[idx]) |
+		               (tmp2 & bbits[idx]);
 	    }
       }
 
@@ -1933,15 +2120,17 @@ vvp_vector4_t& vvp_vector4_t::operator |= (const vvp_vector4_t&that)
 	    abits_val_ = tmp;
 
       } else {
+	    unsigned long*abits = abits_ptr_;
+	    unsigned long*bbits = bbits_ptr_;
+	    const unsigned long*that_abits = that.abits_ptr_;
+	    const unsigned long*that_bbits = that.bbits_ptr_;
 	    unsigned words = (size_ + BITS_PER_WORD - 1) / BITS_PER_WORD;
 	    for (unsigned idx = 0; idx < words ; idx += 1) {
-		  unsigned long tmp = abits_ptr_[idx] | bbits_ptr_[idx] |
-	                        that.abits_ptr_[idx] | that.bbits_ptr_[idx];
-		  bbits_ptr_[idx] = ((~abits_ptr_[idx] | bbits_ptr_[idx]) &
-		                     that.bbits_ptr_[idx]) |
-		                    ((~that.abits_ptr_[idx] |
-		                      that.bbits_ptr_[idx]) & bbits_ptr_[idx]);
-		  abits_ptr_[idx] = tmp;
+		  unsigned long tmp = abits[idx] | bbits[idx] |
+		                      that_abits[idx] | that_bbits[idx];
+		  bbits[idx] = ((~abits[idx] | bbits[idx]) & that_bbits[idx]) |
+		               ((~that_abits[idx] | that_bbits[idx]) & bbits[idx]);
+		  abits[idx] = tmp;
 	    }
       }
 
@@ -2203,40 +2392,135 @@ vvp_vector4_t vvp_vector4array_t::get_word_(v4cell*cell) const
 vvp_vector4array_sa::vvp_vector4array_sa(unsigned width__, unsigned words__)
 : vvp_vector4array_t(width__, words__)
 {
-      array_ = new v4cell[words_];
+      const unsigned BPW = vvp_vector4_t::BITS_PER_WORD;
+      cnt_ = (width_ + BPW - 1) / BPW;
+      page_words_ = words_ < PAGE_WORDS? words_ : (unsigned)PAGE_WORDS;
+      flag_cnt_ = (page_words_ + BPW - 1) / BPW;
 
-      if (width_ <= vvp_vector4_t::BITS_PER_WORD) {
-	    for (unsigned idx = 0 ; idx < words_ ; idx += 1) {
-		  array_[idx].abits_val_ = vvp_vector4_t::WORD_X_ABITS;
-		  array_[idx].bbits_val_ = vvp_vector4_t::WORD_X_BBITS;
-	    }
-      } else {
-	    for (unsigned idx = 0 ; idx < words_ ; idx += 1) {
-		  array_[idx].abits_ptr_ = 0;
-		  array_[idx].bbits_ptr_ = 0;
-	    }
+      unsigned npages = words_/PAGE_WORDS + (words_%PAGE_WORDS? 1 : 0);
+      pages_ = new page_s[npages];
+      for (unsigned idx = 0 ; idx < npages ; idx += 1) {
+	    pages_[idx].bits = 0;
+	    pages_[idx].four_state = false;
       }
 }
 
 vvp_vector4array_sa::~vvp_vector4array_sa()
 {
-      if (array_) {
-	    if (width_ > vvp_vector4_t::BITS_PER_WORD) {
-		  for (unsigned idx = 0 ; idx < words_ ; idx += 1)
-			if (array_[idx].abits_ptr_)
-			      delete[]array_[idx].abits_ptr_;
+      unsigned npages = words_/PAGE_WORDS + (words_%PAGE_WORDS? 1 : 0);
+      for (unsigned idx = 0 ; idx < npages ; idx += 1)
+	    delete[]pages_[idx].bits;
+      delete[]pages_;
+}
+
+/*
+ * Return true if all the bits of the value are X. The bits above the
+ * width in the last word are not defined, so they are masked off.
+ */
+bool vvp_vector4array_sa::all_x_(const vvp_vector4_t&that) const
+{
+      const unsigned BPW = vvp_vector4_t::BITS_PER_WORD;
+      unsigned long top_mask = -1UL;
+      if (width_ % BPW)
+	    top_mask >>= BPW - width_ % BPW;
+
+      if (width_ <= BPW)
+	    return (that.abits_val_ & that.bbits_val_ & top_mask) == top_mask;
+
+      for (unsigned idx = 0 ; idx+1 < cnt_ ; idx += 1) {
+	    if ((that.abits_ptr_[idx] & that.bbits_ptr_[idx]) != -1UL)
+		  return false;
+      }
+      unsigned long top = that.abits_ptr_[cnt_-1] & that.bbits_ptr_[cnt_-1];
+      return (top & top_mask) == top_mask;
+}
+
+/*
+ * Change a 2-state page to a 4-state page. The words that were written
+ * get their abits and 0 bbits, and the rest become X.
+ */
+void vvp_vector4array_sa::make_page4_(page_s*page)
+{
+      const unsigned BPW = vvp_vector4_t::BITS_PER_WORD;
+      unsigned long*bits = new unsigned long[page_words_ * 2*cnt_];
+      const unsigned long*flags = page->bits;
+      const unsigned long*abits = page->bits + flag_cnt_;
+
+      for (unsigned wdx = 0 ; wdx < page_words_ ; wdx += 1) {
+	    unsigned long*dst = bits + wdx*2*cnt_;
+	    if (flags[wdx/BPW] & (1UL << wdx%BPW)) {
+		  for (unsigned idx = 0 ; idx < cnt_ ; idx += 1) {
+			dst[idx] = abits[wdx*cnt_ + idx];
+			dst[cnt_+idx] = 0;
+		  }
+	    } else {
+		  for (unsigned idx = 0 ; idx < cnt_ ; idx += 1) {
+			dst[idx] = vvp_vector4_t::WORD_X_ABITS;
+			dst[cnt_+idx] = vvp_vector4_t::WORD_X_BBITS;
+		  }
 	    }
-	    delete[]array_;
       }
+
+      delete[]page->bits;
+      page->bits = bits;
+      page->four_state = true;
 }
 
 void vvp_vector4array_sa::set_word(unsigned index, const vvp_vector4_t&that)
 {
       assert(index < words_);
+      assert(that.size_ == width_);
 
-      v4cell*cell = &array_[index];
+      const unsigned BPW = vvp_vector4_t::BITS_PER_WORD;
+      page_s*page = pages_ + (index >> PAGE_SHIFT);
+      unsigned wdx = index & (PAGE_WORDS-1);
+      bool has_xz = that.has_xz();
 
-      set_word_(cell, that);
+      if (page->bits == 0) {
+	      /* Words of a missing page are already X. */
+	    if (has_xz && all_x_(that))
+		  return;
+	    if (has_xz) {
+		  page->bits = new unsigned long[page_words_ * 2*cnt_];
+		  for (unsigned idx = 0 ; idx < page_words_ ; idx += 1) {
+			unsigned long*dst = page->bits + idx*2*cnt_;
+			for (unsigned n = 0 ; n < cnt_ ; n += 1) {
+			      dst[n] = vvp_vector4_t::WORD_X_ABITS;
+			      dst[cnt_+n] = vvp_vector4_t::WORD_X_BBITS;
+			}
+		  }
+		  page->four_state = true;
+	    } else {
+		  page->bits = new unsigned long[flag_cnt_ + page_words_*cnt_];
+		  for (unsigned idx = 0 ; idx < flag_cnt_ ; idx += 1)
+			page->bits[idx] = 0;
+		  page->four_state = false;
+	    }
+
+      } else if (has_xz && !page->four_state) {
+	      /* An all X word in a 2-state page is just not written. */
+	    if (all_x_(that)) {
+		  page->bits[wdx/BPW] &= ~(1UL << wdx%BPW);
+		  return;
+	    }
+	    make_page4_(page);
+      }
+
+      const unsigned long*abits = width_ <= BPW? &that.abits_val_ : that.abits_ptr_;
+      const unsigned long*bbits = width_ <= BPW? &that.bbits_val_ : that.bbits_ptr_;
+
+      if (page->four_state) {
+	    unsigned long*dst = page->bits + wdx*2*cnt_;
+	    for (unsigned idx = 0 ; idx < cnt_ ; idx += 1) {
+		  dst[idx] = abits[idx];
+		  dst[cnt_+idx] = bbits[idx];
+	    }
+      } else {
+	    page->bits[wdx/BPW] |= 1UL << wdx%BPW;
+	    unsigned long*dst = page->bits + flag_cnt_ + wdx*cnt_;
+	    for (unsigned idx = 0 ; idx < cnt_ ; idx += 1)
+		  dst[idx] = abits[idx];
+      }
 }
 
 vvp_vector4_t vvp_vector4array_sa::get_word(unsigned index) const
@@ -2244,11 +2528,41 @@ vvp_vector4_t vvp_vector4array_sa::get_word(unsigned index) const
       if (index >= words_)
 	    return vvp_vector4_t(width_, BIT4_X);
 
-      assert(index < words_);
+      const unsigned BPW = vvp_vector4_t::BITS_PER_WORD;
+      const page_s*page = pages_ + (index >> PAGE_SHIFT);
+      unsigned wdx = index & (PAGE_WORDS-1);
 
-      v4cell*cell = &array_[index];
+      if (page->bits == 0)
+	    return vvp_vector4_t(width_, BIT4_X);
 
-      return get_word_(cell);
+      const unsigned long*abits;
+      const unsigned long*bbits = 0;
+      if (page->four_state) {
+	    abits = page->bits + wdx*2*cnt_;
+	    bbits = abits + cnt_;
+      } else if (page->bits[wdx/BPW] & (1UL << wdx%BPW)) {
+	    abits = page->bits + flag_cnt_ + wdx*cnt_;
+      } else {
+	    return vvp_vector4_t(width_, BIT4_X);
+      }
+
+      if (width_ <= BPW) {
+	    vvp_vector4_t res;
+	    res.size_ = width_;
+	    res.abits_val_ = abits[0];
+	    res.bbits_val_ = bbits? bbits[0] : 0;
+	    return res;
+      }
+
+      vvp_vector4_t res (width_, BIT4_0);
+      for (unsigned idx = 0 ; idx < cnt_ ; idx += 1)
+	    res.abits_ptr_[idx] = abits[idx];
+      if (bbits) {
+	    for (unsigned idx = 0 ; idx < cnt_ ; idx += 1)
+		  res.bbits_ptr_[idx] = bbits[idx];
+      }
+
+      return res;
 }
 
 vvp_vector4array_aa::vvp_vector4array_aa(unsigned width__, unsigned words__)
@@ -3064,14 +3378,39 @@ vvp_vector8_t::vvp_vector8_t(const vvp_vector4_t&that,
       if (size_ == 0)
 	    return;
 
+	// There are only 4 possible strength values for the bits of
+	// the result, so look them up by the bit4 value.
+      unsigned char map[4];
+      map[BIT4_0] = vvp_scalar_t(BIT4_0, str0, str1).raw();
+      map[BIT4_1] = vvp_scalar_t(BIT4_1, str0, str1).raw();
+      map[BIT4_X] = vvp_scalar_t(BIT4_X, str0, str1).raw();
+      map[BIT4_Z] = vvp_scalar_t(BIT4_Z, str0, str1).raw();
+
+      unsigned char*dst;
       if (size_ <= sizeof(val_)) {
 	    ptr_ = 0; // Prefill all val_ bytes
-	    for (unsigned idx = 0 ; idx < size_ ; idx += 1)
-		  val_[idx] = vvp_scalar_t(that.value(idx),str0, str1).raw();
+	    dst = val_;
       } else {
 	    ptr_ = new unsigned char[size_];
-	    for (unsigned idx = 0 ;  idx < size_ ;  idx += 1)
-		  ptr_[idx] = vvp_scalar_t(that.value(idx), str0, str1).raw();
+	    dst = ptr_;
+      }
+
+	// Walk the source a word at a time, so that each bit is a
+	// shift and a table lookup.
+      const unsigned BPW = vvp_vector4_t::BITS_PER_WORD;
+      const unsigned long*abits = size_ <= BPW ? &that.abits_val_ : that.abits_ptr_;
+      const unsigned long*bbits = size_ <= BPW ? &that.bbits_val_ : that.bbits_ptr_;
+      for (unsigned base = 0 ;  base < size_ ;  base += BPW) {
+	    unsigned long atmp = abits[base/BPW];
+	    unsigned long btmp = bbits[base/BPW];
+	    unsigned trans = size_ - base;
+	    if (trans > BPW)
+		  trans = BPW;
+	    for (unsigned idx = 0 ;  idx < trans ;  idx += 1) {
+		  dst[base+idx] = map[(atmp&1) | ((btmp&1) << 1)];
+		  atmp >>= 1;
+		  btmp >>= 1;
+	    }
       }
 }
 
@@ -3147,8 +3486,67 @@ vvp_vector8_t vvp_vector8_t::subvalue(unsigned base, unsigned wid) const
 void vvp_vector8_t::set_vec(unsigned base, const vvp_vector8_t&that)
 {
       assert((base+that.size()) <= size());
-      for (unsigned idx = 0 ; idx < that.size() ; idx += 1)
-	    set_bit(base+idx, that.value(idx));
+      if (that.size_ == 0)
+	    return;
+
+      unsigned char*dst_ptr = size_ <= sizeof(val_) ? val_ : ptr_;
+      const unsigned char*src_ptr = that.size_ <= sizeof(that.val_) ?
+                                    that.val_ : that.ptr_;
+      memcpy(dst_ptr+base, src_ptr, that.size_);
+}
+
+/*
+ * Resolve a pair of strength vectors 8 bits at a time. The bits of a
+ * wide bus are usually driven by only one of the drivers, or by both
+ * drivers with the same value, so most of the 8 byte groups can be
+ * copied as a whole. Only the groups that have a real conflict are
+ * resolved a bit at a time.
+ */
+vvp_vector8_t resolve(const vvp_vector8_t&a, const vvp_vector8_t&b)
+{
+      assert(a.size() == b.size());
+      vvp_vector8_t out (a.size());
+
+      const unsigned char*a_ptr = a.size_ <= sizeof(a.val_) ? a.val_ : a.ptr_;
+      const unsigned char*b_ptr = b.size_ <= sizeof(b.val_) ? b.val_ : b.ptr_;
+      unsigned char*out_ptr = out.size_ <= sizeof(out.val_) ? out.val_ : out.ptr_;
+
+	// A strength byte is HiZ if all its strength bits are 0.
+      const uint64_t STR_MASK = 0x7777777777777777ULL;
+      const uint64_t LOW7_MASK = 0x7f7f7f7f7f7f7f7fULL;
+      const uint64_t HIGH_MASK = 0x8080808080808080ULL;
+
+      unsigned idx = 0;
+      for ( ; idx+8 <= out.size_ ;  idx += 8) {
+	    uint64_t a_word, b_word;
+	    memcpy(&a_word, a_ptr+idx, sizeof a_word);
+	    memcpy(&b_word, b_ptr+idx, sizeof b_word);
+	    if (a_word == b_word || (a_word & STR_MASK) == 0) {
+		  memcpy(out_ptr+idx, &b_word, sizeof b_word);
+		  continue;
+	    }
+	    if ((b_word & STR_MASK) == 0) {
+		    // The bytes of a that are not HiZ win, and the
+		    // rest come from b, as for the scalar resolve. The
+		    // strength bits of a byte are at most 0x77, so
+		    // adding 0x7f sets the high bit only if the byte
+		    // has a strength.
+		  uint64_t tmp = a_word & STR_MASK;
+		  uint64_t live = (tmp + LOW7_MASK) & HIGH_MASK;
+		  live = (live >> 7) * 0xff;
+		  uint64_t res = (a_word & live) | (b_word & ~live);
+		  memcpy(out_ptr+idx, &res, sizeof res);
+		  continue;
+	    }
+
+	    for (unsigned bit = idx ;  bit < idx+8 ;  bit += 1)
+		  out.set_bit(bit, resolve(a.value(bit), b.value(bit)));
+      }
+
+      for ( ; idx < out.size_ ;  idx += 1)
+	    out.set_bit(idx, resolve(a.value(idx), b.value(idx)));
+
+      return out;
 }
 
 vvp_vector8_t part_expand(const vvp_vector8_t&that, unsigned wid, unsigned off)
@@ -3350,6 +3748,16 @@ void vvp_net_fun_t::force_flag(bool)
 {
 }
 
+vvp_gen_event_s* vvp_net_fun_t::levelize_event()
+{
+      return 0;
+}
+
+vvp_net_t* vvp_net_fun_t::levelize_core_net()
+{
+      return 0;
+}
+
 /* **** vvp_fun_drive methods **** */
 
 vvp_fun_drive::vvp_fun_drive(unsigned str0, unsigned str1)
@@ -3488,6 +3896,11 @@ void vvp_wide_fun_t::recv_real(vvp_net_ptr_t port, double bit,
       core_->dispatch_real_from_input_(pidx, bit);
 }
 
+vvp_net_t* vvp_wide_fun_t::levelize_core_net()
+{
+      return core_->ptr_;
+}
+
 /* **** vvp_scalar_t methods **** */
 
 /*
@@ -3712,15 +4125,150 @@ unsigned vvp_switch_strength_map[2][8] = {
       }
 };
 
+/*
+ * The reduce4 function builds the abit and bbit words of the result
+ * directly from the strength bytes. A byte is HiZ if it has no
+ * strength bits, and is otherwise 0, 1 or X depending on the two
+ * value bits (0x88) of the byte.
+ */
 vvp_vector4_t reduce4(const vvp_vector8_t&that)
 {
       vvp_vector4_t out (that.size());
-      for (unsigned idx = 0 ;  idx < out.size() ;  idx += 1)
-	    out.set_bit(idx, that.value(idx).value());
+
+      const unsigned BPW = vvp_vector4_t::BITS_PER_WORD;
+      const unsigned char*src = that.size_ <= sizeof(that.val_)? that.val_ : that.ptr_;
+      unsigned long*abits = out.abits_words_();
+      unsigned long*bbits = out.bbits_words_();
+
+      for (unsigned base = 0 ;  base < out.size() ;  base += BPW) {
+	    unsigned trans = out.size() - base;
+	    if (trans > BPW)
+		  trans = BPW;
+
+	    unsigned long atmp = 0, btmp = 0;
+	    for (unsigned idx = 0 ;  idx < trans ;  idx += 1) {
+		  unsigned char val = src[base+idx];
+		  unsigned long mask = 1UL << idx;
+		  if ((val & 0x77) == 0) {
+			btmp |= mask;
+		  } else if ((val & 0x88) == 0x88) {
+			atmp |= mask;
+		  } else if ((val & 0x88) != 0) {
+			atmp |= mask;
+			btmp |= mask;
+		  }
+	    }
+	    abits[base/BPW] = atmp;
+	    bbits[base/BPW] = btmp;
+      }
 
       return out;
 }
 
+bool vvp_vector8_t::is_strong() const
+{
+      const unsigned char*ptr = size_ <= sizeof(val_)? val_ : ptr_;
+      for (unsigned idx = 0 ;  idx < size_ ;  idx += 1) {
+	    switch (ptr[idx]) {
+		case 0x00: // HiZ
+		case 0x66: // St0
+		case 0xee: // St1
+		case 0xe6: // StX
+		  break;
+		default:
+		  return false;
+	    }
+      }
+
+      return true;
+}
+
+enum resolve4_rule_t { RESOLVE4_TRI, RESOLVE4_WAND, RESOLVE4_WOR };
+
+/*
+ * Resolve the words of two 4-state vectors according to the rule. In
+ * every case a Z bit gives way to the other driver, and the rule
+ * decides the bits where both drivers have a value.
+ */
+static void resolve4_words_(resolve4_rule_t rule, unsigned words,
+			    const unsigned long*aa, const unsigned long*ab,
+			    const unsigned long*ba, const unsigned long*bb,
+			    unsigned long*ra, unsigned long*rb)
+{
+      for (unsigned idx = 0 ;  idx < words ;  idx += 1) {
+	    unsigned long a_z = ~aa[idx] & ab[idx];
+	    unsigned long b_z = ~ba[idx] & bb[idx];
+	    unsigned long use_b = a_z;
+	    unsigned long use_a = ~a_z & b_z;
+	    unsigned long both = ~a_z & ~b_z;
+	    unsigned long one = 0, x = 0;
+
+	    switch (rule) {
+		case RESOLVE4_TRI: {
+		      unsigned long diff = (aa[idx]^ba[idx]) | (ab[idx]^bb[idx]);
+		      use_a |= both & ~diff;
+		      x = both & diff;
+		      break;
+		}
+		case RESOLVE4_WAND: {
+		      unsigned long zero = both & ((~aa[idx] & ~ab[idx]) |
+						   (~ba[idx] & ~bb[idx]));
+		      x = both & ~zero & (ab[idx] | bb[idx]);
+		      one = both & ~zero & ~x;
+		      break;
+		}
+		case RESOLVE4_WOR: {
+		      one = both & ((aa[idx] & ~ab[idx]) | (ba[idx] & ~bb[idx]));
+		      x = both & ~one & (ab[idx] | bb[idx]);
+		      break;
+		}
+	    }
+
+	    ra[idx] = (use_b & ba[idx]) | (use_a & aa[idx]) | one | x;
+	    rb[idx] = (use_b & bb[idx]) | (use_a & ab[idx]) | x;
+      }
+}
+
+vvp_vector4_t resolve4(const vvp_vector4_t&a, const vvp_vector4_t&b)
+{
+      assert(a.size() == b.size());
+      vvp_vector4_t out (a.size());
+      unsigned words = (a.size() + vvp_vector4_t::BITS_PER_WORD - 1) / vvp_vector4_t::BITS_PER_WORD;
+      resolve4_words_(RESOLVE4_TRI, words,
+		      a.abits_words_(), a.bbits_words_(),
+		      b.abits_words_(), b.bbits_words_(),
+		      out.abits_words_(), out.bbits_words_());
+      return out;
+}
+
+vvp_vector4_t resolve4_wand(const vvp_vector4_t&a, const vvp_vector4_t&b)
+{
+      assert(a.size() == b.size());
+      vvp_vector4_t out (a.size());
+      unsigned words = (a.size() + vvp_vector4_t::BITS_PER_WORD - 1) / vvp_vector4_t::BITS_PER_WORD;
+      resolve4_words_(RESOLVE4_WAND, words,
+		      a.abits_words_(), a.bbits_words_(),
+		      b.abits_words_(), b.bbits_words_(),
+		      out.abits_words_(), out.bbits_words_());
+      return out;
+}
+
+vvp_vector4_t resolve4_wor(const vvp_vector4_t&a, const vvp_vector4_t&b)
+{
+      assert(a.size() == b.size());
+      vvp_vector4_t out (a.size());
+      unsigned words = (a.size() + vvp_vector4_t::BITS_PER_WORD - 1) / vvp_vector4_t::BITS_PER_WORD;
+      resolve4_words_(RESOLVE4_WOR, words,
+		      a.abits_words_(), a.bbits_words_(),
+		      b.abits_words_(), b.bbits_words_(),
+		      out.abits_words_(), out.bbits_words_());
+      return out;
+}
+
+/* Compares of vectors up to this many words wide work in arrays on
+   the C stack instead of the heap. */
+static const unsigned CMP_STACK_WORDS = 16;
+
 vvp_bit4_t compare_gtge(const vvp_vector4_t&lef, const vvp_vector4_t&rig,
 			vvp_bit4_t out_if_equal)
 {
@@ -3745,6 +4293,23 @@ vvp_bit4_t compare_gtge(const vvp_vector4_t&lef, const vvp_vector4_t&rig,
       if (rig.has_xz())
 	    return BIT4_X;
 
+	// If the operands are the same size, then compare them a
+	// word at a time starting with the most significant word.
+      const unsigned cmp_words = (min_size+CPU_WORD_BITS-1) / CPU_WORD_BITS;
+      if (lef.size() == rig.size() && cmp_words <= CMP_STACK_WORDS) {
+	    unsigned long lbuf[CMP_STACK_WORDS], rbuf[CMP_STACK_WORDS];
+	    lef.subarray_to(lbuf, 0, min_size);
+	    rig.subarray_to(rbuf, 0, min_size);
+	    for (unsigned idx = cmp_words ; idx > 0 ; idx -= 1) {
+		  if (lbuf[idx-1] == rbuf[idx-1])
+			continue;
+
+		  return lbuf[idx-1] > rbuf[idx-1]? BIT4_1 : BIT4_0;
+	    }
+
+	    return out_if_equal;
+      }
+
       for (unsigned idx = lef.size() ; idx > rig.size() ;  idx -= 1) {
 	    if (lef.value(idx-1) == BIT4_1)
 		  return BIT4_1;
@@ -61,6 +61,8 @@ class  vvp_fun_part;
 
 class  vvp_delay_t;
 
+struct vvp_gen_event_s;
+
 /*
  * Storage for items declared in automatically allocated scopes (i.e. automatic
  * tasks and functions). The first two slots in each context are reserved for
@@ -244,9 +246,14 @@ extern unsigned long multiply_with_carry(unsigned long a, unsigned long b,
 class vvp_vector4_t {
 
       friend vvp_vector4_t operator ~(const vvp_vector4_t&that);
+      friend vvp_vector4_t resolve4(const vvp_vector4_t&, const vvp_vector4_t&);
+      friend vvp_vector4_t resolve4_wand(const vvp_vector4_t&, const vvp_vector4_t&);
+      friend vvp_vector4_t resolve4_wor(const vvp_vector4_t&, const vvp_vector4_t&);
+      friend vvp_vector4_t reduce4(const vvp_vector8_t&that);
       friend class vvp_vector4array_t;
       friend class vvp_vector4array_sa;
       friend class vvp_vector4array_aa;
+      friend class vvp_vector8_t;
 
     public:
       static const vvp_vector4_t nil;
@@ -273,6 +280,10 @@ class vvp_vector4_t {
       inline unsigned size() const { return size_; }
       void resize(unsigned new_size, vvp_bit4_t pad_bit = BIT4_X);
 
+	// Exchange the values (and the word storage) of this vector
+	// and that vector. This does not allocate.
+      void swap(vvp_vector4_t&that);
+
 	// Get the bit at the specified address
       vvp_bit4_t value(unsigned idx) const;
 	// Get the vector4 subvector starting at the address
@@ -281,6 +292,10 @@ class vvp_vector4_t {
 	// array of longs, or a nil pointer if an XZ bit was detected
 	// in the array.
       unsigned long*subarray(unsigned idx, unsigned size, bool xz_to_0 =false) const;
+	// Same as subarray, but write the bits into the array that
+	// the caller passes, and return false if an XZ bit was
+	// detected.
+      bool subarray_to(unsigned long*val, unsigned idx, unsigned size, bool xz_to_0 =false) const;
       void setarray(unsigned idx, unsigned size, const unsigned long*val);
 
 	// Set a 4-value bit or subvector into the vector. Return true
@@ -321,6 +336,11 @@ class vvp_vector4_t {
 	// Display the value into the buf as a string.
       char*as_string(char*buf, size_t buf_len) const;
 
+	// Write the value into the VPI vector format, 32 bits to each
+	// of the (size+31)/32 elements of vals. The abit/bbit encoding
+	// is the same as the aval/bval encoding, so this copies words.
+      void get_vecval(s_vpi_vecval*vals) const;
+
       void invert();
       vvp_vector4_t& operator &= (const vvp_vector4_t&that);
       vvp_vector4_t& operator |= (const vvp_vector4_t&that);
@@ -353,10 +373,22 @@ class vvp_vector4_t {
 	// the data from that object into this object.
       void copy_from_(const vvp_vector4_t&that);
       void copy_from_big_(const vvp_vector4_t&that);
+      void copy_words_big_(const vvp_vector4_t&that);
       void copy_inverted_from_(const vvp_vector4_t&that);
 
       void allocate_words_(unsigned long inita, unsigned long initb);
 
+	// Get at the abit and bbit words of the vector, whether they
+	// are stored in line or not.
+      unsigned long*abits_words_()
+	    { return size_ <= BITS_PER_WORD? &abits_val_ : abits_ptr_; }
+      unsigned long*bbits_words_()
+	    { return size_ <= BITS_PER_WORD? &bbits_val_ : bbits_ptr_; }
+      const unsigned long*abits_words_() const
+	    { return size_ <= BITS_PER_WORD? &abits_val_ : abits_ptr_; }
+      const unsigned long*bbits_words_() const
+	    { return size_ <= BITS_PER_WORD? &bbits_val_ : bbits_ptr_; }
+
 	// Values in the vvp_vector4_t are stored split across two
 	// arrays. For each bit in the vector, there is an abit and a
 	// bbit. the encoding of a vvp_vector4_t is:
@@ -424,14 +456,36 @@ inline vvp_vector4_t& vvp_vector4_t::operator= (const vvp_vector4_t&that)
       if (this == &that)
 	    return *this;
 
-      if (size_ > BITS_PER_WORD)
+      if (size_ > BITS_PER_WORD) {
+	      // If the new value needs the same number of words, then
+	      // copy it into the storage that is already allocated.
+	    if (that.size_ > BITS_PER_WORD &&
+		(size_-1)/BITS_PER_WORD == (that.size_-1)/BITS_PER_WORD) {
+		  size_ = that.size_;
+		  copy_words_big_(that);
+		  return *this;
+	    }
 	    delete[] abits_ptr_;
+      }
 
       copy_from_(that);
 
       return *this;
 }
 
+inline void vvp_vector4_t::swap(vvp_vector4_t&that)
+{
+      unsigned tmp_size = size_;
+      unsigned long*tmp_abits = abits_ptr_;
+      unsigned long*tmp_bbits = bbits_ptr_;
+      size_ = that.size_;
+      abits_ptr_ = that.abits_ptr_;
+      bbits_ptr_ = that.bbits_ptr_;
+      that.size_ = tmp_size;
+      that.abits_ptr_ = tmp_abits;
+      that.bbits_ptr_ = tmp_bbits;
+}
+
 inline void vvp_vector4_t::copy_from_(const vvp_vector4_t&that)
 {
       size_ = that.size_;
@@ -531,6 +585,17 @@ inline vvp_vector4_t operator ~ (const vvp_vector4_t&that)
 
 extern ostream& operator << (ostream&, const vvp_vector4_t&);
 
+  /* These functions resolve a pair of 4-state drivers a word at a
+     time. In all cases a Z bit gives way to the other driver. The
+     resolve4 function treats the values as strong drives, so
+     different 0, 1 or X bits make an X, and it gives the same result
+     as the vvp_vector8_t resolve of the strong versions of the
+     values. The resolve4_wand and resolve4_wor functions implement
+     the wired AND and wired OR rules. */
+extern vvp_vector4_t resolve4(const vvp_vector4_t&a, const vvp_vector4_t&b);
+extern vvp_vector4_t resolve4_wand(const vvp_vector4_t&a, const vvp_vector4_t&b);
+extern vvp_vector4_t resolve4_wor(const vvp_vector4_t&a, const vvp_vector4_t&b);
+
 extern vvp_bit4_t compare_gtge(const vvp_vector4_t&a,
 			       const vvp_vector4_t&b,
 			       vvp_bit4_t val_if_equal);
@@ -614,6 +679,15 @@ class vvp_vector4array_t {
 
 /*
  * Statically allocated vvp_vector4array_t
+ *
+ * The words are kept in pages of up to PAGE_WORDS words, and a page is
+ * only allocated when one of its words is first written with a value
+ * that is not all X, so a huge memory that a test only touches in a
+ * few places takes little space. A page starts out 2-state, with only
+ * the abits of each word and a bit that tells which words were written,
+ * and it is changed to a 4-state page when a word in it is written with
+ * some (but not all) X or Z bits. Words that were not written read as
+ * X either way.
  */
 class vvp_vector4array_sa : public vvp_vector4array_t {
 
@@ -625,7 +699,23 @@ class vvp_vector4array_sa : public vvp_vector4array_t {
       void set_word(unsigned idx, const vvp_vector4_t&that);
 
     private:
-      v4cell* array_;
+      enum { PAGE_SHIFT = 10, PAGE_WORDS = 1 << PAGE_SHIFT };
+
+      struct page_s {
+	    unsigned long*bits;
+	    bool four_state;
+      };
+
+      bool all_x_(const vvp_vector4_t&that) const;
+      void make_page4_(page_s*page);
+
+	// Number of unsigned longs in the abits (or bbits) of a word.
+      unsigned cnt_;
+	// Number of words in each page, and number of unsigned longs
+	// in the written flags at the start of a 2-state page.
+      unsigned page_words_;
+      unsigned flag_cnt_;
+      page_s*pages_;
 };
 
 /*
@@ -909,6 +999,8 @@ extern ostream& operator<< (ostream&, vvp_scalar_t);
 class vvp_vector8_t {
 
       friend vvp_vector8_t part_expand(const vvp_vector8_t&, unsigned, unsigned);
+      friend vvp_vector8_t resolve(const vvp_vector8_t&, const vvp_vector8_t&);
+      friend vvp_vector4_t reduce4(const vvp_vector8_t&that);
 
     public:
       explicit vvp_vector8_t(unsigned size =0);
@@ -935,6 +1027,9 @@ class vvp_vector8_t {
 
 	// Test that the vectors are exactly equal
       bool eeq(const vvp_vector8_t&that) const;
+	// Test that all the bits are HiZ or strong 0, 1 or X, so that
+	// this vector is the strong version of its reduce4 value.
+      bool is_strong() const;
 
       vvp_vector8_t(const vvp_vector8_t&that);
       vvp_vector8_t& operator= (const vvp_vector8_t&that);
@@ -949,17 +1044,7 @@ class vvp_vector8_t {
 
   /* Resolve uses the default Verilog resolver algorithm to resolve
      two drive vectors to a single output. */
-inline vvp_vector8_t resolve(const vvp_vector8_t&a, const vvp_vector8_t&b)
-{
-      assert(a.size() == b.size());
-      vvp_vector8_t out (a.size());
-
-      for (unsigned idx = 0 ;  idx < out.size() ;  idx += 1) {
-	    out.set_bit(idx, resolve(a.value(idx), b.value(idx)));
-      }
-
-      return out;
-}
+extern vvp_vector8_t resolve(const vvp_vector8_t&a, const vvp_vector8_t&b);
 
   /* This lookup tabke implements the strength reduction implied by
      Verilog standard switch devices. The major dimension selects
@@ -1115,7 +1200,20 @@ template <class T> ostream& operator << (ostream&out, vvp_sub_pointer_t<T> val)
  * all the fan-out chain, delivering the specified value. The send_*()
  * methods of the vvp_net_t class are similar, but they follow the
  * output, possibly filtered, from the vvp_net_t.
+ *
+ * Following the chain touches each receiving vvp_net_t in turn only to
+ * find the next one, and those are scattered through memory. So when
+ * the design is linked, vvp_net_flatten_fanout() copies the fan-out of
+ * each net into one large array of vvp_fanout_s entries, with the lists
+ * in breadth-first order of the netlist, and the send_*() methods walk
+ * that array instead. The chain is still kept, and a net that is linked
+ * or unlinked during the simulation goes back to following it.
  */
+struct vvp_fanout_s {
+      vvp_net_ptr_t dst;
+      vvp_net_fun_t*fun;
+};
+
 class vvp_net_t {
     public:
       vvp_net_t();
@@ -1161,8 +1259,28 @@ class vvp_net_t {
     public: // Method to support $countdrivers
       void count_drivers(unsigned idx, unsigned counts[4]);
 
+    public: // Method to support whole netlist analysis.
+	// Return the first input port in the fan-out list of this
+	// net. The rest of the list is threaded through the port[]
+	// members of the receiving nets.
+      vvp_net_ptr_t fanout() const { return out_; }
+
     private:
       vvp_net_ptr_t out_;
+	// Flattened copy of the out_ list, ended by an entry with a nil
+	// fun, or nil if the list is followed instead.
+      const vvp_fanout_s*flat_;
+
+      void out_vec4_(const vvp_vector4_t&val, vvp_context_t context);
+      void out_vec4_pv_(const vvp_vector4_t&val,
+			unsigned base, unsigned wid, unsigned vwid,
+			vvp_context_t context);
+      void out_vec8_(const vvp_vector8_t&val);
+      void out_vec8_pv_(const vvp_vector8_t&val,
+			unsigned base, unsigned wid, unsigned vwid);
+      void out_real_(double val, vvp_context_t context);
+
+      friend void vvp_net_flatten_fanout(void);
 
     public: // Need a better new for these objects.
       static void* operator new(std::size_t size);
@@ -1174,6 +1292,21 @@ class vvp_net_t {
 #endif
 };
 
+/*
+ * All the vvp_net_t objects are allocated from large chunks, so they
+ * can be numbered densely from 0 to count_vvp_nets-1. Analysis passes
+ * that visit the whole netlist use these functions to map between
+ * nets and their index.
+ */
+extern vvp_net_t* vvp_net_from_index(unsigned long idx);
+extern unsigned long vvp_net_to_index(const vvp_net_t*net);
+
+/*
+ * Copy the fan-out lists of all the nets into the flat array that the
+ * send_*() methods use. This is called once the netlist is linked.
+ */
+extern void vvp_net_flatten_fanout(void);
+
 /*
  * Instances of this class represent the functionality of a
  * node. vvp_net_t objects hold pointers to the vvp_net_fun_t
@@ -1239,6 +1372,15 @@ class vvp_net_fun_t {
 	// do something about it.
       virtual void force_flag(bool run_now);
 
+	// These methods are used by schedule_levelize_functors. If
+	// the functor schedules itself with schedule_functor to
+	// evaluate its inputs, levelize_event returns the event object
+	// that it schedules. If the functor only passes its inputs on
+	// to a core functor on another net, levelize_core_net returns
+	// that net. Both return nil by default.
+      virtual vvp_gen_event_s* levelize_event();
+      virtual vvp_net_t* levelize_core_net();
+
    protected:
       void recv_vec4_pv_(vvp_net_ptr_t p, const vvp_vector4_t&bit,
 			 unsigned base, unsigned wid, unsigned vwid,
@@ -1597,6 +1739,8 @@ class vvp_wide_fun_t : public vvp_net_fun_t {
 			unsigned base, unsigned wid, unsigned vwid,
                         vvp_context_t context);
 
+      vvp_net_t* levelize_core_net();
+
     private:
       vvp_wide_fun_core*core_;
       unsigned port_base_;
@@ -1692,10 +1836,63 @@ inline void vvp_send_vec8_pv(vvp_net_ptr_t ptr, const vvp_vector8_t&val,
       }
 }
 
+inline void vvp_net_t::out_vec4_(const vvp_vector4_t&val, vvp_context_t context)
+{
+      if (const vvp_fanout_s*cur = flat_) {
+	    for ( ; cur->fun ; cur += 1)
+		  cur->fun->recv_vec4(cur->dst, val, context);
+      } else {
+	    vvp_send_vec4(out_, val, context);
+      }
+}
+
+inline void vvp_net_t::out_vec4_pv_(const vvp_vector4_t&val,
+				    unsigned base, unsigned wid, unsigned vwid,
+				    vvp_context_t context)
+{
+      if (const vvp_fanout_s*cur = flat_) {
+	    for ( ; cur->fun ; cur += 1)
+		  cur->fun->recv_vec4_pv(cur->dst, val, base, wid, vwid, context);
+      } else {
+	    vvp_send_vec4_pv(out_, val, base, wid, vwid, context);
+      }
+}
+
+inline void vvp_net_t::out_vec8_(const vvp_vector8_t&val)
+{
+      if (const vvp_fanout_s*cur = flat_) {
+	    for ( ; cur->fun ; cur += 1)
+		  cur->fun->recv_vec8(cur->dst, val);
+      } else {
+	    vvp_send_vec8(out_, val);
+      }
+}
+
+inline void vvp_net_t::out_vec8_pv_(const vvp_vector8_t&val,
+				    unsigned base, unsigned wid, unsigned vwid)
+{
+      if (const vvp_fanout_s*cur = flat_) {
+	    for ( ; cur->fun ; cur += 1)
+		  cur->fun->recv_vec8_pv(cur->dst, val, base, wid, vwid);
+      } else {
+	    vvp_send_vec8_pv(out_, val, base, wid, vwid);
+      }
+}
+
+inline void vvp_net_t::out_real_(double val, vvp_context_t context)
+{
+      if (const vvp_fanout_s*cur = flat_) {
+	    for ( ; cur->fun ; cur += 1)
+		  cur->fun->recv_real(cur->dst, val, context);
+      } else {
+	    vvp_send_real(out_, val, context);
+      }
+}
+
 inline void vvp_net_t::send_vec4(const vvp_vector4_t&val, vvp_context_t context)
 {
       if (fil == 0) {
-	    vvp_send_vec4(out_, val, context);
+	    out_vec4_(val, context);
 	    return;
       }
 
@@ -1704,10 +1901,10 @@ inline void vvp_net_t::send_vec4(const vvp_vector4_t&val, vvp_context_t context)
 	  case vvp_net_fil_t::STOP:
 	    break;
 	  case vvp_net_fil_t::PROP:
-	    vvp_send_vec4(out_, val, context);
+	    out_vec4_(val, context);
 	    break;
 	  case vvp_net_fil_t::REPL:
-	    vvp_send_vec4(out_, rep, context);
+	    out_vec4_(rep, context);
 	    break;
       }
 }
@@ -1717,7 +1914,7 @@ inline void vvp_net_t::send_vec4_pv(const vvp_vector4_t&val,
 				    vvp_context_t context)
 {
       if (fil == 0) {
-	    vvp_send_vec4_pv(out_, val, base, wid, vwid, context);
+	    out_vec4_pv_(val, base, wid, vwid, context);
 	    return;
       }
 
@@ -1727,10 +1924,10 @@ inline void vvp_net_t::send_vec4_pv(const vvp_vector4_t&val,
 	  case vvp_net_fil_t::STOP:
 	    break;
 	  case vvp_net_fil_t::PROP:
-	    vvp_send_vec4_pv(out_, val, base, wid, vwid, context);
+	    out_vec4_pv_(val, base, wid, vwid, context);
 	    break;
 	  case vvp_net_fil_t::REPL:
-	    vvp_send_vec4_pv(out_, rep, base, wid, vwid, context);
+	    out_vec4_pv_(rep, base, wid, vwid, context);
 	    break;
       }
 }
@@ -1738,7 +1935,7 @@ inline void vvp_net_t::send_vec4_pv(const vvp_vector4_t&val,
 inline void vvp_net_t::send_vec8(const vvp_vector8_t&val)
 {
       if (fil == 0) {
-	    vvp_send_vec8(out_, val);
+	    out_vec8_(val);
 	    return;
       }
 
@@ -1747,10 +1944,10 @@ inline void vvp_net_t::send_vec8(const vvp_vector8_t&val)
 	  case vvp_net_fil_t::STOP:
 	    break;
 	  case vvp_net_fil_t::PROP:
-	    vvp_send_vec8(out_, val);
+	    out_vec8_(val);
 	    break;
 	  case vvp_net_fil_t::REPL:
-	    vvp_send_vec8(out_, rep);
+	    out_vec8_(rep);
 	    break;
       }
 }
@@ -1759,7 +1956,7 @@ inline void vvp_net_t::send_vec8_pv(const vvp_vector8_t&val,
 				    unsigned base, unsigned wid, unsigned vwid)
 {
       if (fil == 0) {
-	    vvp_send_vec8_pv(out_, val, base, wid, vwid);
+	    out_vec8_pv_(val, base, wid, vwid);
 	    return;
       }
 
@@ -1769,10 +1966,10 @@ inline void vvp_net_t::send_vec8_pv(const vvp_vector8_t&val,
 	  case vvp_net_fil_t::STOP:
 	    break;
 	  case vvp_net_fil_t::PROP:
-	    vvp_send_vec8_pv(out_, val, base, wid, vwid);
+	    out_vec8_pv_(val, base, wid, vwid);
 	    break;
 	  case vvp_net_fil_t::REPL:
-	    vvp_send_vec8_pv(out_, rep, base, wid, vwid);
+	    out_vec8_pv_(rep, base, wid, vwid);
 	    break;
       }
 }
@@ -1782,7 +1979,7 @@ inline void vvp_net_t::send_real(double val, vvp_context_t context)
       if (fil && ! fil->filter_real(val))
 	    return;
 
-      vvp_send_real(out_, val, context);
+      out_real_(val, context);
 }
 
 
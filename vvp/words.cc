@@ -186,7 +186,7 @@ void compile_variable(char*label, char*name,
 	    vvp_fun_signal4_aa*tmp = new vvp_fun_signal4_aa(wid);
 	    net->fil = tmp;
             net->fun = tmp;
-      } else if (vpi_type_code == vpiIntVar) {
+      } else if (vpi_type_code == vpiIntVar || two_state_flag) {
 	    net->fil = new vvp_wire_vec4(wid, BIT4_0);
             net->fun = new vvp_fun_signal4_sa(wid);
       } else {